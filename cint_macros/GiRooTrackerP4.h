@@ -0,0 +1,80 @@
+#ifndef GIROOTRACKERP4_H
+#define GIROOTRACKERP4_H
+
+#include "TString.h"
+#include "TTree.h"
+
+// Reads particle four momenta from giRooTracker trees written either with the
+// fixed size StdHepP4 branch (the default), or with the compact
+// StdHepPx/StdHepPy/StdHepPz/StdHepE branches (GiBUUToStdHep.exe -CP).
+//
+// Usage:
+//   Double_t StdHepP4[100][4];
+//   GiStdHepP4Reader p4reader;
+//   p4reader.SetBranchAddress(tree, StdHepP4);
+//   ...
+//   tree->GetEntry(evt);
+//   p4reader.Unpack(StdHepN);
+//
+// After Unpack, StdHepP4 holds the same values for either schema.
+class GiStdHepP4Reader {
+ public:
+  static const Int_t kNPmax = 100;
+
+  GiStdHepP4Reader() : P4(0), Compact(false) {}
+
+  // Returns false if the tree has neither set of momentum branches.
+  bool SetBranchAddress(TTree *tree, Double_t (*StdHepP4)[4]) {
+    P4 = StdHepP4;
+    Compact = IsCompact(tree);
+    if (!Compact) {
+      if (!tree->GetBranch("StdHepP4")) {
+        return false;
+      }
+      tree->SetBranchAddress("StdHepP4", StdHepP4);
+      return true;
+    }
+    tree->SetBranchAddress("StdHepPx", Px);
+    tree->SetBranchAddress("StdHepPy", Py);
+    tree->SetBranchAddress("StdHepPz", Pz);
+    tree->SetBranchAddress("StdHepE", E);
+    return true;
+  }
+
+  void Unpack(Int_t StdHepN) {
+    if (!Compact) {
+      return;
+    }
+    for (Int_t prt = 0; (prt < StdHepN) && (prt < kNPmax); ++prt) {
+      P4[prt][0] = Px[prt];
+      P4[prt][1] = Py[prt];
+      P4[prt][2] = Pz[prt];
+      P4[prt][3] = E[prt];
+    }
+  }
+
+  static bool IsCompact(TTree *tree) {
+    return (!tree->GetBranch("StdHepP4") && tree->GetBranch("StdHepPx"));
+  }
+
+  // The TTree::Draw expression for component comp (0-3: Px, Py, Pz, E) of
+  // particle prt, for whichever schema tree was written with.
+  static TString Expr(TTree *tree, Int_t prt, Int_t comp) {
+    if (!IsCompact(tree)) {
+      return TString::Format("StdHepP4[%d][%d]", prt, comp);
+    }
+    static char const *Names[] = {"StdHepPx", "StdHepPy", "StdHepPz",
+                                  "StdHepE"};
+    return TString::Format("%s[%d]", Names[comp], prt);
+  }
+
+ private:
+  Double_t (*P4)[4];
+  bool Compact;
+  Double_t Px[kNPmax];
+  Double_t Py[kNPmax];
+  Double_t Pz[kNPmax];
+  Double_t E[kNPmax];
+};
+
+#endif
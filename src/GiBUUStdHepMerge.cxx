@@ -0,0 +1,468 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "TClass.h"
+#include "TFile.h"
+#include "TH1.h"
+#include "TKey.h"
+#include "TList.h"
+#include "TTree.h"
+
+#include "LUtils/Debugging.hxx"
+
+#include "GiBUUToStdHep_Output.hxx"
+
+namespace Opts {
+std::vector<std::string> InputFNames;
+std::string OutputFName = "";
+} // namespace Opts
+
+// The GiBUUToStdHep option handlers are linked in with the output code, so
+// these are kept out of their way.
+namespace {
+
+///\brief An output file of GiBUUToStdHep --shard i/N.
+struct Shard {
+  std::string FileName;
+  TFile *File;
+  TTree *Tree;
+  ///\brief The kWeightsTreeName friend tree of Tree, if it has one.
+  TTree *WeightsTree;
+  size_t Index;
+  size_t NShards;
+  std::vector<InputFileRecord> Records;
+  ///\brief Whether the shard has a kMetaTreeName tree to read Options from.
+  bool HaveOptions;
+  ConversionOptionsRecord Options;
+};
+
+bool ShardIndexLess(Shard const &l, Shard const &r) {
+  return l.Index < r.Index;
+}
+
+///\brief How GiBUUToStdHep normalises a histogram that it writes, which
+/// determines how the histograms of each shard are combined.
+enum HistNorm {
+  ///\brief Sums of event weights, which are added.
+  kSumOfWeights,
+  ///\brief Sums of event weights that were then scaled by the number of events
+  /// in the shard, which are rescaled to the number of events in all shards.
+  kSumOfWeightsTimesNEvents,
+  ///\brief The dominant flux scaled by the number of events in the shard.
+  kFluxTimesNEvents,
+  ///\brief The input fluxes, which are the same for every shard.
+  kSameInEveryShard
+};
+
+bool EndsWith(std::string const &str, std::string const &suffix) {
+  return (str.size() >= suffix.size()) &&
+         !str.compare(str.size() - suffix.size(), suffix.size(), suffix);
+}
+
+// Follows the naming in GiBUUToStdHep.cxx, SaveFluxFile and the electron
+// scattering set up.
+HistNorm GetHistNorm(std::string const &Name) {
+  if (EndsWith(Name, "_xsec") || (Name == "evt_per_NEvents")) {
+    return kSumOfWeights;
+  }
+  if (EndsWith(Name, "_evrate") || (Name == "e_evt")) {
+    return kSumOfWeightsTimesNEvents;
+  }
+  if (Name == "evt") {
+    return kFluxTimesNEvents;
+  }
+  return kSameInEveryShard;
+}
+
+bool Handle_OutputFile(std::string const &opt) {
+  Opts::OutputFName = opt;
+  std::cout << "\t--Writing to file " << Opts::OutputFName << std::endl;
+  return true;
+}
+
+bool Handle_InputFile(std::string const &opt) {
+  Opts::InputFNames.push_back(opt);
+  std::cout << "\t--Merging shard " << opt << std::endl;
+  return true;
+}
+
+void SayRunLike(char const *argv[]) {
+  std::cout << "[USAGE]: " << argv[0]
+            << " -o <merged.root> <shard 0.root> ... <shard N-1.root>"
+               "\n-----------------------------------\n"
+            << "\n\t[Arg]: (-h|--help)"
+            << "\n\t[Arg]: (-o|--output-file) <Output file name> [Required]"
+            << "\n\t[Arg]: <Output file of GiBUUToStdHep --shard i/N> "
+               "[Required for each shard]"
+            << std::endl;
+}
+
+bool HandleArgs(int argc, char const *argv[]) {
+  std::vector<std::string> ArgArray;
+  for (int opt_it = 1; opt_it < argc; ++opt_it) {
+    ArgArray.push_back(argv[opt_it]);
+  }
+
+  bool LastArgOkay = true;
+  std::string arg, opt;
+  for (size_t opt_it = 0; opt_it < ArgArray.size();) {
+    if (!LastArgOkay) {
+      UDBError("Argument: \""
+               << arg
+               << (opt.length() ? std::string(" ") + opt : std::string(""))
+               << "\" was not correctly understood.");
+      return false;
+    }
+    arg = ArgArray[opt_it++];
+    opt = "";
+    if (("-o" == arg) || ("--output-file" == arg)) {
+      if (opt_it == ArgArray.size()) {
+        UDBError("Parameter -o expected an option.");
+        SayRunLike(argv);
+        exit(1);
+      }
+      opt = ArgArray[opt_it++];
+      LastArgOkay = Handle_OutputFile(opt);
+      continue;
+    }
+    if (("-?" == arg) || ("-h" == arg) || ("--help" == arg)) {
+      SayRunLike(argv);
+      exit(0);
+    }
+    if (arg.size() && (arg[0] == '-')) {
+      std::cout << "[ERROR]: Unexpected argument: " << arg << std::endl;
+      SayRunLike(argv);
+      exit(1);
+    }
+    LastArgOkay = Handle_InputFile(arg);
+  }
+  if (!Opts::OutputFName.length()) {
+    std::cout << "[ERROR]: Expected -o argument to specify output file."
+              << std::endl;
+    return false;
+  }
+  if (!Opts::InputFNames.size()) {
+    std::cout << "[ERROR]: Expected the output files of each shard to merge."
+              << std::endl;
+    return false;
+  }
+  return LastArgOkay;
+}
+
+std::vector<std::string> GetBranchNames(TTree *Tree) {
+  std::vector<std::string> Names;
+  TIter next(Tree->GetListOfBranches());
+  TObject *Branch;
+  while ((Branch = next())) {
+    Names.push_back(Branch->GetName());
+  }
+  return Names;
+}
+
+bool OpenShards(std::vector<Shard> &Shards) {
+  for (size_t f_it = 0; f_it < Opts::InputFNames.size(); ++f_it) {
+    Shard s;
+    s.FileName = Opts::InputFNames[f_it];
+    s.File = TFile::Open(s.FileName.c_str());
+    if (!s.File || s.File->IsZombie()) {
+      UDBError("Could not open " << s.FileName << ".");
+      return false;
+    }
+    s.Tree = NULL;
+    s.File->GetObject("giRooTracker", s.Tree);
+    if (!s.Tree) {
+      UDBError("Found no giRooTracker tree in " << s.FileName << ".");
+      return false;
+    }
+    if (!ReadShardInfo(s.File, s.Index, s.NShards)) {
+      UDBError(s.FileName << " was not converted with GiBUUToStdHep --shard, "
+                             "its event weights cannot be combined with "
+                             "those of other files.");
+      return false;
+    }
+    if (!ReadInputFileRecords(s.File, s.Records)) {
+      UDBError("Found no " << kInputFilesTreeName << " tree in " << s.FileName
+                           << ".");
+      return false;
+    }
+    s.HaveOptions = ReadConversionOptions(s.File, s.Options);
+    // The weights are copied separately, and must not be cloned with the tree.
+    TTree *Friend = s.Tree->GetFriend(kWeightsTreeName);
+    if (Friend) {
+      s.Tree->RemoveFriend(Friend);
+    }
+    s.WeightsTree = NULL;
+    s.File->GetObject(kWeightsTreeName, s.WeightsTree);
+    if (s.WeightsTree &&
+        (s.WeightsTree->GetEntries() != s.Tree->GetEntries())) {
+      UDBError("The " << kWeightsTreeName << " tree in " << s.FileName
+                      << " does not have an entry for every event.");
+      return false;
+    }
+    Shards.push_back(s);
+  }
+
+  std::stable_sort(Shards.begin(), Shards.end(), ShardIndexLess);
+  size_t const NShards = Shards.front().NShards;
+  if (Shards.size() != NShards) {
+    UDBError("Expected " << NShards << " shards, but was given "
+                         << Shards.size() << ".");
+    return false;
+  }
+  std::vector<std::string> const BranchNames =
+      GetBranchNames(Shards.front().Tree);
+  std::set<std::string> InputFiles;
+  for (size_t s_it = 0; s_it < Shards.size(); ++s_it) {
+    Shard const &s = Shards[s_it];
+    if ((s.NShards != NShards) || (s.Index != s_it)) {
+      UDBError("Expected shard " << s_it << "/" << NShards << ", but "
+                                 << s.FileName << " is shard " << s.Index
+                                 << "/" << s.NShards << ".");
+      return false;
+    }
+    if (GetBranchNames(s.Tree) != BranchNames) {
+      UDBError("The giRooTracker tree in "
+               << s.FileName << " has different branches to that in "
+               << Shards.front().FileName
+               << ", were the shards converted with the same options?");
+      return false;
+    }
+    for (size_t r_it = 0; r_it < s.Records.size(); ++r_it) {
+      if (!InputFiles.insert(s.Records[r_it].FileName).second) {
+        UDBError("Input file " << s.Records[r_it].FileName
+                               << " was converted into more than one shard.");
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Gets the conversion options of the shards for the merged kMetaTreeName tree.
+// Shards that were converted with different options are warned about, as
+// their events cannot be normalised together.
+ConversionOptionsRecord
+GetMergedConversionOptions(std::vector<Shard> const &Shards) {
+  Shard const *First = NULL;
+  for (size_t s_it = 0; s_it < Shards.size(); ++s_it) {
+    Shard const &s = Shards[s_it];
+    if (!s.HaveOptions) {
+      UDBWarn("Found no " << kMetaTreeName << " tree in " << s.FileName
+                          << ", it was written by an older GiBUUToStdHep.");
+      continue;
+    }
+    if (!First) {
+      First = &s;
+    } else if (s.Options != First->Options) {
+      UDBWarn(s.FileName << " was converted with different options to "
+                         << First->FileName << ", the " << kMetaTreeName
+                         << " tree gives those of " << First->FileName
+                         << ".");
+    }
+  }
+  if (!First) {
+    UDBWarn("Found no conversion options in any shard, the "
+            << kMetaTreeName << " tree gives the defaults.");
+    return ConversionOptionsRecord();
+  }
+  return First->Options;
+}
+
+// Writes the kWeightsTreeName friend tree of Merged with the weights of every
+// shard: those of its own friend tree if it was appended to or reweighted, or
+// those in its giRooTracker tree if not.
+void WriteMergedWeightsTree(TTree *Merged, std::vector<Shard> const &Shards) {
+  TTree *WeightsTree =
+      new TTree(kWeightsTreeName, "Recomputed GiBUU event weights");
+  Double_t NumRunsWeight = 1;
+  Double_t FileExtraWeight = 1;
+  Double_t EvtWght = 0;
+  WeightsTree->Branch("NumRunsWeight", &NumRunsWeight, "NumRunsWeight/D");
+  WeightsTree->Branch("FileExtraWeight", &FileExtraWeight,
+                      "FileExtraWeight/D");
+  WeightsTree->Branch("EvtWght", &EvtWght, "EvtWght/D");
+
+  for (size_t s_it = 0; s_it < Shards.size(); ++s_it) {
+    TTree *Source =
+        Shards[s_it].WeightsTree ? Shards[s_it].WeightsTree : Shards[s_it].Tree;
+    Source->SetBranchStatus("*", false);
+    Source->SetBranchStatus("NumRunsWeight", true);
+    Source->SetBranchStatus("FileExtraWeight", true);
+    Source->SetBranchStatus("EvtWght", true);
+    Source->SetBranchAddress("NumRunsWeight", &NumRunsWeight);
+    Source->SetBranchAddress("FileExtraWeight", &FileExtraWeight);
+    Source->SetBranchAddress("EvtWght", &EvtWght);
+    for (Long64_t e_it = 0; e_it < Source->GetEntries(); ++e_it) {
+      Source->GetEntry(e_it);
+      WeightsTree->Fill();
+    }
+    Source->ResetBranchAddresses();
+    Source->SetBranchStatus("*", true);
+  }
+
+  WeightsTree->Write("", TObject::kOverwrite);
+  Merged->AddFriend(WeightsTree);
+}
+
+// Combines the histogram Name of every shard as a single conversion of all of
+// their input files would have made it.
+TH1 *MergeHist(std::vector<Shard> const &Shards, std::string const &Name) {
+  std::vector<TH1 *> Hists;
+  for (size_t s_it = 0; s_it < Shards.size(); ++s_it) {
+    TH1 *h = NULL;
+    Shards[s_it].File->GetObject(Name.c_str(), h);
+    if (!h) {
+      UDBError("Found no histogram " << Name << " in "
+                                     << Shards[s_it].FileName << ".");
+      return NULL;
+    }
+    Hists.push_back(h);
+  }
+
+  // GiBUUToStdHep scales some histograms by the number of events that it
+  // wrote.
+  Long64_t NEvents = 0;
+  for (size_t s_it = 0; s_it < Shards.size(); ++s_it) {
+    NEvents += Shards[s_it].Tree->GetEntries();
+  }
+
+  TH1 *Merged = static_cast<TH1 *>(Hists.front()->Clone(Name.c_str()));
+  Merged->SetDirectory(NULL);
+  switch (GetHistNorm(Name)) {
+  case kSumOfWeights: {
+    for (size_t s_it = 1; s_it < Hists.size(); ++s_it) {
+      Merged->Add(Hists[s_it]);
+    }
+    break;
+  }
+  case kSumOfWeightsTimesNEvents: {
+    Merged->Reset();
+    for (size_t s_it = 0; s_it < Hists.size(); ++s_it) {
+      Long64_t const NShardEvents = Shards[s_it].Tree->GetEntries();
+      if (NShardEvents) {
+        Merged->Add(Hists[s_it], double(NEvents) / double(NShardEvents));
+      }
+    }
+    break;
+  }
+  case kFluxTimesNEvents: {
+    for (size_t s_it = 0; s_it < Hists.size(); ++s_it) {
+      Long64_t const NShardEvents = Shards[s_it].Tree->GetEntries();
+      if (NShardEvents) {
+        delete Merged;
+        Merged = static_cast<TH1 *>(Hists[s_it]->Clone(Name.c_str()));
+        Merged->SetDirectory(NULL);
+        Merged->Scale(double(NEvents) / double(NShardEvents));
+        break;
+      }
+    }
+    break;
+  }
+  case kSameInEveryShard: {
+    for (size_t s_it = 1; s_it < Hists.size(); ++s_it) {
+      for (Int_t b_it = 0; b_it < Merged->GetSize(); ++b_it) {
+        if (Hists[s_it]->GetBinContent(b_it) != Merged->GetBinContent(b_it)) {
+          UDBWarn("Histogram " << Name << " differs between "
+                               << Shards.front().FileName << " and "
+                               << Shards[s_it].FileName
+                               << ", keeping the first.");
+          break;
+        }
+      }
+    }
+    break;
+  }
+  }
+
+  for (size_t s_it = 0; s_it < Hists.size(); ++s_it) {
+    delete Hists[s_it];
+  }
+  return Merged;
+}
+
+int Merge() {
+  std::vector<Shard> Shards;
+  if (!OpenShards(Shards)) {
+    return 1;
+  }
+
+  TFile *OutFile = new TFile(Opts::OutputFName.c_str(), "RECREATE");
+  if (!OutFile->IsOpen()) {
+    UDBError("Couldn't open output file.");
+    return 2;
+  }
+  OutFile->SetCompressionSettings(
+      Shards.front().File->GetCompressionSettings());
+  OutFile->cd();
+
+  // The shards are concatenated in order, so the merged entries are in the
+  // same order as those of a single conversion.
+  TTree *Merged = Shards.front().Tree->CloneTree(0);
+  std::vector<InputFileRecord> Records;
+  bool HaveWeightsTree = false;
+  for (size_t s_it = 0; s_it < Shards.size(); ++s_it) {
+    Shard const &s = Shards[s_it];
+    Long64_t const FirstEntry = Merged->GetEntries();
+    Merged->CopyEntries(s.Tree, -1, "fast");
+    UDBLog("Merged " << s.Tree->GetEntries() << " entries from "
+                     << s.FileName << ".");
+    HaveWeightsTree = HaveWeightsTree || s.WeightsTree;
+    for (size_t r_it = 0; r_it < s.Records.size(); ++r_it) {
+      InputFileRecord rec = s.Records[r_it];
+      rec.FirstEntry += FirstEntry;
+      Records.push_back(rec);
+    }
+  }
+  WriteInputFileRecords(Records, GetMergedConversionOptions(Shards));
+
+  // Only shards that were appended to or reweighted have weights that differ
+  // from those in the giRooTracker tree.
+  if (HaveWeightsTree) {
+    WriteMergedWeightsTree(Merged, Shards);
+  }
+
+  std::set<std::string> HistNames;
+  TIter next(Shards.front().File->GetListOfKeys());
+  TKey *Key;
+  while ((Key = static_cast<TKey *>(next()))) {
+    TClass *KeyClass = TClass::GetClass(Key->GetClassName());
+    if (!KeyClass || !KeyClass->InheritsFrom(TH1::Class()) ||
+        !HistNames.insert(Key->GetName()).second) {
+      continue;
+    }
+    TH1 *h = MergeHist(Shards, Key->GetName());
+    if (!h) {
+      return 1;
+    }
+    OutFile->WriteTObject(h, Key->GetName());
+    delete h;
+  }
+
+  Long64_t const NEntries = Merged->GetEntries();
+  Merged->Write();
+  OutFile->Close();
+  UDBLog("Wrote " << NEntries << " entries from "
+                  << Records.size() << " input files to "
+                  << Opts::OutputFName << ".");
+
+  delete OutFile;
+  for (size_t s_it = 0; s_it < Shards.size(); ++s_it) {
+    Shards[s_it].File->Close();
+    delete Shards[s_it].File;
+  }
+  return 0;
+}
+} // namespace
+
+int main(int argc, char const *argv[]) {
+  if (!HandleArgs(argc, argv)) {
+    SayRunLike(argv);
+    return 1;
+  }
+
+  return Merge();
+}
@@ -0,0 +1,296 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "LUtils/Debugging.hxx"
+#include "LUtils/Utils.hxx"
+
+#include "GiBUUToStdHep_Synthetic.hxx"
+
+namespace Opts {
+std::string OutputFName = "";
+GiBUUSynthetic::Config Config;
+} // namespace Opts
+
+// The GiBUUToStdHep option handlers are linked in with the particle code
+// conversions, so these are kept out of their way.
+namespace {
+bool Handle_OutputFile(std::string const &opt) {
+  Opts::OutputFName = opt;
+  std::cout << "\t--Writing to file " << Opts::OutputFName << std::endl;
+  return true;
+}
+
+bool Handle_NEvents(std::string const &opt) {
+  int ival = 0;
+  try {
+    ival = Utils::str2i(opt, true);
+  } catch (...) {
+    return false;
+  }
+  if (ival < 1) {
+    UDBError("Expected a positive number of events, but found: " << opt);
+    return false;
+  }
+  Opts::Config.NEvents = size_t(ival);
+  std::cout << "\t--Writing " << ival << " events." << std::endl;
+  return true;
+}
+
+bool Handle_Size(std::string const &opt) {
+  if (!opt.size()) {
+    return false;
+  }
+  double Multiplier = 1;
+  std::string num = opt;
+  switch (opt[opt.size() - 1]) {
+  case 'k': {
+    Multiplier = 1E3;
+    break;
+  }
+  case 'M': {
+    Multiplier = 1E6;
+    break;
+  }
+  case 'G': {
+    Multiplier = 1E9;
+    break;
+  }
+  default: {}
+  }
+  if (Multiplier != 1) {
+    num = opt.substr(0, opt.size() - 1);
+  }
+  double dval = 0;
+  try {
+    dval = Utils::str2d(num, true);
+  } catch (...) {
+    return false;
+  }
+  if (dval <= 0) {
+    UDBError("Expected a positive file size, but found: " << opt);
+    return false;
+  }
+  Opts::Config.MaxBytes = size_t(dval * Multiplier);
+  std::cout << "\t--Writing events until the file is " << Opts::Config.MaxBytes
+            << " bytes." << std::endl;
+  return true;
+}
+
+bool Handle_Multiplicity(std::string const &opt) {
+  double dval = 0;
+  try {
+    dval = Utils::str2d(opt, true);
+  } catch (...) {
+    return false;
+  }
+  if (dval < 1) {
+    UDBError("Expected a mean multiplicity of at least 1, but found: " << opt);
+    return false;
+  }
+  Opts::Config.MeanMultiplicity = dval;
+  std::cout << "\t--Mean final state hadron multiplicity: " << dval
+            << std::endl;
+  return true;
+}
+
+bool Handle_nuPDG(std::string const &opt) {
+  try {
+    Opts::Config.ProbePDG = Utils::str2i(opt, true);
+  } catch (...) {
+    return false;
+  }
+  std::cout << "\t--Neutrino PDG: " << Opts::Config.ProbePDG << std::endl;
+  return true;
+}
+
+bool Handle_EProbe(std::string const &opt) {
+  try {
+    Opts::Config.EProbe = Utils::str2d(opt, true);
+  } catch (...) {
+    return false;
+  }
+  std::cout << "\t--Probe energy: " << Opts::Config.EProbe << " GeV"
+            << std::endl;
+  return true;
+}
+
+bool Handle_NRuns(std::string const &opt) {
+  int ival = 0;
+  try {
+    ival = Utils::str2i(opt, true);
+  } catch (...) {
+    return false;
+  }
+  if (ival < 1) {
+    UDBError("Expected a positive number of runs, but found: " << opt);
+    return false;
+  }
+  Opts::Config.NRuns = size_t(ival);
+  std::cout << "\t--Spreading events over " << ival << " runs." << std::endl;
+  return true;
+}
+
+bool Handle_Seed(std::string const &opt) {
+  int ival = 0;
+  try {
+    ival = Utils::str2i(opt, true);
+  } catch (...) {
+    return false;
+  }
+  Opts::Config.Seed = (unsigned long)(ival);
+  std::cout << "\t--Seed: " << ival << std::endl;
+  return true;
+}
+
+void SayRunLike(char const *argv[]) {
+  std::cout
+      << "[USAGE]: " << argv[0] << "\n-----------------------------------\n"
+
+      << "\n\t[Arg]: (-h|--help)"
+      << "\n\t[Arg]: (-o|--output-file) <Output file name> [Required] Les "
+         "Houches-style if it ends in .lhe, FinalEvents.dat-style otherwise."
+      << "\n\t[Arg]: (-n|--n-events) <N {default:10000}>"
+      << "\n\t[Arg]: (-s|--size) <bytes[k|M|G]> Write events until the file "
+         "is this large, instead of -n events."
+      << "\n\t[Arg]: (-m|--multiplicity) <Mean number of final state "
+         "hadrons {default:4}>"
+      << "\n\t[Arg]: (-u|--nu-pdg) <Neutrino PDG code {default:14}>"
+      << "\n\t[Arg]: (-N|--is-NC) Write NC neutrino events."
+      << "\n\t[Arg]: (-e|--e-scattering) Write electron scattering events."
+      << "\n\t[Arg]: (-K|--NDK) Write nucleon decay events (Les Houches "
+         "only)."
+      << "\n\t[Arg]: (-E|--probe-energy) <Mean probe energy in GeV "
+         "{default:1}>"
+      << "\n\t[Arg]: (-NI|--No-Initial-State) Don't write struck nucleon "
+         "lines."
+      << "\n\t[Arg]: (-NP|--No-Prod-Charge) Don't write the production charge "
+         "column."
+      << "\n\t[Arg]: (-r|--n-runs) <N {default:10}>"
+      << "\n\t[Arg]: (-S|--seed) <Seed {default:12345}>" << std::endl;
+}
+
+bool HandleArgs(int argc, char const *argv[]) {
+  std::vector<std::string> ArgArray;
+  for (int opt_it = 1; opt_it < argc; ++opt_it) {
+    ArgArray.push_back(argv[opt_it]);
+  }
+
+  bool LastArgOkay = true;
+  std::string arg, opt;
+  for (size_t opt_it = 0; opt_it < ArgArray.size();) {
+    if (!LastArgOkay) {
+      UDBError("Argument: \""
+               << arg
+               << (opt.length() ? std::string(" ") + opt : std::string(""))
+               << "\" was not correctly understood.");
+      return false;
+    }
+    arg = ArgArray[opt_it++];
+    opt = "";
+
+    bool (*Handler)(std::string const &) = NULL;
+    if (("-o" == arg) || ("--output-file" == arg)) {
+      Handler = Handle_OutputFile;
+    } else if (("-n" == arg) || ("--n-events" == arg)) {
+      Handler = Handle_NEvents;
+    } else if (("-s" == arg) || ("--size" == arg)) {
+      Handler = Handle_Size;
+    } else if (("-m" == arg) || ("--multiplicity" == arg)) {
+      Handler = Handle_Multiplicity;
+    } else if (("-u" == arg) || ("--nu-pdg" == arg)) {
+      Handler = Handle_nuPDG;
+    } else if (("-E" == arg) || ("--probe-energy" == arg)) {
+      Handler = Handle_EProbe;
+    } else if (("-r" == arg) || ("--n-runs" == arg)) {
+      Handler = Handle_NRuns;
+    } else if (("-S" == arg) || ("--seed" == arg)) {
+      Handler = Handle_Seed;
+    }
+    if (Handler) {
+      if (opt_it == ArgArray.size()) {
+        UDBError("Parameter " << arg << " expected an option.");
+        SayRunLike(argv);
+        exit(1);
+      }
+      opt = ArgArray[opt_it++];
+      LastArgOkay = Handler(opt);
+      continue;
+    }
+
+    if (("-N" == arg) || ("--is-NC" == arg)) {
+      Opts::Config.IsCC = false;
+      std::cout << "\t--Writing NC events." << std::endl;
+      continue;
+    }
+    if (("-e" == arg) || ("--e-scattering" == arg)) {
+      Opts::Config.EventMode = GiBUUSynthetic::Config::kElectron;
+      std::cout << "\t--Writing electron scattering events." << std::endl;
+      continue;
+    }
+    if (("-K" == arg) || ("--NDK" == arg)) {
+      Opts::Config.EventMode = GiBUUSynthetic::Config::kNDK;
+      std::cout << "\t--Writing nucleon decay events." << std::endl;
+      continue;
+    }
+    if (("-NI" == arg) || ("--No-Initial-State" == arg)) {
+      Opts::Config.StruckNucleonInfo = false;
+      std::cout << "\t--Not writing struck nucleon lines." << std::endl;
+      continue;
+    }
+    if (("-NP" == arg) || ("--No-Prod-Charge" == arg)) {
+      Opts::Config.ProdChargeInfo = false;
+      std::cout << "\t--Not writing the production charge column."
+                << std::endl;
+      continue;
+    }
+
+    if (("-?" == arg) || ("-h" == arg) || ("--help" == arg)) {
+      SayRunLike(argv);
+      exit(0);
+    }
+    std::cout << "[ERROR]: Unexpected argument: " << arg << std::endl;
+    SayRunLike(argv);
+    exit(1);
+  }
+  if (!Opts::OutputFName.length()) {
+    std::cout << "[ERROR]: Expected -o argument to specify output file."
+              << std::endl;
+    return false;
+  }
+  return LastArgOkay;
+}
+} // namespace
+
+///\brief Writes deterministic synthetic GiBUU output files, for benchmarking
+/// GiBUUToStdHep.exe.
+int main(int argc, char const *argv[]) {
+  if (!HandleArgs(argc, argv)) {
+    SayRunLike(argv);
+    return 1;
+  }
+
+  bool const LesHouches =
+      (Utils::SplitStringByDelim(Opts::OutputFName, ".").back() == "lhe");
+  if (!LesHouches && (Opts::Config.EventMode == GiBUUSynthetic::Config::kNDK)) {
+    UDBError("NDK events can only be written as Les Houches (.lhe) files.");
+    return 1;
+  }
+
+  std::ofstream ofs(Opts::OutputFName.c_str());
+  if (!ofs.good()) {
+    UDBError("Failed to open " << Opts::OutputFName << " for writing.");
+    return 1;
+  }
+
+  size_t const NEvents =
+      LesHouches ? GiBUUSynthetic::WriteLesHouches(ofs, Opts::Config)
+                 : GiBUUSynthetic::WriteFinalEvents(ofs, Opts::Config);
+  ofs.close();
+
+  std::cout << "[INFO]: Wrote " << NEvents << " events to "
+            << Opts::OutputFName << "." << std::endl;
+  return 0;
+}
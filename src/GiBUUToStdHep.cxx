@@ -1,14 +1,18 @@
 #include <algorithm>
+#include <exception>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <numeric>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <thread>
 
 #include "TFile.h"
 #include "TH1D.h"
+#include "TROOT.h"
 #include "TLorentzVector.h"
 #include "TTree.h"
 #include "TVector3.h"
@@ -17,6 +21,16 @@
 #include "LUtils/Utils.hxx"
 
 #include "GiBUUToStdHep_CLIOpts.hxx"
+#include "GiBUUToStdHep_Cache.hxx"
+#include "GiBUUToStdHep_Checkpoint.hxx"
+#include "GiBUUToStdHep_Diagnostics.hxx"
+#include "GiBUUToStdHep_Index.hxx"
+#include "GiBUUToStdHep_Input.hxx"
+#include "GiBUUToStdHep_Output.hxx"
+#include "GiBUUToStdHep_Parsing.hxx"
+#include "GiBUUToStdHep_Pipeline.hxx"
+#include "GiBUUToStdHep_Progress.hxx"
+#include "GiBUUToStdHep_Timing.hxx"
 #include "GiBUUToStdHep_Utils.hxx"
 
 #include "GiRooTracker.hxx"
@@ -31,60 +45,30 @@ int DomPDG = 0;
 TH1D *DomFlux = NULL;
 TH1D *DomEvt = NULL;
 
-GiBUUPartBlob GetParticleLine(std::string const &line) {
-  GiBUUPartBlob pblob;
-
-  std::vector<std::string> splitLine = Utils::SplitStringByDelim(line, " ");
-  if (splitLine.size() !=
-      (15 +
-       size_t(GiBUUToStdHepOpts::HaveProdChargeInfo))) { // try to fix known
-                                                         // parsing error
-    std::string ln =
-        Utils::Replace(line, "E-", "XXXXX"); // Guard any exponential notation
-    ln = Utils::Replace(ln, "-", " -");
-    ln = Utils::Replace(ln, "XXXXX", "E-");
-
-    splitLine = Utils::SplitStringByDelim(ln, " ");
-    if (splitLine.size() !=
-        (15 + size_t(GiBUUToStdHepOpts::HaveProdChargeInfo))) {
-      UDBWarn("Event had malformed particle line: \"" << line << "\"");
-      return pblob;
-    }
+// Fills the flux-weighted histograms with an event of a NuType probe.
+void FillFluxHists(int NuType, double EProbe, double EvtWght) {
+  if (FluxHists.count(NuType)) {
+    SigmaHists[NuType]->Fill(EProbe, EvtWght);
+    EvHists[NuType]->Fill(EProbe, EvtWght * FluxComponentIntegrals[NuType]);
   }
-
-  try {
-    pblob.Run = Utils::str2i(splitLine[0]);
-    pblob.EvNum = Utils::str2i(splitLine[1]);
-    pblob.ID = Utils::str2i(splitLine[2]);
-    pblob.Charge = Utils::str2i(splitLine[3]);
-    pblob.PerWeight = Utils::str2d(splitLine[4]);
-    pblob.Position[GiRooTracker::kStdHepIdxPx] = Utils::str2d(splitLine[5]);
-    pblob.Position[GiRooTracker::kStdHepIdxPy] = Utils::str2d(splitLine[6]);
-    pblob.Position[GiRooTracker::kStdHepIdxPz] = Utils::str2d(splitLine[7]);
-    pblob.FourMom[GiRooTracker::kStdHepIdxE] = Utils::str2d(splitLine[8]);
-    pblob.FourMom[GiRooTracker::kStdHepIdxPx] = Utils::str2d(splitLine[9]);
-    pblob.FourMom[GiRooTracker::kStdHepIdxPy] = Utils::str2d(splitLine[10]);
-    pblob.FourMom[GiRooTracker::kStdHepIdxPz] = Utils::str2d(splitLine[11]);
-    pblob.History = Utils::str2l(splitLine[12]);
-    pblob.Prodid = Utils::str2i(splitLine[13]);
-    pblob.EProbe = Utils::str2d(splitLine[14]);
-    if (GiBUUToStdHepOpts::HaveProdChargeInfo) {
-      pblob.ProdCharge = Utils::str2i(splitLine[15]);
-    }
-  } catch (const std::invalid_argument &ia) {
-    UDBError("Failed to parse one of the values: \"" << line << "\"");
-    throw;
+  if (NuType == DomPDG) {
+    DomEvt->Fill(EProbe, EvtWght * DomFCI);
   }
-
-  UDBVerbose("Parsed particle: " << pblob);
-
-  return pblob;
 }
 
-size_t FlushEventsToDisk(TTree *OutputTree, GiRooTracker *giRooTracker,
-                         size_t fileNumber, size_t NRunsInFile,
-                         std::vector<std::vector<GiBUUPartBlob>> &Events) {
+// Converts a batch of parsed events into GiRooTracker entries, which are
+// appended to Converted. Runs on the conversion stage thread, which is the only
+// thread that touches the flux-weighted histograms until the pipeline has
+// finished.
+size_t ConvertEvents(GiRooTracker *giRooTracker, ParsedEventBatch const &Batch,
+                     GiRooTrackerBatch &Converted) {
   size_t NumEvs = 0;
+  size_t const fileNumber = Batch.FileNumber;
+  size_t const NRunsInFile = Batch.NRunsInFile;
+  bool const HaveStruckNucleonInfo = Batch.HaveStruckNucleonInfo;
+  bool const HaveProdChargeInfo = Batch.HaveProdChargeInfo;
+  GiBUUEventBatch const &Events = Batch.Events;
+  Converted.FileNumber = fileNumber;
 
   double NRunsScaleFactor =
       GiBUUToStdHepOpts::NFilesAddedWeights[fileNumber] / double(NRunsInFile);
@@ -93,25 +77,23 @@ size_t FlushEventsToDisk(TTree *OutputTree, GiRooTracker *giRooTracker,
   int FileTargetA = GiBUUToStdHepOpts::TargetAs[fileNumber];
   int FileTargetZ = GiBUUToStdHepOpts::TargetZs[fileNumber];
   double FileExtraWeight = GiBUUToStdHepOpts::FileExtraWeights[fileNumber];
-  double TotalEventReweight =
-      NRunsScaleFactor * FileExtraWeight * GiBUUToStdHepOpts::OverallWeight;
 
-  size_t NEvents = Events.size();
+  size_t NEvents = Events.GetNEvents();
   for (size_t ev_it = 0; ev_it < NEvents; ++ev_it) {
-    std::vector<GiBUUPartBlob> const &ev = Events[ev_it];
+    size_t const PBegin = Events.EventOffsets[ev_it];
+    size_t const NParts = Events.EventOffsets[ev_it + 1] - PBegin;
+    Double_t const EProbe = Events.EProbe[ev_it];
     giRooTracker->Reset();
 
-    int const &EvNum = ev.front().EvNum;
+    // A malformed line anywhere in the event zeroes this.
+    int const &EvNum = Events.EvNum[ev_it];
 
     if (!EvNum) { // Malformed line
-      UDBWarn("Skipping event due to malformed line.");
+      GiBUUDiagWarn(GiBUUDiagnostics::kMalformedEvent,
+                    "Skipping event due to malformed line.");
       continue;
     }
 
-    if (!(NumEvs % 10000)) {
-      UDBInfo("Read " << NumEvs << " events.");
-    }
-
     giRooTracker->EvtNum = EvNum;
 
     if (!GiBUUToStdHepOpts::IsNDK) {
@@ -123,20 +105,20 @@ size_t FlushEventsToDisk(TTree *OutputTree, GiRooTracker *giRooTracker,
       giRooTracker->StdHepP4[0][GiRooTracker::kStdHepIdxPy] = 0;
       giRooTracker->StdHepP4[0][GiRooTracker::kStdHepIdxPz] =
           GiBUUToStdHepOpts::IsElectronScattering
-              ? sqrt(ev.front().EProbe * ev.front().EProbe -
+              ? sqrt(EProbe * EProbe -
                      511 * PhysConst::KeV * 511 * PhysConst::KeV)
-              : ev.front().EProbe;
-      giRooTracker->StdHepP4[0][GiRooTracker::kStdHepIdxE] = ev.front().EProbe;
+              : EProbe;
+      giRooTracker->StdHepP4[0][GiRooTracker::kStdHepIdxE] = EProbe;
 
       if (GiBUUToStdHepOpts::EScatteringInputEnergy = 0xdeadbeef) {
-        GiBUUToStdHepOpts::EScatteringInputEnergy = ev.front().EProbe;
+        GiBUUToStdHepOpts::EScatteringInputEnergy = EProbe;
       } else if (fabs(GiBUUToStdHepOpts::EScatteringInputEnergy -
-                      ev.front().EProbe) > 1E-5) {
+                      EProbe) > 1E-5) {
         UDBError("Read a differing input energy: First event: "
                  << GiBUUToStdHepOpts::EScatteringInputEnergy << ", event "
                  << EvNum << " in file \""
                  << GiBUUToStdHepOpts::InpFNames[fileNumber] << "\" had "
-                 << ev.front().EProbe);
+                 << EProbe);
         throw;
       }
     }
@@ -152,36 +134,22 @@ size_t FlushEventsToDisk(TTree *OutputTree, GiRooTracker *giRooTracker,
     giRooTracker->StdHepP4[targetIdx][GiRooTracker::kStdHepIdxE] = FileTargetA;
 
     // event meta-data
-    giRooTracker->GiBUUReactionCode = ev.front().Prodid;
-    if (GiBUUToStdHepOpts::HaveProdChargeInfo) {
-      giRooTracker->GiBUUPrimaryParticleCharge = ev.front().ProdCharge;
+    giRooTracker->GiBUUReactionCode = Events.Prodid[ev_it];
+    if (HaveProdChargeInfo) {
+      giRooTracker->GiBUUPrimaryParticleCharge = Events.ProdCharge[ev_it];
     }
-    giRooTracker->GiBUUPerWeight = ev.front().PerWeight;
+    giRooTracker->GiBUUPerWeight = Events.PerWeight[ev_it];
     giRooTracker->NumRunsWeight = NRunsScaleFactor;
     giRooTracker->FileExtraWeight = FileExtraWeight;
-    giRooTracker->EvtWght = giRooTracker->GiBUUPerWeight * TotalEventReweight *
-                            (GiBUUToStdHepOpts::IsElectronScattering ? 1E5 : 1);
+    giRooTracker->EvtWght = GetEvtWght(giRooTracker->GiBUUPerWeight,
+                                       NRunsScaleFactor, FileExtraWeight);
 
-    if (FluxHists.count(FileNuType)) {
-      SigmaHists[FileNuType]->Fill(ev.front().EProbe, giRooTracker->EvtWght);
-      EvHists[FileNuType]->Fill(ev.front().EProbe,
-                                giRooTracker->EvtWght *
-                                    FluxComponentIntegrals[FileNuType]);
-    }
-    if (FileNuType == DomPDG) {
-      DomEvt->Fill(ev.front().EProbe, giRooTracker->EvtWght * DomFCI);
-    }
+    FillFluxHists(FileNuType, EProbe, giRooTracker->EvtWght);
 
     giRooTracker->StdHepN = GiBUUToStdHepOpts::IsNDK ? 1 : 2;
 
-    bool BadEv = false;
-    for (size_t p_it = 0; p_it < ev.size(); ++p_it) {
-      GiBUUPartBlob const &part = ev[p_it];
-      if (!part.EvNum) { // Malformed line
-        UDBWarn("Skipping event due to malformed line.");
-        BadEv = true;
-        break;
-      }
+    for (size_t p_it = 0; p_it < NParts; ++p_it) {
+      size_t const part = PBegin + p_it;
 
       if (GiBUUToStdHepOpts::IsNDK) {
         if (p_it == 0) { // Pre-FSI Kaon information
@@ -191,7 +159,7 @@ size_t FlushEventsToDisk(TTree *OutputTree, GiRooTracker *giRooTracker,
           giRooTracker->StdHepStatus[giRooTracker->StdHepN] = 1; // All other FS
         }
       } else {
-        if (GiBUUToStdHepOpts::HaveStruckNucleonInfo &&
+        if (HaveStruckNucleonInfo &&
             (giRooTracker->StdHepN == 3)) {
           giRooTracker->StdHepStatus[giRooTracker->StdHepN] = 11;
         } else {
@@ -201,68 +169,71 @@ size_t FlushEventsToDisk(TTree *OutputTree, GiRooTracker *giRooTracker,
 
       // Particles read from LH files are already in PDG format
       giRooTracker->StdHepPdg[giRooTracker->StdHepN] =
-          part.IDIsPDG ? part.ID : GiBUUUtils::GiBUUToPDG(part.ID, part.Charge);
-
-      if (!giRooTracker->StdHepPdg[giRooTracker->StdHepN]) {
-        UDBWarn("Parsed part: " << part << " from file "
-                                << GiBUUToStdHepOpts::InpFNames[fileNumber]
-                                << " to have a PDG of 0.");
+          Events.IDIsPDG[part]
+              ? Events.ID[part]
+              : GiBUUUtils::GiBUUToPDG(Events.ID[part], Events.Charge[part]);
+
+      if (!giRooTracker->StdHepPdg[giRooTracker->StdHepN] &&
+          GiBUUDiagnostics::Count(GiBUUDiagnostics::kZeroPDGParticle)) {
+        GiBUUPartBlob pblob;
+        Events.GetParticle(ev_it, part, pblob);
+        std::stringstream ss("");
+        ss << "Parsed part: " << pblob << " from file "
+           << GiBUUToStdHepOpts::InpFNames[fileNumber]
+           << " to have a PDG of 0.";
+        GiBUUDiagnostics::Report(GiBUUDiagnostics::kZeroPDGParticle,
+                                 ss.str());
       }
       // A known unknown
       if (giRooTracker->StdHepPdg[giRooTracker->StdHepN] == -1) {
         giRooTracker->StdHepPdg[giRooTracker->StdHepN] = 0;
       }
 
-      giRooTracker
-          ->StdHepP4[giRooTracker->StdHepN][GiRooTracker::kStdHepIdxPx] =
-          part.FourMom.X();
-      giRooTracker
-          ->StdHepP4[giRooTracker->StdHepN][GiRooTracker::kStdHepIdxPy] =
-          part.FourMom.Y();
-      giRooTracker
-          ->StdHepP4[giRooTracker->StdHepN][GiRooTracker::kStdHepIdxPz] =
-          part.FourMom.Z();
-      giRooTracker->StdHepP4[giRooTracker->StdHepN][GiRooTracker::kStdHepIdxE] =
-          part.FourMom.E();
-
-      giRooTracker->GiBHepHistory[giRooTracker->StdHepN] = part.History;
-#ifndef CPP03COMPAT
-      auto const &hDec = GiBUUUtils::DecomposeGiBUUHistory(part.History);
-      giRooTracker->GiBHepGeneration[giRooTracker->StdHepN] = std::get<0>(hDec);
+      // Both are ordered Px, Py, Pz, E.
+      std::copy(Events.FourMom.begin() + 4 * part,
+                Events.FourMom.begin() + 4 * (part + 1),
+                giRooTracker->StdHepP4[giRooTracker->StdHepN]);
 
-      if (std::get<1>(hDec) == -1) { // If this was produced by a 3 body
-                                     // process
-        giRooTracker->GiBHepMother[giRooTracker->StdHepN] = std::get<1>(hDec);
-        giRooTracker->GiBHepFather[giRooTracker->StdHepN] = std::get<2>(hDec);
-      } else {
-        giRooTracker->GiBHepMother[giRooTracker->StdHepN] =
-            GiBUUUtils::GiBUUToPDG(std::get<1>(hDec));
-        giRooTracker->GiBHepFather[giRooTracker->StdHepN] =
-            GiBUUUtils::GiBUUToPDG(std::get<2>(hDec));
-      }
-#endif
+      giRooTracker->GiBHepHistory[giRooTracker->StdHepN] = Events.History[part];
 
       giRooTracker->StdHepN++;
       if (giRooTracker->StdHepN == GiRooTracker::kGiStdHepNPmax) {
-        UDBWarn("In file " << GiBUUToStdHepOpts::InpFNames[fileNumber]
-                           << ", event " << EvNum
-                           << " contained to many final state particles "
-                           << ev.size() << ". Ignoring the last: "
-                           << (ev.size() - GiRooTracker::kGiStdHepNPmax));
+        GiBUUDiagWarn(GiBUUDiagnostics::kTooManyParticles,
+                      "In file " << GiBUUToStdHepOpts::InpFNames[fileNumber]
+                                 << ", event " << EvNum
+                                 << " contained to many final state particles "
+                                 << NParts << ". Ignoring the last: "
+                                 << (NParts - GiRooTracker::kGiStdHepNPmax));
         break;
       }
     }
 
-    if (BadEv) {
-      continue;
-    } // If we broke then don't bother continuing
-      // processing.
+#ifndef CPP03COMPAT
+    // Decode the history of all of the event's particles at once.
+    Int_t const FirstPart = GiBUUToStdHepOpts::IsNDK ? 1 : 2;
+    GiBUUUtils::DecomposeGiBUUHistories(
+        giRooTracker->GiBHepHistory + FirstPart,
+        size_t(giRooTracker->StdHepN - FirstPart),
+        giRooTracker->GiBHepGeneration + FirstPart,
+        giRooTracker->GiBHepMother + FirstPart,
+        giRooTracker->GiBHepFather + FirstPart);
+    for (Int_t p_it = FirstPart; p_it < giRooTracker->StdHepN; ++p_it) {
+      // Three body process codes are left as they are.
+      if (giRooTracker->GiBHepMother[p_it] != -1) {
+        giRooTracker->GiBHepMother[p_it] =
+            GiBUUUtils::GiBUUToPDG(giRooTracker->GiBHepMother[p_it]);
+        giRooTracker->GiBHepFather[p_it] =
+            GiBUUUtils::GiBUUToPDG(giRooTracker->GiBHepFather[p_it]);
+      }
+    }
+#endif
 
     if (GiBUUToStdHepOpts::IsElectronScattering) {
       giRooTracker->GiBUU2NeutCode = GiBUUUtils::GiBUU2NeutReacCode_escat(
           giRooTracker->GiBUUReactionCode, giRooTracker->StdHepPdg);
     } else if (!GiBUUToStdHepOpts::IsNDK) {
       try {
+        GiBUUTiming::ScopedTimer timer(GiBUUTiming::kReactionCode);
         giRooTracker->GiBUU2NeutCode = GiBUUUtils::GiBUU2NeutReacCode(
             giRooTracker->GiBUUReactionCode, giRooTracker->StdHepPdg,
 
@@ -270,15 +241,15 @@ size_t FlushEventsToDisk(TTree *OutputTree, GiRooTracker *giRooTracker,
             giRooTracker->GiBHepHistory,
 #endif
             giRooTracker->StdHepN, FileIsCC,
-            (GiBUUToStdHepOpts::HaveStruckNucleonInfo) ? 3 : -1,
-            GiBUUToStdHepOpts::HaveProdChargeInfo
+            (HaveStruckNucleonInfo) ? 3 : -1,
+            HaveProdChargeInfo
                 ? giRooTracker->GiBUUPrimaryParticleCharge
                 : -10);
       } catch (...) {
         UDBLog("Caught error in " << GiBUUToStdHepOpts::InpFNames[fileNumber]
-                                  << ":" << ev.front().ln);
+                                  << ":" << Events.ln[PBegin]);
         if (GiBUUToStdHepOpts::StrictMode) {
-          return 1;
+          break;
         } else {
           continue;
         }
@@ -289,7 +260,7 @@ size_t FlushEventsToDisk(TTree *OutputTree, GiRooTracker *giRooTracker,
       if (!GiBUUToStdHepOpts::IsNDK) {
         UDBInfo("EvNo: "
                 << EvNum << ", contained " << giRooTracker->StdHepN << " ("
-                << ev.size()
+                << NParts
                 << ") particles. "
                    "Event Weight: "
                 << std::setprecision(3) << giRooTracker->GiBUUPerWeight
@@ -303,7 +274,7 @@ size_t FlushEventsToDisk(TTree *OutputTree, GiRooTracker *giRooTracker,
                        giRooTracker->StdHepP4[0][GiRooTracker::kStdHepIdxE])
                 << " (" << giRooTracker->StdHepPdg[0] << ")");
         UDBInfo("\t[Target] : " << giRooTracker->StdHepPdg[1]);
-        if (GiBUUToStdHepOpts::HaveStruckNucleonInfo) {
+        if (HaveStruckNucleonInfo) {
           UDBInfo("\t[Nuc In] : "
                   << TLorentzVector(
                          giRooTracker->StdHepP4[3][GiRooTracker::kStdHepIdxPx],
@@ -315,7 +286,7 @@ size_t FlushEventsToDisk(TTree *OutputTree, GiRooTracker *giRooTracker,
       } else {
         UDBInfo("EvNo: "
                 << EvNum << ", contained " << giRooTracker->StdHepN << " ("
-                << ev.size() << ") particles. "
+                << NParts << ") particles. "
                 << "\n\t[Init NDK particle] : "
                 << TLorentzVector(
                        giRooTracker->StdHepP4[1][GiRooTracker::kStdHepIdxPx],
@@ -330,7 +301,7 @@ size_t FlushEventsToDisk(TTree *OutputTree, GiRooTracker *giRooTracker,
       Int_t StartPoint =
           GiBUUToStdHepOpts::IsNDK
               ? 2
-              : ((!GiBUUToStdHepOpts::HaveStruckNucleonInfo) ? 3 : 4);
+              : ((!HaveStruckNucleonInfo) ? 3 : 4);
       for (Int_t stdHepInd = StartPoint; stdHepInd < giRooTracker->StdHepN;
            ++stdHepInd) {
         UDBInfo(
@@ -365,71 +336,246 @@ size_t FlushEventsToDisk(TTree *OutputTree, GiRooTracker *giRooTracker,
                 << " (" << giRooTracker->StdHepPdg[2] << ")" << std::endl);
       }
     }
-    OutputTree->Fill();
+    Converted.Append(*giRooTracker);
     NumEvs++;
   }
-  UDBInfo("Wrote " << NumEvs << " events to disk.");
-  Events.clear();
   return NumEvs;
 }
 
-std::istream &Ignoreline(std::ifstream &in, std::ifstream::pos_type &pos) {
-  pos = in.tellg();
-  return in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+namespace {
+// The number of events parsed before they are handed to the conversion stage.
+size_t const kEventBatchSize = 1E4;
+// The number of batches that may be waiting between two pipeline stages.
+size_t const kPipelineDepth = 4;
+// The number of batches of a compressed file that may be held back while the
+// number of runs in it is unknown. Only small files are read once this way,
+// larger ones are decompressed a second time to find their last line rather
+// than holding their events in memory.
+size_t const kMaxDeferredBatches = 2;
+} // namespace
+
+typedef BatchChannel<ParsedEventBatch> ParsedEventChannel;
+typedef BatchChannel<ConvertedEventBatch> ConvertedEventChannel;
+
+ParsedEventBatch *NewParsedEventBatch(ParsedEventChannel &Parsed,
+                                      size_t InputFile, size_t fileNumber,
+                                      size_t NRunsInFile, bool IsLesHouches) {
+  ParsedEventBatch *Batch = Parsed.Acquire();
+  Batch->Origin = BatchOrigin();
+  Batch->Origin.InputFile = InputFile;
+  Batch->FileNumber = fileNumber;
+  Batch->NRunsInFile = NRunsInFile;
+  // Les Houches files contain neither piece of information.
+  Batch->HaveStruckNucleonInfo =
+      !IsLesHouches && GiBUUToStdHepOpts::HaveStruckNucleonInfo;
+  Batch->HaveProdChargeInfo =
+      !IsLesHouches && GiBUUToStdHepOpts::HaveProdChargeInfo;
+  return Batch;
 }
 
-std::string GetLastLine(std::ifstream &in) {
-  std::ifstream::pos_type pos = in.tellg();
-
-  std::ifstream::pos_type lastPos;
-  while (in >> std::ws && Ignoreline(in, lastPos)) {
-    pos = lastPos;
+// Hands Batch to the conversion stage and replaces it with an empty batch for
+// the same file. Returns false if the conversion stage has stopped.
+bool PushParsedEventBatch(ParsedEventChannel &Parsed,
+                          std::unique_ptr<ParsedEventBatch> &Batch) {
+  ParsedEventBatch *Next = Parsed.Acquire();
+  Next->Origin = BatchOrigin();
+  Next->Origin.InputFile = Batch->Origin.InputFile;
+  Next->FileNumber = Batch->FileNumber;
+  Next->NRunsInFile = Batch->NRunsInFile;
+  Next->HaveStruckNucleonInfo = Batch->HaveStruckNucleonInfo;
+  Next->HaveProdChargeInfo = Batch->HaveProdChargeInfo;
+  if (!Parsed.Push(Batch.release())) {
+    delete Next;
+    return false;
   }
+  Batch.reset(Next);
+  return true;
+}
 
-  in.clear();
-  in.seekg(pos);
+// Gets the number of runs in a FinalEvents.dat file from the run number on its
+// last line.
+size_t GetNRunsFromLastLine(InputLineReader &reader) {
+  std::string line = reader.GetLastLine();
+  std::vector<std::string> splitLine = Utils::SplitStringByDelim(line, " ");
+  return splitLine.size() ? size_t(Utils::str2i(splitLine[0])) : 1;
+}
 
-  std::string line;
-  std::getline(in, line);
-  return line;
+// Hands the batches that were held back while the number of runs in their
+// file was unknown to the conversion stage, now that it is NRunsInFile.
+// Returns false if the conversion stage has stopped.
+bool PushDeferredBatches(
+    ParsedEventChannel &Parsed,
+    std::vector<std::unique_ptr<ParsedEventBatch> > &Deferred,
+    size_t NRunsInFile) {
+  for (size_t b_it = 0; b_it < Deferred.size(); ++b_it) {
+    Deferred[b_it]->NRunsInFile = NRunsInFile;
+    if (!Parsed.Push(Deferred[b_it].release())) {
+      Deferred.clear();
+      return false;
+    }
+  }
+  Deferred.clear();
+  return true;
 }
 
-int ParseACSIIEventVectors(TTree *OutputTree, GiRooTracker *giRooTracker) {
-  std::vector<std::vector<GiBUUPartBlob>> FileEvents;
-  // http://www2.research.att.com/~bs/bs_faq2.html
-  // People sometimes worry about the cost of std::vector growing incrementally.
-  // I used to worry about that and used reserve() to optimize the growth.
-  // After measuring my code and repeatedly having trouble finding the
-  // performance benefits of reserve() in real programs, I stopped using it
-  // except where it is needed to avoid iterator invalidation (a rare case in my
-  // code). Again: measure before you optimize.
-
-  size_t ParsedEvs = 0;
-  size_t fileNumber = 0;
-  size_t NumEvs = 0;
+// Parses a whole FinalEvents.dat file held in [begin, end) in byte-range
+// chunks on the threads of ChunkParser. Each chunk starts on an event boundary
+// and chunks are passed on in file order, so the output is identical to
+// reading the file serially. One more chunk than there are threads is kept in
+// flight, so that the threads carry on parsing while the events of the oldest
+// chunk are passed on.
+//
+// Parsing starts StartOffset bytes into the file, which must be the start of
+// an event. If Index is not NULL, chunk boundaries are taken from its event
+// blocks instead of being searched for. If Builder is not NULL, the index of
+// the file is accumulated in it, and if Cache is not NULL, each batch is
+// written to it.
+size_t
+ParseFinalEventsParallel(char const *begin, char const *end,
+                         unsigned long long StartOffset, size_t InputFile,
+                         size_t fileNumber, size_t NRunsInFile,
+                         ParsedEventChannel &Parsed,
+                         GiBUUParsing::FinalEventsChunkParser &ChunkParser,
+                         size_t &NLinesInFile,
+                         GiBUUIndex::FinalEventsIndex const *Index,
+                         GiBUUIndex::FinalEventsIndexBuilder *Builder,
+                         GiBUUCache::EventCacheWriter *Cache) {
+  size_t const NInFlight = GiBUUToStdHepOpts::NParseThreads + 1;
+  size_t const kChunkBytes = 16 * 1024 * 1024;
+
+  size_t NEvsInFile = 0;
+  size_t LineNum = 0;
+  std::vector<GiBUUParsing::FinalEventsChunk> Chunks(NInFlight);
+  size_t Oldest = 0, NQueued = 0;
+
+  char const *cursor = begin + StartOffset;
+  try {
+    for (;;) {
+      for (; (NQueued < NInFlight) && (cursor < end); ++NQueued) {
+        GiBUUParsing::FinalEventsChunk &chunk =
+            Chunks[(Oldest + NQueued) % NInFlight];
+        chunk.begin = cursor;
+        if (size_t(end - cursor) <= kChunkBytes) {
+          chunk.end = end;
+        } else if (Index) {
+          chunk.end = begin + Index->NextBlockOffset(
+                                  (unsigned long long)(cursor - begin) +
+                                  kChunkBytes);
+        } else {
+          chunk.end =
+              GiBUUParsing::FindNextEventBoundary(cursor + kChunkBytes, end);
+        }
+        chunk.Events.Clear();
+        chunk.NLines = 0;
+        chunk.BuildIndex = (Builder != NULL);
+        chunk.Index.Reset((unsigned long long)(cursor - begin));
+        cursor = chunk.end;
+        ChunkParser.Submit(chunk);
+      }
+      if (!NQueued) {
+        break;
+      }
+
+      GiBUUParsing::FinalEventsChunk &chunk = Chunks[Oldest];
+      ChunkParser.Wait(chunk);
+      Oldest = (Oldest + 1) % NInFlight;
+      NQueued--;
+
+      // Line numbers were counted from the start of each chunk.
+      for (size_t p_it = 0; p_it < chunk.Events.ln.size(); ++p_it) {
+        chunk.Events.ln[p_it] += LineNum;
+      }
+      LineNum += chunk.NLines;
+      NEvsInFile += chunk.Events.GetNEvents();
+      GiBUUTiming::AddLines(chunk.NLines);
+      GiBUUProgress::SetFileBytesRead((unsigned long long)(chunk.end - begin));
+      if (Builder) {
+        Builder->Append(chunk.Index);
+      }
+
+      if (chunk.Events.Empty()) {
+        continue;
+      }
+      ParsedEventBatch *Batch = NewParsedEventBatch(Parsed, InputFile,
+                                                    fileNumber, NRunsInFile,
+                                                    false);
+      // The chunk keeps the batch's old storage for its next use.
+      Batch->Events.Swap(chunk.Events);
+      Batch->Origin.Resumable = true;
+      Batch->Origin.EndOfFile = (chunk.end == end);
+      Batch->Origin.NextOffset = (unsigned long long)(chunk.end - begin);
+      if (Cache) {
+        Cache->AddBatch(Batch->Events, Batch->Origin.NextOffset);
+      }
+      if (!Parsed.Push(Batch)) {
+        ChunkParser.Cancel();
+        // The file was not read to the end, so there is nothing to index.
+        if (Builder) {
+          Builder->Reset();
+        }
+        if (Cache) {
+          Cache->Abandon();
+        }
+        return NEvsInFile;
+      }
+    }
+  } catch (...) {
+    // The chunks still being parsed must not outlive this frame.
+    ChunkParser.Cancel();
+    throw;
+  }
+  NLinesInFile = LineNum;
+  return NEvsInFile;
+}
 
-  for (size_t fname_it = 0; fname_it < GiBUUToStdHepOpts::InpFNames.size();
-       ++fname_it) {
+// The first stage of the conversion pipeline: reads each input file in turn
+// and passes batches of parsed events to the conversion stage.
+//
+// If Resume is not NULL, reading starts from the position that it records.
+int ParseInputFiles(ParsedEventChannel &Parsed,
+                    GiBUUCheckpoint::State const *Resume) {
+  size_t fileNumber = Resume ? Resume->FileNumber : 0;
+  // Started for the first file that is parsed in parallel, and then kept for
+  // every later one.
+  std::unique_ptr<GiBUUParsing::FinalEventsChunkParser> ChunkParser;
+
+  for (size_t fname_it = Resume ? Resume->InputFile : 0;
+       fname_it < GiBUUToStdHepOpts::InpFNames.size(); ++fname_it) {
     std::string const &fname = GiBUUToStdHepOpts::InpFNames[fname_it];
+    // Events before StartOffset have already been converted.
+    unsigned long long const StartOffset =
+        (Resume && (fname_it == Resume->InputFile)) ? Resume->Offset : 0;
 
     size_t NEvsInFile = 0;
+    size_t NRunsInFile = 1;
+    std::unique_ptr<ParsedEventBatch> Batch;
+    GiBUUTiming::AddInputFile(fname);
+    GiBUUProgress::StartFile(fname_it);
+
+    std::string format = GetInputFormatExtension(fname);
+
+    // Parsed FinalEvents.dat files are found in the cache by their contents.
+    std::string const CacheFileName =
+        ((format != "lhe") && !GiBUUToStdHepOpts::IsNDK &&
+         GiBUUToStdHepOpts::EventCacheDir.size())
+            ? GiBUUCache::GetCacheFileName(fname)
+            : std::string("");
+    GiBUUCache::EventCacheReader Cache;
+    bool const FromCache =
+        CacheFileName.size() && Cache.Open(CacheFileName) &&
+        (!StartOffset || Cache.SkipToOffset(StartOffset));
 
-    std::string format = Utils::SplitStringByDelim(fname, ".").back();
     if (format == "lhe") {
-      bool holder_SNI = GiBUUToStdHepOpts::HaveStruckNucleonInfo;
-      bool holder_PCI = GiBUUToStdHepOpts::HaveProdChargeInfo;
-      GiBUUToStdHepOpts::HaveStruckNucleonInfo = false;
-      GiBUUToStdHepOpts::HaveProdChargeInfo = false;
+      Batch.reset(NewParsedEventBatch(Parsed, fname_it, fileNumber, 1, true));
 
       LHVectorReader lhevr(fname);
 
-      UDBVerbose("Les Houches File with " << lhevr.CountEvents()
-                                          << " events found. ");
-
       size_t NParts = 0;
+      GiBUUTiming::StartLap();
       do {
-        std::vector<GiBUUPartBlob> ev = lhevr.ReadEvent();
-        if ((NParts = ev.size())) {
+        if ((NParts = lhevr.ReadEvent(Batch->Events))) {
+          Int_t &FirstID = Batch->Events.ID[
+              Batch->Events.EventOffsets[Batch->Events.GetNEvents() - 1]];
           if (!GiBUUToStdHepOpts::IsNDK) {
             // Have to force known FSLepton information
             int FSLeptonPDG = 0;
@@ -444,28 +590,54 @@ int ParseACSIIEventVectors(TTree *OutputTree, GiRooTracker *giRooTracker) {
                 FSLeptonPDG = FileNuType;
               }
             }
-            ev.front().ID = FSLeptonPDG;
+            FirstID = FSLeptonPDG;
           } else {
-            int FileNuType = 0;
-            ev.front().ID = 321;
+            FirstID = 321;
           }
-          FileEvents.push_back(ev);
+          NEvsInFile++;
         }
 
-        if (FileEvents.size() == 5E4) {
-          NEvsInFile += FlushEventsToDisk(OutputTree, giRooTracker, fileNumber,
-                                          1, FileEvents);
+        if (Batch->Events.GetNEvents() == kEventBatchSize) {
+          GiBUUProgress::SetFileBytesRead(lhevr.GetInputBytesRead());
+          if (!PushParsedEventBatch(Parsed, Batch)) {
+            return 1;
+          }
+          // Don't count waiting on the conversion stage as reading.
+          GiBUUTiming::StartLap();
         }
 
       } while (NParts);
-
-      if (FileEvents.size()) {
-        NEvsInFile += FlushEventsToDisk(OutputTree, giRooTracker, fileNumber, 1,
-                                        FileEvents);
+      GiBUUTiming::AddLines(lhevr.GetNLinesRead());
+
+    } else if (FromCache) {
+      NRunsInFile = Cache.GetNRuns();
+      UDBLog("Reading " << fname << " from event cache " << CacheFileName
+                        << ": " << Cache.GetNEvents() << " events, "
+                        << NRunsInFile << " runs.");
+      Batch.reset(NewParsedEventBatch(Parsed, fname_it, fileNumber,
+                                      NRunsInFile, false));
+
+      unsigned long long NextOffset = 0;
+      GiBUUTiming::StartLap();
+      while (Cache.NextBatch(Batch->Events, NextOffset)) {
+        GiBUUTiming::Lap(GiBUUTiming::kLineRead);
+        NEvsInFile += Batch->Events.GetNEvents();
+        GiBUUProgress::SetFileBytesRead(Cache.GetInputBytesRead());
+        // The last batch is passed on below.
+        if (Cache.AtEnd()) {
+          break;
+        }
+        Batch->Origin.Resumable = true;
+        Batch->Origin.NextOffset = NextOffset;
+        if (!PushParsedEventBatch(Parsed, Batch)) {
+          return 1;
+        }
+        // Don't count waiting on the conversion stage as reading.
+        GiBUUTiming::StartLap();
+      }
+      if (!StartOffset) {
+        GiBUUTiming::AddLines(Cache.GetNLines());
       }
-
-      GiBUUToStdHepOpts::HaveStruckNucleonInfo = holder_SNI;
-      GiBUUToStdHepOpts::HaveProdChargeInfo = holder_PCI;
 
     } else { // FinalEvents.dat
       if (GiBUUToStdHepOpts::IsNDK) {
@@ -474,115 +646,436 @@ int ParseACSIIEventVectors(TTree *OutputTree, GiRooTracker *giRooTracker) {
                   << std::endl;
         return 1;
       }
-      std::ifstream ifs(fname.c_str());
+      std::unique_ptr<InputLineReader> reader = OpenInputLineReader(
+          fname, GiBUUToStdHepOpts::UseMMapInput ||
+                     (GiBUUToStdHepOpts::NParseThreads > 1));
 
-      if (!ifs.good()) {
+      if (!reader->IsOpen()) {
         UDBError("Failed to open " << fname << " for reading.");
         return 1;
       }
 
+      // Compressed files can only be read from start to end.
+      MappedLineReader const *mreader =
+          dynamic_cast<MappedLineReader const *>(reader.get());
+      bool const ParallelParse =
+          (GiBUUToStdHepOpts::NParseThreads > 1) && mreader;
+      if ((GiBUUToStdHepOpts::NParseThreads > 1) && !mreader) {
+        UDBLog("Parsing compressed input " << fname << " on a single thread.");
+      }
+
+      GiBUUIndex::FinalEventsIndex Index;
+      bool const HaveIndex = GiBUUToStdHepOpts::UseInputIndex &&
+                             GiBUUIndex::ReadIndex(fname, Index);
+      bool const BuildIndex =
+          GiBUUToStdHepOpts::UseInputIndex && !HaveIndex && !StartOffset;
+      GiBUUIndex::FinalEventsIndexBuilder Builder;
+
+      // Only a file that is read in full can be cached.
+      GiBUUCache::EventCacheWriter CacheWriter;
+      if (CacheFileName.size() && !StartOffset) {
+        CacheWriter.Open(CacheFileName, fname);
+      }
+
+      // Finding the last line of a compressed file means decompressing all of
+      // it before it is parsed, so without an index the number of runs is
+      // taken from the last line parsed instead, and the batches parsed until
+      // then are held back. Once kMaxDeferredBatches are held, the file is
+      // read twice after all. The index written once the file has been read
+      // then spares later conversions both.
+      bool DeferNRuns = !HaveIndex && !reader->Seek(0);
+      std::vector<std::unique_ptr<ParsedEventBatch> > Deferred;
+
       /// Get NRuns
-      size_t NRunsInFile = 0;
-      std::string line = GetLastLine(ifs);
-      std::vector<std::string> splitLine = Utils::SplitStringByDelim(line, " ");
-      NRunsInFile = Utils::str2i(splitLine[0]);
-      UDBLog("Found " << NRunsInFile << " runs in " << fname << ".");
-
-      /// Rewind
-      ifs.clear();
-      ifs.seekg(0);
-
-      std::vector<GiBUUPartBlob> CurrEv;
-      size_t LastEvNum = 0;
-      size_t LineNum = 0;
-      while (std::getline(ifs, line)) {
-        UDBVerbose("[LINE:" << LineNum << "]: " << line);
-
-        if (line[0] == '#') { // Skip comments
-          continue;
-          LineNum++;
+      if (HaveIndex) {
+        NRunsInFile = Index.NRuns;
+        UDBLog("Read index for " << fname << ": " << Index.NEvents
+                                 << " events, " << Index.NLines << " lines.");
+      } else if (!DeferNRuns) {
+        NRunsInFile = GetNRunsFromLastLine(*reader);
+      }
+      if (!DeferNRuns) {
+        UDBLog("Found " << NRunsInFile << " runs in " << fname << ".");
+      }
+
+      size_t NLinesInFile = 0;
+      unsigned long long NBytesInFile = 0;
+      if (ParallelParse) {
+        if (!ChunkParser) {
+          ChunkParser.reset(new GiBUUParsing::FinalEventsChunkParser(
+              GiBUUToStdHepOpts::NParseThreads));
+        }
+        NEvsInFile += ParseFinalEventsParallel(
+            mreader->Begin(), mreader->End(), StartOffset, fname_it,
+            fileNumber, NRunsInFile, Parsed, *ChunkParser, NLinesInFile,
+            HaveIndex ? &Index : NULL, BuildIndex ? &Builder : NULL,
+            CacheWriter.IsOpen() ? &CacheWriter : NULL);
+        NBytesInFile = (unsigned long long)(mreader->End() - mreader->Begin());
+      } else {
+        Batch.reset(NewParsedEventBatch(Parsed, fname_it, fileNumber,
+                                        NRunsInFile, false));
+
+        char const *lbegin, *lend;
+        unsigned long long Skipped = 0;
+        if (StartOffset && reader->Seek(StartOffset)) {
+          Skipped = StartOffset;
+        } else {
+          // Compressed input cannot be seeked in, so skip lines, counting
+          // them as the assembler does.
+          while ((Skipped < StartOffset) && reader->NextLine(lbegin, lend)) {
+            Skipped += (unsigned long long)(lend - lbegin) + 1;
+          }
         }
-        GiBUUPartBlob const &part = GetParticleLine(line);
 
-        if ((part.PerWeight == 0) &&
-            (!GiBUUToStdHepOpts::HaveStruckNucleonInfo)) {
-          UDBWarn("Found particle with 0 weight, but do not have "
-                  "initial state information enabled (-v -1 to silence this "
-                  "message).");
+        GiBUUParsing::FinalEventsAssembler assembler;
+        assembler.SetStartOffset(Skipped);
+        if (BuildIndex) {
+          assembler.SetIndexBuilder(&Builder);
+        }
+        GiBUUTiming::StartLap();
+        while (reader->NextLine(lbegin, lend)) {
+          GiBUUTiming::Lap(GiBUUTiming::kLineRead);
+          if (assembler.AddLine(lbegin, lend, Batch->Events)) {
+            NEvsInFile++;
+
+            if (Batch->Events.GetNEvents() == kEventBatchSize) {
+              GiBUUProgress::SetFileBytesRead(reader->GetInputBytesRead());
+              Batch->Origin.Resumable = true;
+              Batch->Origin.NextOffset = assembler.GetEventOffset();
+              CacheWriter.AddBatch(Batch->Events, Batch->Origin.NextOffset);
+              if (!DeferNRuns) {
+                if (!PushParsedEventBatch(Parsed, Batch)) {
+                  return 1;
+                }
+              } else {
+                Deferred.push_back(std::move(Batch));
+                Batch.reset(NewParsedEventBatch(Parsed, fname_it, fileNumber,
+                                                NRunsInFile, false));
+                if (Deferred.size() == kMaxDeferredBatches) {
+                  // Rather than hold back the whole file, decompress it a
+                  // second time to find its last line.
+                  NRunsInFile = GetNRunsFromLastLine(*reader);
+                  UDBLog("Found " << NRunsInFile << " runs in " << fname
+                                  << ".");
+                  DeferNRuns = false;
+                  Batch->NRunsInFile = NRunsInFile;
+                  if (!PushDeferredBatches(Parsed, Deferred, NRunsInFile)) {
+                    return 1;
+                  }
+                }
+              }
+              // Don't count waiting on the conversion stage as reading.
+              GiBUUTiming::StartLap();
+            }
+          }
         }
 
-        if ((part.EvNum != int(LastEvNum)) && LastEvNum) {
-          FileEvents.push_back(CurrEv);
-          ParsedEvs++;
-          CurrEv.clear();
+        if (assembler.Finish(Batch->Events)) {
+          NEvsInFile++;
+        }
+        NLinesInFile = assembler.GetNLines();
+        NBytesInFile = assembler.GetNBytes();
+        GiBUUTiming::AddLines(NLinesInFile);
 
-          // Flush events every 50k events
-          if (FileEvents.size() == 5E4) {
-            NEvsInFile += FlushEventsToDisk(
-                OutputTree, giRooTracker, fileNumber, NRunsInFile, FileEvents);
+        if (DeferNRuns) {
+          if (assembler.GetLastRun() > 0) {
+            NRunsInFile = size_t(assembler.GetLastRun());
+          }
+          UDBLog("Found " << NRunsInFile << " runs in " << fname << ".");
+          Batch->NRunsInFile = NRunsInFile;
+          if (!PushDeferredBatches(Parsed, Deferred, NRunsInFile)) {
+            return 1;
           }
         }
-        CurrEv.push_back(part);
-        CurrEv.back().ln = LineNum;
-        LastEvNum = part.EvNum;
-        LineNum++;
+        // The last batch ends the file, so is never resumed after.
+        CacheWriter.AddBatch(Batch->Events,
+                             std::numeric_limits<unsigned long long>::max());
       }
 
-      if (CurrEv.size()) {
-        FileEvents.push_back(CurrEv);
-        ParsedEvs++;
-        CurrEv.clear();
+      if (BuildIndex && Builder.GetNEvents()) {
+        GiBUUIndex::WriteIndex(
+            fname, Builder.Finish(NRunsInFile, NLinesInFile, NBytesInFile));
       }
+      CacheWriter.Finish(NRunsInFile, NLinesInFile);
+    }
 
-      // Flush any remaining events
-      if (FileEvents.size()) {
-        NEvsInFile += FlushEventsToDisk(OutputTree, giRooTracker, fileNumber,
-                                        NRunsInFile, FileEvents);
-      }
+    // A resumed file had events before StartOffset.
+    bool const EmptyFile = !NEvsInFile && !StartOffset;
+    // An empty batch is passed on for a file without events, so that it still
+    // gets a record. It is not resumed after, as the file does not take a file
+    // options index.
+    if (EmptyFile && !Batch) {
+      Batch.reset(NewParsedEventBatch(Parsed, fname_it, fileNumber,
+                                      NRunsInFile, false));
+    }
 
-      ifs.close(); // Read all the lines.
+    // Pass on any remaining events
+    if (Batch && (EmptyFile || !Batch->Events.Empty())) {
+      Batch->Origin.Resumable = !EmptyFile;
+      Batch->Origin.EndOfFile = true;
+      if (!Parsed.Push(Batch.release())) {
+        return 1;
+      }
     }
+
     UDBLog("Found " << NEvsInFile << " events in " << fname << ".");
+    GiBUUTiming::AddEventsParsed(NEvsInFile);
+    GiBUUProgress::FinishFile();
 
-    if (!NEvsInFile) {
+    if (EmptyFile) {
       continue;
     }
 
     fileNumber++;
-    NumEvs += NEvsInFile;
   }
+  return 0;
+}
 
-  UDBInfo("Saved " << NumEvs << " events.");
+// The histograms that are filled by the conversion stage, in a fixed order.
+std::vector<TH1D *> GetConvertedHists() {
+  std::vector<TH1D *> Hists;
+  for (std::map<int, TH1D *>::iterator h_it = SigmaHists.begin();
+       h_it != SigmaHists.end(); ++h_it) {
+    Hists.push_back(h_it->second);
+  }
+  for (std::map<int, TH1D *>::iterator h_it = EvHists.begin();
+       h_it != EvHists.end(); ++h_it) {
+    Hists.push_back(h_it->second);
+  }
+  if (DomEvt) {
+    Hists.push_back(DomEvt);
+  }
+  return Hists;
+}
 
-  if (!GiBUUToStdHepOpts::IsNDK) {
-    for (std::map<int, TH1D *>::iterator h_it = SigmaHists.begin();
-         h_it != SigmaHists.end(); ++h_it) {
-      for (int bi_it = 1; bi_it < h_it->second->GetXaxis()->GetNbins() + 1;
-           ++bi_it) {
-        double ENuBWidth =
-            FluxHists[h_it->first]->GetXaxis()->GetBinWidth(bi_it);
-        double NNu = FluxHists[h_it->first]->GetBinContent(bi_it) * ENuBWidth;
-        if (NNu < std::numeric_limits<double>::min()) {
-          continue;
-        }
-        h_it->second->SetBinContent(bi_it,
-                                    h_it->second->GetBinContent(bi_it) / NNu);
-        h_it->second->SetBinError(bi_it,
-                                  h_it->second->GetBinError(bi_it) / NNu);
+void SaveHistStates(std::vector<GiBUUCheckpoint::HistState> &States) {
+  std::vector<TH1D *> Hists = GetConvertedHists();
+  States.resize(Hists.size());
+  for (size_t h_it = 0; h_it < Hists.size(); ++h_it) {
+    GiBUUCheckpoint::SaveHist(Hists[h_it], States[h_it]);
+  }
+}
+
+void RestoreHistStates(std::vector<GiBUUCheckpoint::HistState> const &States) {
+  std::vector<TH1D *> Hists = GetConvertedHists();
+  if (States.size() != Hists.size()) {
+    UDBError("The checkpoint holds " << States.size()
+                                     << " histograms, but the conversion "
+                                        "fills "
+                                     << Hists.size()
+                                     << ". Were the same -F options given?");
+    throw std::runtime_error("Mismatched checkpoint histograms.");
+  }
+  for (size_t h_it = 0; h_it < Hists.size(); ++h_it) {
+    if (States[h_it].Name != Hists[h_it]->GetName()) {
+      UDBError("Expected checkpointed histogram "
+               << Hists[h_it]->GetName() << ", but found "
+               << States[h_it].Name << ". Were the same -F options given?");
+      throw std::runtime_error("Mismatched checkpoint histograms.");
+    }
+    GiBUUCheckpoint::RestoreHist(Hists[h_it], States[h_it]);
+  }
+}
+
+InputFileRecord MakeInputFileRecord(ConvertedEventBatch const &Batch,
+                                    Long64_t FirstEntry) {
+  size_t const fileNumber = Batch.Events.FileNumber;
+  InputFileRecord rec;
+  rec.FileName = GiBUUToStdHepOpts::InpFNames[Batch.Origin.InputFile];
+  rec.NRuns = Int_t(Batch.NRunsInFile);
+  rec.FirstEntry = FirstEntry;
+  rec.NFilesAddedWeight = GiBUUToStdHepOpts::NFilesAddedWeights[fileNumber];
+  rec.TreeNumRunsWeight = rec.GetNumRunsWeight();
+  rec.FileExtraWeight = GiBUUToStdHepOpts::FileExtraWeights[fileNumber];
+  rec.ProbePDG = GiBUUToStdHepOpts::ProbeTypes[fileNumber];
+  rec.TargetA = GiBUUToStdHepOpts::TargetAs[fileNumber];
+  rec.TargetZ = GiBUUToStdHepOpts::TargetZs[fileNumber];
+  rec.IsCC = GiBUUToStdHepOpts::CCFiles[fileNumber];
+  return rec;
+}
+
+// Checkpoints the conversion as it stands once Batch has been written.
+void CommitCheckpoint(TTree *OutputTree, ConvertedEventBatch const &Batch,
+                      std::vector<InputFileRecord> const &Records) {
+  GiBUUCheckpoint::State s;
+  if (Batch.Origin.EndOfFile) {
+    s.InputFile = Batch.Origin.InputFile + 1;
+    s.FileNumber = Batch.Events.FileNumber + 1;
+    s.Offset = 0;
+  } else {
+    s.InputFile = Batch.Origin.InputFile;
+    s.FileNumber = Batch.Events.FileNumber;
+    s.Offset = Batch.Origin.NextOffset;
+  }
+  s.InputFiles = GiBUUToStdHepOpts::InpFNames;
+  s.Records = Records;
+  s.Hists = Batch.Hists;
+  GiBUUCheckpoint::Commit(OutputTree, s);
+}
+
+// Divides the cross section histograms by the flux and scales the event rate
+// histograms to the NumEvs events that filled them.
+void NormaliseFluxHists(size_t NumEvs) {
+  for (std::map<int, TH1D *>::iterator h_it = SigmaHists.begin();
+       h_it != SigmaHists.end(); ++h_it) {
+    for (int bi_it = 1; bi_it < h_it->second->GetXaxis()->GetNbins() + 1;
+         ++bi_it) {
+      double ENuBWidth =
+          FluxHists[h_it->first]->GetXaxis()->GetBinWidth(bi_it);
+      double NNu = FluxHists[h_it->first]->GetBinContent(bi_it) * ENuBWidth;
+      if (NNu < std::numeric_limits<double>::min()) {
+        continue;
       }
+      h_it->second->SetBinContent(bi_it,
+                                  h_it->second->GetBinContent(bi_it) / NNu);
+      h_it->second->SetBinError(bi_it,
+                                h_it->second->GetBinError(bi_it) / NNu);
+    }
+
+    EvHists[h_it->first]->Scale(1, "width");
+    EvHists[h_it->first]->Scale(NumEvs);
+  }
+  if (DomEvt) {
+    DomEvt->Scale(1, "width");
+    DomEvt->Write("evt_per_NEvents", TObject::kOverwrite);
+    std::string name = DomEvt->GetName();
+    std::string title = DomEvt->GetTitle();
+    DomEvt = static_cast<TH1D *>(FluxHists[DomPDG]->Clone());
+    DomEvt->SetNameTitle(name.c_str(), title.c_str());
+    DomEvt->Scale(NumEvs);
+  }
+}
 
-      EvHists[h_it->first]->Scale(1, "width");
-      EvHists[h_it->first]->Scale(NumEvs);
+// Runs the conversion as a three stage pipeline: input files are parsed on one
+// thread, parsed events are converted to GiRooTracker entries on another, and
+// the calling thread writes the converted entries to OutputTree. Batches are
+// passed between stages through bounded queues, so that no stage can run
+// arbitrarily far ahead of the next, and are processed in order, so the output
+// is identical to converting each event in turn.
+//
+// A record of each converted input file, and the range of OutputTree entries
+// that were written from it, is appended to Records. If Resume is not NULL,
+// the conversion continues from that checkpoint, whose records Records must
+// already hold.
+int ParseACSIIEventVectors(TTree *OutputTree, GiRooTracker *giRooTracker,
+                           std::vector<InputFileRecord> &Records,
+                           GiBUUCheckpoint::State const *Resume) {
+  ParsedEventChannel Parsed(kPipelineDepth);
+  ConvertedEventChannel Converted(kPipelineDepth);
+
+  if (Resume) {
+    GiBUUProgress::Start(Resume->InputFile, Resume->Offset);
+  } else {
+    GiBUUProgress::Start();
+  }
+
+  int ParserRtnCode = 0;
+  std::exception_ptr ParseError;
+  std::thread Parser([&]() {
+    try {
+      ParserRtnCode = ParseInputFiles(Parsed, Resume);
+    } catch (...) {
+      ParseError = std::current_exception();
     }
-    if (DomEvt) {
-      DomEvt->Scale(1, "width");
-      DomEvt->Write("evt_per_NEvents");
-      std::string name = DomEvt->GetName();
-      std::string title = DomEvt->GetTitle();
-      DomEvt = static_cast<TH1D *>(FluxHists[DomPDG]->Clone());
-      DomEvt->SetNameTitle(name.c_str(), title.c_str());
-      DomEvt->Scale(NumEvs);
+    Parsed.Close();
+    GiBUUTiming::FinishThread("Parser");
+  });
+
+  std::exception_ptr ConvertError;
+  std::thread Converter([&]() {
+    try {
+      GiRooTracker ConvTracker;
+      ParsedEventBatch *Batch;
+      while (Parsed.Pop(Batch)) {
+        ConvertedEventBatch *Out = Converted.Acquire();
+        {
+          GiBUUTiming::ScopedTimer timer(GiBUUTiming::kConversion);
+          ConvertEvents(&ConvTracker, *Batch, Out->Events);
+        }
+        Out->NRunsInFile = Batch->NRunsInFile;
+        Out->Origin = Batch->Origin;
+        // The writing stage may only checkpoint the histograms as they were
+        // when the events that it has written were converted.
+        if (GiBUUCheckpoint::Enabled()) {
+          SaveHistStates(Out->Hists);
+        }
+        Parsed.Release(Batch);
+        Converted.Push(Out);
+      }
+    } catch (...) {
+      ConvertError = std::current_exception();
+      // Stop the parsing stage from waiting on a full queue.
+      Parsed.Close();
     }
+    Converted.Close();
+    GiBUUTiming::FinishThread("Converter");
+  });
+
+  // The histograms are normalised to every event of the conversion, including
+  // those written before it was resumed.
+  size_t NumEvs = Resume ? size_t(Resume->NEntries) : 0;
+  // The input file that Records.back() was made for, if it is still being
+  // written. A checkpoint within a file is only taken after some of its
+  // events have been written.
+  size_t RecordInputFile = (Resume && Resume->Offset)
+                               ? Resume->InputFile
+                               : std::numeric_limits<size_t>::max();
+  ConvertedEventBatch *Batch = NULL;
+  try {
+    while (Converted.Pop(Batch)) {
+      Long64_t const FirstEntry = OutputTree->GetEntries();
+      size_t const NWritten =
+          FlushEventsToDisk(OutputTree, giRooTracker, Batch->Events);
+      GiBUUProgress::AddEventsWritten(NWritten);
+      NumEvs += NWritten;
+      // Every input file produces at least one batch, which is empty if the
+      // file had no events.
+      if (Batch->Origin.InputFile != RecordInputFile) {
+        Records.push_back(MakeInputFileRecord(*Batch, FirstEntry));
+        RecordInputFile = Batch->Origin.InputFile;
+      }
+      Records.back().NEntries += Long64_t(NWritten);
+      Records.back().SumPerWeight +=
+          std::accumulate(Batch->Events.GiBUUPerWeight.begin(),
+                          Batch->Events.GiBUUPerWeight.end(), Double_t(0));
+      if (Batch->Origin.Resumable && GiBUUCheckpoint::Due()) {
+        CommitCheckpoint(OutputTree, *Batch, Records);
+      }
+      Converted.Release(Batch);
+      Batch = NULL;
+    }
+  } catch (...) {
+    // The other stages must be stopped, and their threads joined, before
+    // they are destroyed.
+    delete Batch;
+    Parsed.Close();
+    Converted.Close();
+    Parser.join();
+    Converter.join();
+    GiBUUProgress::Stop();
+    throw;
+  }
+
+  Parser.join();
+  Converter.join();
+  GiBUUProgress::Stop();
+
+  GiBUUDiagnostics::PrintSummary();
+
+  if (ParseError) {
+    std::rethrow_exception(ParseError);
+  }
+  if (ConvertError) {
+    std::rethrow_exception(ConvertError);
+  }
+  if (ParserRtnCode) {
+    return ParserRtnCode;
+  }
+
+  UDBInfo("Saved " << NumEvs << " events.");
+
+  if (!GiBUUToStdHepOpts::IsNDK) {
+    NormaliseFluxHists(NumEvs);
   }
 
   return 0;
@@ -779,32 +1272,356 @@ void SaveFluxFile(std::string const &fileloc, std::string const &histname) {
             << std::endl;
 }
 
+// Removes the input files that are not marked in Keep, along with their
+// per-file options.
+void KeepInputFiles(std::vector<bool> const &Keep) {
+  size_t NKept = 0;
+  for (size_t f_it = 0; f_it < GiBUUToStdHepOpts::InpFNames.size(); ++f_it) {
+    if (!Keep[f_it]) {
+      continue;
+    }
+    GiBUUToStdHepOpts::InpFNames[NKept] = GiBUUToStdHepOpts::InpFNames[f_it];
+    GiBUUToStdHepOpts::ProbeTypes[NKept] = GiBUUToStdHepOpts::ProbeTypes[f_it];
+    GiBUUToStdHepOpts::TargetAs[NKept] = GiBUUToStdHepOpts::TargetAs[f_it];
+    GiBUUToStdHepOpts::TargetZs[NKept] = GiBUUToStdHepOpts::TargetZs[f_it];
+    GiBUUToStdHepOpts::CCFiles[NKept] = GiBUUToStdHepOpts::CCFiles[f_it];
+    GiBUUToStdHepOpts::FileExtraWeights[NKept] =
+        GiBUUToStdHepOpts::FileExtraWeights[f_it];
+    GiBUUToStdHepOpts::NFilesAddedWeights[NKept] =
+        GiBUUToStdHepOpts::NFilesAddedWeights[f_it];
+    NKept++;
+  }
+  GiBUUToStdHepOpts::InpFNames.resize(NKept);
+  GiBUUToStdHepOpts::ProbeTypes.resize(NKept);
+  GiBUUToStdHepOpts::TargetAs.resize(NKept);
+  GiBUUToStdHepOpts::TargetZs.resize(NKept);
+  GiBUUToStdHepOpts::CCFiles.resize(NKept);
+  GiBUUToStdHepOpts::FileExtraWeights.resize(NKept);
+  GiBUUToStdHepOpts::NFilesAddedWeights.resize(NKept);
+}
+
+// Takes up the current NFilesAddedWeights and FileExtraWeights of the input
+// files in Records, which have already been converted into the output file.
+// Returns which of the input files have not been.
+std::vector<bool> MatchConvertedInputFiles(
+    std::vector<InputFileRecord> &Records) {
+  std::vector<bool> IsNew(GiBUUToStdHepOpts::InpFNames.size(), true);
+  for (size_t r_it = 0; r_it < Records.size(); ++r_it) {
+    size_t f_it = 0;
+    for (; (f_it < GiBUUToStdHepOpts::InpFNames.size()) &&
+           (GiBUUToStdHepOpts::InpFNames[f_it] != Records[r_it].FileName);
+         ++f_it) {
+    }
+    if (f_it == GiBUUToStdHepOpts::InpFNames.size()) {
+      UDBWarn("Previously converted input file "
+              << Records[r_it].FileName
+              << " was not given, the weights of its events will not be "
+                 "changed.");
+      continue;
+    }
+    Records[r_it].NFilesAddedWeight =
+        GiBUUToStdHepOpts::NFilesAddedWeights[f_it];
+    Records[r_it].FileExtraWeight = GiBUUToStdHepOpts::FileExtraWeights[f_it];
+    IsNew[f_it] = false;
+  }
+  return IsNew;
+}
+
+// Takes up the current weights of the input files in Records, and removes
+// them from the input files to convert.
+void DropConvertedInputFiles(std::vector<InputFileRecord> &Records) {
+  std::vector<bool> const IsNew = MatchConvertedInputFiles(Records);
+
+  size_t NNew = 0;
+  for (size_t f_it = 0; f_it < GiBUUToStdHepOpts::InpFNames.size(); ++f_it) {
+    if (!IsNew[f_it]) {
+      UDBLog("Skipping previously converted input file: "
+             << GiBUUToStdHepOpts::InpFNames[f_it]);
+      continue;
+    }
+    NNew++;
+  }
+  KeepInputFiles(IsNew);
+  UDBLog("Found " << NNew << " new input files to append.");
+}
+
+// Refills the flux-weighted histograms from the entries of OutputTree, with
+// the weights of their input files in Records, for --reweight. Only the
+// GiBUUPerWeight and probe energy branches are read.
+void ReweightFluxHists(TTree *OutputTree, GiRooTracker *giRooTracker,
+                       std::vector<InputFileRecord> const &Records) {
+  bool const CompactP4 = (OutputTree->GetBranch("StdHepE") != NULL);
+  OutputTree->SetBranchStatus("*", false);
+  OutputTree->SetBranchStatus("GiBUUPerWeight", true);
+  if (CompactP4) {
+    OutputTree->SetBranchStatus("StdHepN", true);
+    OutputTree->SetBranchStatus("StdHepE", true);
+  } else {
+    OutputTree->SetBranchStatus("StdHepP4", true);
+  }
+
+  size_t NumEvs = 0;
+  for (size_t f_it = 0; f_it < Records.size(); ++f_it) {
+    InputFileRecord const &rec = Records[f_it];
+    Double_t const NumRunsWeight = rec.GetNumRunsWeight();
+    for (Long64_t e_it = rec.FirstEntry;
+         e_it < (rec.FirstEntry + rec.NEntries); ++e_it) {
+      OutputTree->GetEntry(e_it);
+      double const EProbe =
+          CompactP4 ? giRooTracker->StdHepE[0]
+                    : giRooTracker->StdHepP4[0][GiRooTracker::kStdHepIdxE];
+      FillFluxHists(rec.ProbePDG, EProbe,
+                    GetEvtWght(giRooTracker->GiBUUPerWeight, NumRunsWeight,
+                               rec.FileExtraWeight));
+      NumEvs++;
+    }
+  }
+  OutputTree->SetBranchStatus("*", true);
+
+  NormaliseFluxHists(NumEvs);
+}
+
+// Keeps only the input files in the shard selected by --shard. The weights
+// that average over the files added by each -f argument have already been
+// set from every file that it added, so the events of each shard are weighted
+// as they would be by a single conversion of all of the input files.
+void SelectInputShard() {
+  size_t const NFiles = GiBUUToStdHepOpts::InpFNames.size();
+  size_t const Begin =
+      (NFiles * GiBUUToStdHepOpts::ShardIndex) / GiBUUToStdHepOpts::NShards;
+  size_t const End = (NFiles * (GiBUUToStdHepOpts::ShardIndex + 1)) /
+                     GiBUUToStdHepOpts::NShards;
+  std::vector<bool> InShard(NFiles, false);
+  for (size_t f_it = Begin; f_it < End; ++f_it) {
+    InShard[f_it] = true;
+  }
+  KeepInputFiles(InShard);
+  if (Begin == End) {
+    UDBWarn("Shard " << GiBUUToStdHepOpts::ShardIndex << "/"
+                     << GiBUUToStdHepOpts::NShards << " of " << NFiles
+                     << " input files is empty.");
+  } else {
+    UDBLog("Shard " << GiBUUToStdHepOpts::ShardIndex << "/"
+                    << GiBUUToStdHepOpts::NShards << " converts input files "
+                    << (Begin + 1) << " to " << End << " of " << NFiles
+                    << ".");
+  }
+}
+
 int GiBUUToStdHep() {
-  TFile *outFile = new TFile(GiBUUToStdHepOpts::OutFName.c_str(), "RECREATE");
+  GiBUUTiming::Start();
+
+  if (GiBUUToStdHepOpts::NShards > 1) {
+    SelectInputShard();
+  }
+
+  if (GiBUUToStdHepOpts::ReweightOutput) {
+    if (GiBUUToStdHepOpts::AppendOutput ||
+        GiBUUToStdHepOpts::ResumeConversion || GiBUUCheckpoint::Enabled()) {
+      UDBError("--reweight cannot be combined with --append, --checkpoint or "
+               "--resume.");
+      return 1;
+    }
+    if (GiBUUToStdHepOpts::IsNDK) {
+      UDBError("Nucleon decay events have no weights to reweight.");
+      return 1;
+    }
+    if (!std::ifstream(GiBUUToStdHepOpts::OutFName.c_str()).good()) {
+      UDBError("Output file " << GiBUUToStdHepOpts::OutFName
+                              << " does not exist, there is nothing to "
+                                 "reweight.");
+      return 2;
+    }
+  }
+  if (GiBUUCheckpoint::Enabled() && GiBUUToStdHepOpts::OutputAutoSave) {
+    UDBError("--auto-save cannot be combined with --checkpoint, the output "
+             "tree is autosaved when each checkpoint is taken.");
+    return 1;
+  }
+
+  GiBUUCheckpoint::State Resume;
+  bool Resuming = false;
+  if (GiBUUToStdHepOpts::ResumeConversion) {
+    if (!GiBUUCheckpoint::Read(Resume)) {
+      UDBLog("Found no checkpoint for " << GiBUUToStdHepOpts::OutFName
+                                        << ", starting the conversion from "
+                                           "the beginning.");
+    } else if (Resume.Complete) {
+      UDBLog("The conversion into " << GiBUUToStdHepOpts::OutFName
+                                    << " has already completed.");
+      return 0;
+    } else {
+      Resuming = true;
+    }
+  }
+  GiBUUCheckpoint::Start(Resuming);
+
+  if (GiBUUToStdHepOpts::AppendOutput && !Resuming &&
+      !std::ifstream(GiBUUToStdHepOpts::OutFName.c_str()).good()) {
+    UDBLog("Output file " << GiBUUToStdHepOpts::OutFName
+                          << " does not exist yet, creating it.");
+    GiBUUToStdHepOpts::AppendOutput = false;
+  }
+
+  bool const OpenExisting = GiBUUToStdHepOpts::AppendOutput || Resuming ||
+                            GiBUUToStdHepOpts::ReweightOutput;
+  TFile *outFile = new TFile(GiBUUToStdHepOpts::OutFName.c_str(),
+                             OpenExisting ? "UPDATE" : "RECREATE");
   if (!outFile->IsOpen()) {
     UDBError("Couldn't open output file.");
     return 2;
   }
+  // Must be set before the tree is created for its branches to pick it up.
+  if (GiBUUToStdHepOpts::OutputCompression >= 0) {
+    outFile->SetCompressionSettings(GiBUUToStdHepOpts::OutputCompression);
+  }
 
-  TTree *rooTrackerTree = new TTree("giRooTracker", "GiBUU StdHepVariables");
+  TTree *rooTrackerTree = NULL;
   GiRooTracker *giRooTracker = new GiRooTracker();
-  int EventMode = 0;
-  if(GiBUUToStdHepOpts::IsElectronScattering){
-    EventMode = 1;
-  } else if(GiBUUToStdHepOpts::IsNDK){
-    EventMode = 2;
+  std::vector<InputFileRecord> Records;
+  if (OpenExisting) {
+    outFile->GetObject("giRooTracker", rooTrackerTree);
+    if (!rooTrackerTree) {
+      UDBError("Found no giRooTracker tree in "
+               << GiBUUToStdHepOpts::OutFName << " to add to.");
+      return 2;
+    }
+  }
+  if (GiBUUToStdHepOpts::AppendOutput || GiBUUToStdHepOpts::ReweightOutput) {
+    if (!ReadInputFileRecords(outFile, Records)) {
+      UDBError("Found no " << kInputFilesTreeName << " tree in "
+                           << GiBUUToStdHepOpts::OutFName
+                           << ", it was written by an older GiBUUToStdHep "
+                              "and cannot be "
+                           << (GiBUUToStdHepOpts::AppendOutput
+                                   ? "appended to."
+                                   : "reweighted."));
+      return 2;
+    }
+  }
+  if (GiBUUToStdHepOpts::AppendOutput) {
+    // The weights of the existing entries are recomputed with the options of
+    // this conversion, and the new entries must be filled in the same mode.
+    ConversionOptionsRecord Existing;
+    if (!ReadConversionOptions(outFile, Existing)) {
+      UDBWarn("Found no " << kMetaTreeName << " tree in "
+                          << GiBUUToStdHepOpts::OutFName
+                          << ", cannot check that it was converted with the "
+                             "same options.");
+    } else if (Existing != GetConversionOptions()) {
+      UDBError(GiBUUToStdHepOpts::OutFName
+               << " was converted with different -R, -e, -K, -NI or -NP "
+                  "options, it can only be appended to with the same ones.");
+      return 2;
+    }
+    UDBLog("Appending to " << rooTrackerTree->GetEntries()
+                           << " entries converted from " << Records.size()
+                           << " input files.");
+    DropConvertedInputFiles(Records);
+  }
+  if (GiBUUToStdHepOpts::ReweightOutput) {
+    if (GetNRecordedEntries(Records) != rooTrackerTree->GetEntries()) {
+      UDBError("The " << kInputFilesTreeName << " tree in "
+                      << GiBUUToStdHepOpts::OutFName
+                      << " does not account for every entry, it cannot be "
+                         "reweighted.");
+      return 2;
+    }
+    std::vector<bool> const IsNew = MatchConvertedInputFiles(Records);
+    for (size_t f_it = 0; f_it < IsNew.size(); ++f_it) {
+      if (IsNew[f_it]) {
+        UDBWarn("Input file " << GiBUUToStdHepOpts::InpFNames[f_it]
+                              << " has not been converted into "
+                              << GiBUUToStdHepOpts::OutFName
+                              << ", use --append to add it.");
+      }
+    }
+    UDBLog("Reweighting " << rooTrackerTree->GetEntries()
+                          << " entries converted from " << Records.size()
+                          << " input files.");
+  }
+  if (Resuming) {
+    if (Resume.InputFiles != GiBUUToStdHepOpts::InpFNames) {
+      UDBError("The checkpoint of " << GiBUUToStdHepOpts::OutFName
+                                    << " was taken converting different "
+                                       "input files, the conversion must be "
+                                       "resumed with the same options.");
+      return 2;
+    }
+    // The tree's own autosaves are turned off while checkpointing, so it is
+    // only autosaved when a checkpoint is taken and a mismatch means that the
+    // conversion was killed while taking one.
+    if (rooTrackerTree->GetEntries() != Resume.NEntries) {
+      UDBError("The checkpoint of " << GiBUUToStdHepOpts::OutFName
+                                    << " is for " << Resume.NEntries
+                                    << " entries, but the output tree holds "
+                                    << rooTrackerTree->GetEntries()
+                                    << ". It cannot be resumed.");
+      return 2;
+    }
+    Records = Resume.Records;
+    UDBLog("Resuming from " << Resume.NEntries << " entries, input file "
+                            << (Resume.InputFile + 1) << "/"
+                            << Resume.InputFiles.size() << " from byte "
+                            << Resume.Offset << ".");
+  }
+  if (OpenExisting) {
+    giRooTracker->SetBranchAddresses(rooTrackerTree);
+    // New entries must be filled in the layout of the existing ones.
+    GiBUUToStdHepOpts::CompactP4Output =
+        (rooTrackerTree->GetBranch("StdHepPx") != NULL);
+    GiBUUToStdHepOpts::DerivedKinematicsOutput =
+        (rooTrackerTree->GetBranch("Q2") != NULL);
+  } else {
+    rooTrackerTree = new TTree("giRooTracker", "GiBUU StdHepVariables");
+    int EventMode = 0;
+    if(GiBUUToStdHepOpts::IsElectronScattering){
+      EventMode = 1;
+    } else if(GiBUUToStdHepOpts::IsNDK){
+      EventMode = 2;
+    }
+    if ((EventMode == 2) && GiBUUToStdHepOpts::DerivedKinematicsOutput) {
+      UDBWarn("Nucleon decay events have no lepton kinematics, not writing "
+              "derived kinematics branches.");
+      GiBUUToStdHepOpts::DerivedKinematicsOutput = false;
+    }
+    giRooTracker->AddBranches(rooTrackerTree, true,
+                              GiBUUToStdHepOpts::HaveProdChargeInfo,
+                              EventMode, GiBUUToStdHepOpts::CompactP4Output,
+                              GiBUUToStdHepOpts::DerivedKinematicsOutput);
+  }
+  if (GiBUUToStdHepOpts::OutputBasketSize) {
+    rooTrackerTree->SetBasketSize("*", GiBUUToStdHepOpts::OutputBasketSize);
+  }
+  if (GiBUUToStdHepOpts::OutputAutoFlush) {
+    rooTrackerTree->SetAutoFlush(GiBUUToStdHepOpts::OutputAutoFlush);
+  }
+  if (GiBUUCheckpoint::Enabled()) {
+    // An autosave between checkpoints would leave entries on disk that the
+    // last checkpoint does not account for, and the conversion could then
+    // not be resumed.
+    rooTrackerTree->SetAutoSave(0);
+  } else if (GiBUUToStdHepOpts::OutputAutoSave) {
+    rooTrackerTree->SetAutoSave(GiBUUToStdHepOpts::OutputAutoSave);
+  }
+
+  // The flux-weighted histograms are normalised to the events converted in a
+  // single pass, so cannot be extended.
+  if (GiBUUToStdHepOpts::AppendOutput &&
+      (GiBUUToStdHepOpts::FluxFilesToAdd.size() ||
+       GiBUUToStdHepOpts::IsElectronScattering)) {
+    UDBWarn("Flux and event rate histograms are not updated when appending.");
   }
-  giRooTracker->AddBranches(rooTrackerTree, true,
-                            GiBUUToStdHepOpts::HaveProdChargeInfo,
-                            EventMode);
 
   // Handle the fluxes first so that we know the relative normalisations
-  for (size_t ff_it = 0; ff_it < GiBUUToStdHepOpts::FluxFilesToAdd.size();
+  for (size_t ff_it = 0; !GiBUUToStdHepOpts::AppendOutput &&
+                         (ff_it < GiBUUToStdHepOpts::FluxFilesToAdd.size());
        ++ff_it) {
     SaveFluxFile(GiBUUToStdHepOpts::FluxFilesToAdd[ff_it].second,
                  GiBUUToStdHepOpts::FluxFilesToAdd[ff_it].first);
   }
-  if (GiBUUToStdHepOpts::IsElectronScattering) {
+  if (GiBUUToStdHepOpts::IsElectronScattering &&
+      !GiBUUToStdHepOpts::AppendOutput) {
     DomPDG = 11;
 
     FluxHists[DomPDG] = new TH1D("e_flux", "e_flux", 100, 0,
@@ -823,18 +1640,68 @@ int GiBUUToStdHep() {
     DomFlux = static_cast<TH1D *>(FluxHists[DomPDG]->Clone("flux"));
     DomEvt = static_cast<TH1D *>(EvHists[DomPDG]->Clone("evt"));
   }
+  if (Resuming) {
+    RestoreHistStates(Resume.Hists);
+  }
 
   int ParserRtnCode = 0;
-  ParserRtnCode = ParseACSIIEventVectors(rooTrackerTree, giRooTracker);
-
-  rooTrackerTree->Write();
+  if (GiBUUToStdHepOpts::ReweightOutput) {
+    if (FluxHists.size()) {
+      ReweightFluxHists(rooTrackerTree, giRooTracker, Records);
+    } else {
+      UDBWarn("No flux files were given with -F, any flux-weighted "
+              "histograms in "
+              << GiBUUToStdHepOpts::OutFName << " are not updated.");
+    }
+  } else {
+    ParserRtnCode = ParseACSIIEventVectors(rooTrackerTree, giRooTracker,
+                                           Records, Resuming ? &Resume : NULL);
+  }
 
-  outFile->Write();
-  outFile->Close();
+  {
+    GiBUUTiming::ScopedTimer timer(GiBUUTiming::kWrite);
+    outFile->cd();
+    if (!ParserRtnCode && (GiBUUToStdHepOpts::NShards > 1)) {
+      WriteShardInfo(GiBUUToStdHepOpts::ShardIndex,
+                     GiBUUToStdHepOpts::NShards);
+    }
+    if (GiBUUToStdHepOpts::ReweightOutput) {
+      WriteInputFileRecords(Records, GetConversionOptions());
+      WriteWeightsFriendTree(rooTrackerTree, giRooTracker, Records);
+      // Replaces the histograms and the tree header, which now names the new
+      // friend tree. The particle branches are not rewritten.
+      outFile->Write(0, TObject::kOverwrite);
+    } else if (!GiBUUToStdHepOpts::AppendOutput) {
+      // Replace the autosaved tree that a resumed conversion started from.
+      Int_t const WriteOption = Resuming ? Int_t(TObject::kOverwrite) : 0;
+      WriteInputFileRecords(Records, GetConversionOptions());
+      rooTrackerTree->Write(0, WriteOption);
+
+      outFile->Write(0, WriteOption);
+    } else if (ParserRtnCode) {
+      // Leave the previous versions of the trees as the current ones, other
+      // than any checkpoint autosaves, which can be resumed from.
+      UDBError("Conversion failed, not updating "
+               << GiBUUToStdHepOpts::OutFName << ".");
+    } else {
+      WriteInputFileRecords(Records, GetConversionOptions());
+      if (!GiBUUToStdHepOpts::IsNDK) {
+        WriteWeightsFriendTree(rooTrackerTree, giRooTracker, Records);
+      }
+      rooTrackerTree->Write("", TObject::kOverwrite);
+    }
+    outFile->Close();
+  }
+  if (!ParserRtnCode && (GiBUUCheckpoint::Enabled() || Resuming)) {
+    GiBUUCheckpoint::MarkComplete();
+  }
   delete giRooTracker;
   giRooTracker = nullptr;
   delete outFile;
   outFile = nullptr;
+
+  GiBUUTiming::FinishThread("Writer");
+  GiBUUTiming::Report();
   return ParserRtnCode;
 }
 
@@ -857,5 +1724,18 @@ int main(int argc, char const *argv[]) {
     return 1;
   }
 
+  if (GiBUUToStdHepOpts::NIMTThreads) {
+#ifdef R__USE_IMT
+    // Lets TTree::Fill compress the baskets of different branches in
+    // parallel when they are flushed. Output entries are still filled in
+    // order from a single thread, so the output file is unchanged.
+    ROOT::EnableImplicitMT(GiBUUToStdHepOpts::NIMTThreads);
+#else
+    UDBWarn("-j was passed, but ROOT was built without implicit "
+            "multi-threading support. Output will be compressed on a single "
+            "thread.");
+#endif
+  }
+
   return GiBUUToStdHep();
 }
@@ -0,0 +1,663 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "TFile.h"
+#include "TTree.h"
+
+#include "LUtils/Debugging.hxx"
+#include "LUtils/Utils.hxx"
+
+#include "GiBUUToStdHep_CLIOpts.hxx"
+#include "GiBUUToStdHep_Input.hxx"
+#include "GiBUUToStdHep_Output.hxx"
+#include "GiBUUToStdHep_Parsing.hxx"
+#include "GiBUUToStdHep_Synthetic.hxx"
+#include "GiBUUToStdHep_Utils.hxx"
+
+#include "GiRooTracker.hxx"
+
+namespace {
+
+size_t const kNLookups = 1 << 20;
+size_t const kNRepeats = 50;
+
+// A deterministic mix of particle codes, weighted roughly like a neutrino
+// event: mostly nucleons and pions, with a lepton, a neutrino and the odd
+// resonance, strange particle or photon.
+void FillParticleMix(std::vector<int> &GiBUUCodes,
+                     std::vector<int> &GiBUUCharges) {
+  static int const Codes[] = {1, 1, 1, 1, 101, 101, 101, 2,
+                              901, 902, 911, 912, 999, 110, 32, 102};
+  size_t const NCodes = sizeof(Codes) / sizeof(Codes[0]);
+
+  GiBUUCodes.resize(kNLookups);
+  GiBUUCharges.resize(kNLookups);
+  unsigned long state = 12345;
+  for (size_t i = 0; i < kNLookups; ++i) {
+    state = (state * 6364136223846793005ul) + 1442695040888963407ul;
+    GiBUUCodes[i] = Codes[(state >> 33) % NCodes];
+    GiBUUCharges[i] = int((state >> 13) % 3) - 1;
+  }
+}
+
+template <typename Func> double TimePerCall(Func const &f) {
+  std::chrono::steady_clock::time_point const start =
+      std::chrono::steady_clock::now();
+  f();
+  std::chrono::steady_clock::time_point const end =
+      std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         double(kNLookups * kNRepeats);
+}
+
+long BenchCodeLookups() {
+  std::vector<int> GiBUUCodes, GiBUUCharges, PDGCodes(kNLookups);
+  FillParticleMix(GiBUUCodes, GiBUUCharges);
+  for (size_t i = 0; i < kNLookups; ++i) {
+    PDGCodes[i] = GiBUUUtils::GiBUUToPDG(GiBUUCodes[i], GiBUUCharges[i]);
+  }
+
+  long Sink = 0;
+  double const ToPDG = TimePerCall([&]() {
+    for (size_t r = 0; r < kNRepeats; ++r) {
+      for (size_t i = 0; i < kNLookups; ++i) {
+        Sink += GiBUUUtils::GiBUUToPDG(GiBUUCodes[i], GiBUUCharges[i]);
+      }
+    }
+  });
+  double const ToGiBUU = TimePerCall([&]() {
+    for (size_t r = 0; r < kNRepeats; ++r) {
+      for (size_t i = 0; i < kNLookups; ++i) {
+        Sink += GiBUUUtils::PDGToGiBUU(PDGCodes[i]);
+      }
+    }
+  });
+
+  std::cout << "[GiBUUToPDG]: " << ToPDG << " ns/lookup" << std::endl;
+  std::cout << "[PDGToGiBUU]: " << ToGiBUU << " ns/lookup" << std::endl;
+  return Sink;
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point const &start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+void SplitLines(std::string const &Text, std::vector<char const *> &Begins,
+                std::vector<char const *> &Ends) {
+  char const *c = Text.data();
+  char const *const end = Text.data() + Text.size();
+  while (c < end) {
+    char const *nl = c;
+    while ((nl < end) && (*nl != '\n')) {
+      ++nl;
+    }
+    if ((nl != c) && (*c != '#')) {
+      Begins.push_back(c);
+      Ends.push_back(nl);
+    }
+    c = nl + 1;
+  }
+}
+
+long BenchGetParticleLine(std::string const &FinalEvents) {
+  std::vector<char const *> Begins, Ends;
+  SplitLines(FinalEvents, Begins, Ends);
+
+  long Sink = 0;
+  size_t const NRepeats = 5;
+  GiBUUPartBlob part;
+  std::chrono::steady_clock::time_point const start =
+      std::chrono::steady_clock::now();
+  for (size_t r = 0; r < NRepeats; ++r) {
+    for (size_t l_it = 0; l_it < Begins.size(); ++l_it) {
+      GiBUUParsing::GetParticleLine(Begins[l_it], Ends[l_it], part);
+      Sink += part.ID;
+    }
+  }
+  double const Seconds = SecondsSince(start);
+
+  std::cout << "[GetParticleLine]: "
+            << (1E9 * Seconds / double(NRepeats * Begins.size()))
+            << " ns/line, "
+            << (double(NRepeats * FinalEvents.size()) / (1E6 * Seconds))
+            << " MB/s" << std::endl;
+  return Sink;
+}
+
+// strtod as ParseDouble falls back to it: the whole range must be consumed.
+bool ReferenceParseDouble(std::string const &str, double &val) {
+  char *pEnd = NULL;
+  val = std::strtod(str.c_str(), &pEnd);
+  return (pEnd == (str.c_str() + str.size()));
+}
+
+// Checks that ParseDouble accepts and rejects the same strings as strtod, and
+// gives bit-identical values for those it accepts. Returns the number of
+// mismatches.
+size_t CheckParseDouble(std::string const &str) {
+  double val = 0, ref = 0;
+  bool const ok = GiBUUParsing::ParseDouble(
+      str.data(), str.data() + str.size(), val);
+  bool const refok = ReferenceParseDouble(str, ref);
+  if ((ok == refok) && (!ok || !std::memcmp(&val, &ref, sizeof(double)))) {
+    return 0;
+  }
+  std::cout << "[ERROR]: ParseDouble(\"" << str << "\") gave " << ok << ", "
+            << std::setprecision(17) << val << " but strtod gave " << refok
+            << ", " << ref << std::setprecision(6) << std::endl;
+  return 1;
+}
+
+// Checks that SplitColumns splits Line into Expected, with glued negative
+// numbers split, and that each column parses as it does with strtod.
+size_t CheckGluedColumns(std::string const &Line,
+                         std::vector<std::string> const &Expected) {
+  GiBUUParsing::Column cols[GiBUUParsing::kMaxColumns];
+  size_t const NColumns = GiBUUParsing::SplitColumns(
+      Line.data(), Line.data() + Line.size(), cols, true);
+  size_t NFailures = 0;
+  if (NColumns != Expected.size()) {
+    std::cout << "[ERROR]: SplitColumns(\"" << Line << "\") found "
+              << NColumns << " columns, expected " << Expected.size()
+              << std::endl;
+    return 1;
+  }
+  for (size_t c_it = 0; c_it < NColumns; ++c_it) {
+    std::string const col(cols[c_it].begin, cols[c_it].end);
+    if (col != Expected[c_it]) {
+      std::cout << "[ERROR]: SplitColumns(\"" << Line << "\") column "
+                << c_it << " was \"" << col << "\", expected \""
+                << Expected[c_it] << "\"" << std::endl;
+      NFailures++;
+    }
+    NFailures += CheckParseDouble(col);
+  }
+  return NFailures;
+}
+
+// Compares the ParseDouble fast path with strtod on the edges of the fast
+// path and on randomly generated numbers in the formats that GiBUU writes.
+size_t CheckParseDoubles() {
+  static char const *const Cases[] = {
+      // 19 and 20 significant digits.
+      "1234567890123456789", "9999999999999999999", "-1234567890123456789E-5",
+      "0.1234567890123456789", "0.0000001234567890123456789",
+      "12345678901234567890", "1.2345678901234567890E+10",
+      "1000000000000000000000",
+      // Around 2^53.
+      "9007199254740991", "9007199254740992", "9007199254740993",
+      "9007199254740992E-3", "-9007199254740993E+2", "900719925474099.3",
+      // Around the largest exact power of ten.
+      "1E22", "1E23", "1E-22", "1E-23", "1.5E+22", "4.2E-23", "-1E22",
+      "-1E-23", "123456789E+14", "123456789E+15", "9007199254740991E22",
+      "9007199254740991E-22", "1E308", "1E309", "1E-320", "0E-400",
+      // Signs and zeros.
+      "+3.25", "-3.25", "-0", "-0.0", "+0.0", "0", "-0.0E+00", "+-1", "--1",
+      // Whitespace.
+      " 1.5", "\t-2.5E+01", "  +7", "1.5 ", "1.5\n", "-2.5E+01\t", " ",
+      // Malformed or unusual.
+      "", "-", "+", ".", "E5", ".5", "5.", "-.5E-1", "1.0E", "1.0E+",
+      "1.0E-05x", "1.0.0", "1e5", "1d5", "0x10", "nan", "-inf", "1,5"};
+  size_t NChecks = 0, NFailures = 0;
+  for (size_t c_it = 0; c_it < (sizeof(Cases) / sizeof(Cases[0]));
+       ++c_it) {
+    NFailures += CheckParseDouble(Cases[c_it]);
+    NChecks++;
+  }
+
+  static char const *const Formats[] = {"%.8E", "%.15E", "%.17g", "%.3f",
+                                        "%g"};
+  size_t const NFormats = sizeof(Formats) / sizeof(Formats[0]);
+  unsigned long state = 54321;
+  char buf[64];
+  for (size_t r_it = 0; r_it < 100000; ++r_it) {
+    state = (state * 6364136223846793005ul) + 1442695040888963407ul;
+    double const Mantissa = double(state >> 11) / double(1ul << 53);
+    int const Exponent = int((state >> 3) % 61) - 30;
+    double const val = ((state & 1) ? -1 : 1) * Mantissa *
+                       std::pow(10.0, double(Exponent));
+    std::snprintf(buf, sizeof(buf), Formats[r_it % NFormats], val);
+    NFailures += CheckParseDouble(buf);
+    NChecks++;
+  }
+
+  struct GluedCase {
+    char const *Line;
+    char const *Columns[4];
+  };
+  static GluedCase const Glued[] = {
+      {"  1.0E+00-2.5E-01-3.0E+00 4.0",
+       {"1.0E+00", "-2.5E-01", "-3.0E+00", "4.0"}},
+      {"-1.5-2.5 -3.5E-23", {"-1.5", "-2.5", "-3.5E-23", NULL}},
+      {"9007199254740993-1E22-1E23", {"9007199254740993", "-1E22", "-1E23",
+                                      NULL}},
+      {"0.0-0.0 1.0E-05-0.5", {"0.0", "-0.0", "1.0E-05", "-0.5"}}};
+  for (size_t g_it = 0; g_it < (sizeof(Glued) / sizeof(Glued[0])); ++g_it) {
+    std::vector<std::string> Expected;
+    for (size_t c_it = 0; (c_it < 4) && Glued[g_it].Columns[c_it]; ++c_it) {
+      Expected.push_back(Glued[g_it].Columns[c_it]);
+    }
+    NFailures += CheckGluedColumns(Glued[g_it].Line, Expected);
+    NChecks++;
+  }
+
+  std::cout << "[ParseDouble]: " << (NChecks - NFailures) << "/" << NChecks
+            << " checks agree with strtod." << std::endl;
+  return NFailures;
+}
+
+bool SameEvents(GiBUUEventBatch const &a, GiBUUEventBatch const &b) {
+  return (a.Run == b.Run) && (a.EvNum == b.EvNum) &&
+         (a.PerWeight == b.PerWeight) && (a.Prodid == b.Prodid) &&
+         (a.EProbe == b.EProbe) && (a.ProdCharge == b.ProdCharge) &&
+         (a.EventOffsets == b.EventOffsets) && (a.ID == b.ID) &&
+         (a.Charge == b.Charge) && (a.Position == b.Position) &&
+         (a.FourMom == b.FourMom) && (a.History == b.History) &&
+         (a.ln == b.ln) && (a.IDIsPDG == b.IDIsPDG);
+}
+
+// Checks that parsing FinalEvents in chunks on a FinalEventsChunkParser, as
+// -P does, gives the same events as assembling it line by line. The chunks are
+// made small, and of sizes that fall in the middle of lines and events, so
+// that many events straddle the nominal chunk boundaries. Returns the number
+// of mismatches.
+size_t CheckParallelParse(std::string const &FinalEvents) {
+  char const *const begin = FinalEvents.data();
+  char const *const end = begin + FinalEvents.size();
+
+  GiBUUEventBatch Serial;
+  {
+    GiBUUParsing::FinalEventsAssembler assembler;
+    char const *lbegin = begin;
+    while (lbegin < end) {
+      char const *lend = std::find(lbegin, end, '\n');
+      assembler.AddLine(lbegin, lend, Serial);
+      lbegin = (lend == end) ? end : (lend + 1);
+    }
+    assembler.Finish(Serial);
+  }
+
+  static size_t const ChunkBytes[] = {997, 4096, 65521};
+  size_t const NThreads = 4;
+  size_t const NInFlight = NThreads + 1;
+  GiBUUParsing::FinalEventsChunkParser ChunkParser(NThreads);
+  size_t NFailures = 0;
+  for (size_t b_it = 0; b_it < (sizeof(ChunkBytes) / sizeof(ChunkBytes[0]));
+       ++b_it) {
+    GiBUUEventBatch Parallel;
+    std::vector<GiBUUParsing::FinalEventsChunk> Chunks(NInFlight);
+    size_t Oldest = 0, NQueued = 0, NChunks = 0, LineNum = 0;
+    char const *cursor = begin;
+    for (;;) {
+      for (; (NQueued < NInFlight) && (cursor < end); ++NQueued) {
+        GiBUUParsing::FinalEventsChunk &chunk =
+            Chunks[(Oldest + NQueued) % NInFlight];
+        chunk.begin = cursor;
+        chunk.end = (size_t(end - cursor) <= ChunkBytes[b_it])
+                        ? end
+                        : GiBUUParsing::FindNextEventBoundary(
+                              cursor + ChunkBytes[b_it], end);
+        chunk.Events.Clear();
+        chunk.NLines = 0;
+        chunk.BuildIndex = false;
+        cursor = chunk.end;
+        ChunkParser.Submit(chunk);
+        NChunks++;
+      }
+      if (!NQueued) {
+        break;
+      }
+      GiBUUParsing::FinalEventsChunk &chunk = Chunks[Oldest];
+      ChunkParser.Wait(chunk);
+      Oldest = (Oldest + 1) % NInFlight;
+      NQueued--;
+      for (size_t p_it = 0; p_it < chunk.Events.ln.size(); ++p_it) {
+        chunk.Events.ln[p_it] += LineNum;
+      }
+      LineNum += chunk.NLines;
+      Parallel.Append(chunk.Events);
+    }
+
+    if (!SameEvents(Serial, Parallel)) {
+      std::cout << "[ERROR]: Parsing in " << NChunks << " chunks of about "
+                << ChunkBytes[b_it] << " bytes gave " << Parallel.GetNEvents()
+                << " events, " << Parallel.GetNParticles()
+                << " particles that differ from the "
+                << Serial.GetNEvents() << " events, "
+                << Serial.GetNParticles()
+                << " particles assembled serially." << std::endl;
+      NFailures++;
+    }
+  }
+
+  std::cout << "[FinalEventsChunkParser]: "
+            << ((sizeof(ChunkBytes) / sizeof(ChunkBytes[0])) - NFailures)
+            << "/" << (sizeof(ChunkBytes) / sizeof(ChunkBytes[0]))
+            << " chunkings agree with serial parsing." << std::endl;
+  return NFailures;
+}
+
+long BenchReadEvent(std::string const &FileName) {
+  GiBUUEventBatch Events;
+  size_t NEvents = 0;
+  std::chrono::steady_clock::time_point const start =
+      std::chrono::steady_clock::now();
+  {
+    LHVectorReader lhevr(FileName);
+    while (lhevr.ReadEvent(Events)) {
+      if (++NEvents % 10000) {
+        continue;
+      }
+      Events.Clear();
+    }
+  }
+  double const Seconds = SecondsSince(start);
+
+  std::ifstream ifs(FileName.c_str(), std::ios::binary | std::ios::ate);
+  std::cout << "[LHVectorReader::ReadEvent]: "
+            << (double(NEvents) / Seconds) << " events/s, "
+            << (double(ifs.tellg()) / (1E6 * Seconds)) << " MB/s"
+            << std::endl;
+  return long(NEvents);
+}
+
+// Builds the StdHep arrays of each event as the converter does, without the
+// kinematics.
+void BuildStdHep(GiBUUEventBatch const &Events, std::vector<Int_t> &PDG,
+                 std::vector<Long_t> &History, std::vector<size_t> &Offsets) {
+  for (size_t ev_it = 0; ev_it < Events.GetNEvents(); ++ev_it) {
+    Offsets.push_back(PDG.size());
+    PDG.push_back(14);
+    PDG.push_back(1000060120);
+    History.push_back(0);
+    History.push_back(0);
+    for (size_t p_it = Events.EventOffsets[ev_it];
+         p_it < Events.EventOffsets[ev_it + 1]; ++p_it) {
+      PDG.push_back(GiBUUUtils::GiBUUToPDG(Events.ID[p_it],
+                                            Events.Charge[p_it]));
+      History.push_back(Events.History[p_it]);
+    }
+  }
+  Offsets.push_back(PDG.size());
+}
+
+long BenchReactionCode(GiBUUEventBatch const &Events) {
+  std::vector<Int_t> PDG;
+  std::vector<Long_t> History;
+  std::vector<size_t> Offsets;
+  BuildStdHep(Events, PDG, History, Offsets);
+
+  long Sink = 0;
+  size_t const NRepeats = 20;
+  size_t const NEvents = Events.GetNEvents();
+  std::chrono::steady_clock::time_point const start =
+      std::chrono::steady_clock::now();
+  for (size_t r = 0; r < NRepeats; ++r) {
+    for (size_t ev_it = 0; ev_it < NEvents; ++ev_it) {
+      Sink += GiBUUUtils::GiBUU2NeutReacCode(
+          Events.Prodid[ev_it], &PDG[Offsets[ev_it]],
+#ifndef CPP03COMPAT
+          &History[Offsets[ev_it]],
+#endif
+          Int_t(Offsets[ev_it + 1] - Offsets[ev_it]), true, 3,
+          Events.ProdCharge[ev_it]);
+    }
+  }
+  double const Seconds = SecondsSince(start);
+
+  std::cout << "[GiBUU2NeutReacCode]: "
+            << (1E9 * Seconds / double(NRepeats * NEvents)) << " ns/event"
+            << std::endl;
+  return Sink;
+}
+
+void BenchFlushEventsToDisk(GiBUUEventBatch const &Events,
+                            std::string const &FileName, bool CompactP4) {
+  GiRooTrackerBatch Converted;
+  GiRooTracker tracker;
+  for (size_t ev_it = 0; ev_it < Events.GetNEvents(); ++ev_it) {
+    tracker.Reset();
+    tracker.EvtNum = Events.EvNum[ev_it];
+    tracker.GiBUUReactionCode = Events.Prodid[ev_it];
+    tracker.GiBUUPerWeight = Events.PerWeight[ev_it];
+    tracker.StdHepN = 0;
+    for (size_t p_it = Events.EventOffsets[ev_it];
+         (p_it < Events.EventOffsets[ev_it + 1]) &&
+         (tracker.StdHepN < GiRooTracker::kGiStdHepNPmax);
+         ++p_it) {
+      tracker.StdHepPdg[tracker.StdHepN] =
+          GiBUUUtils::GiBUUToPDG(Events.ID[p_it], Events.Charge[p_it]);
+      tracker.StdHepStatus[tracker.StdHepN] = 1;
+      std::copy(Events.FourMom.begin() + 4 * p_it,
+                Events.FourMom.begin() + 4 * (p_it + 1),
+                tracker.StdHepP4[tracker.StdHepN]);
+      tracker.GiBHepHistory[tracker.StdHepN] = Events.History[p_it];
+      tracker.StdHepN++;
+    }
+    Converted.Append(tracker);
+  }
+
+  GiBUUToStdHepOpts::CompactP4Output = CompactP4;
+  TFile *outFile = new TFile(FileName.c_str(), "RECREATE");
+  TTree *tree = new TTree("giRooTracker", "GiBUU StdHepVariables");
+  GiRooTracker *giRooTracker = new GiRooTracker();
+  giRooTracker->AddBranches(tree, true, true, 0, CompactP4);
+
+  std::chrono::steady_clock::time_point const start =
+      std::chrono::steady_clock::now();
+  size_t const NEvents = FlushEventsToDisk(tree, giRooTracker, Converted);
+  tree->Write();
+  outFile->Close();
+  double const Seconds = SecondsSince(start);
+
+  std::cout << "[FlushEventsToDisk" << (CompactP4 ? " -CP" : "")
+            << "]: " << (double(NEvents) / Seconds)
+            << " events/s (including the final Write)" << std::endl;
+  delete giRooTracker;
+  delete outFile;
+  std::remove(FileName.c_str());
+}
+
+struct EndToEndMode {
+  char const *Name;
+  GiBUUSynthetic::Config::Mode EventMode;
+  bool LesHouches;
+  bool InitialStateInfo;
+  char const *Args;
+};
+
+// Runs GiBUUToStdHep.exe over a synthetic file for each input mode and
+// reports the overall conversion rate.
+void BenchEndToEnd(std::string const &Exe, std::string const &WorkDir,
+                   size_t NEvents) {
+  EndToEndMode const Modes[] = {
+      {"nu FinalEvents", GiBUUSynthetic::Config::kNeutrino, false, true,
+       "-u 14"},
+      {"nu FinalEvents -NI -NP", GiBUUSynthetic::Config::kNeutrino, false,
+       false, "-NI -NP -u 14"},
+      {"nu Les Houches", GiBUUSynthetic::Config::kNeutrino, true, true,
+       "-u 14"},
+      {"e-scat FinalEvents", GiBUUSynthetic::Config::kElectron, false, true,
+       "-e"},
+      {"NDK Les Houches", GiBUUSynthetic::Config::kNDK, true, true, "-K"},
+  };
+  size_t const NModes = sizeof(Modes) / sizeof(Modes[0]);
+
+  for (size_t m_it = 0; m_it < NModes; ++m_it) {
+    GiBUUSynthetic::Config cfg;
+    cfg.EventMode = Modes[m_it].EventMode;
+    cfg.StruckNucleonInfo = Modes[m_it].InitialStateInfo;
+    cfg.ProdChargeInfo = Modes[m_it].InitialStateInfo;
+    cfg.NEvents = NEvents;
+
+    std::string const InpFName =
+        WorkDir + "/GiBUUToStdHepBench_input" +
+        (Modes[m_it].LesHouches ? ".lhe" : ".dat");
+    std::string const OutFName = WorkDir + "/GiBUUToStdHepBench_output.root";
+    {
+      std::ofstream ofs(InpFName.c_str());
+      if (Modes[m_it].LesHouches) {
+        GiBUUSynthetic::WriteLesHouches(ofs, cfg);
+      } else {
+        GiBUUSynthetic::WriteFinalEvents(ofs, cfg);
+      }
+    }
+
+    std::string const Command = Exe + " " + Modes[m_it].Args +
+                                " -a 12 -z 6 -f " + InpFName + " -o " +
+                                OutFName + " > " + WorkDir +
+                                "/GiBUUToStdHepBench.log 2>&1";
+    std::chrono::steady_clock::time_point const start =
+        std::chrono::steady_clock::now();
+    int const RtnCode = std::system(Command.c_str());
+    double const Seconds = SecondsSince(start);
+
+    if (RtnCode) {
+      std::cout << "[End-to-end " << Modes[m_it].Name
+                << "]: failed, see " << WorkDir << "/GiBUUToStdHepBench.log"
+                << std::endl;
+      continue;
+    }
+    std::cout << "[End-to-end " << Modes[m_it].Name
+              << "]: " << (double(NEvents) / Seconds) << " events/s"
+              << std::endl;
+    std::remove(InpFName.c_str());
+    std::remove(OutFName.c_str());
+  }
+}
+
+// Converts the same synthetic file with each --output-profile and reports the
+// conversion rate and the size of the output file.
+void BenchOutputProfiles(std::string const &Exe, std::string const &WorkDir,
+                         size_t NEvents) {
+  char const *const Profiles[] = {"default", "scratch", "archive"};
+  size_t const NProfiles = sizeof(Profiles) / sizeof(Profiles[0]);
+
+  GiBUUSynthetic::Config cfg;
+  cfg.NEvents = NEvents;
+  std::string const InpFName = WorkDir + "/GiBUUToStdHepBench_input.dat";
+  std::string const OutFName = WorkDir + "/GiBUUToStdHepBench_output.root";
+  {
+    std::ofstream ofs(InpFName.c_str());
+    GiBUUSynthetic::WriteFinalEvents(ofs, cfg);
+  }
+
+  for (size_t p_it = 0; p_it < NProfiles; ++p_it) {
+    std::string const Command = Exe + " -u 14 -a 12 -z 6 --output-profile " +
+                                Profiles[p_it] + " -f " + InpFName + " -o " +
+                                OutFName + " > " + WorkDir +
+                                "/GiBUUToStdHepBench.log 2>&1";
+    std::chrono::steady_clock::time_point const start =
+        std::chrono::steady_clock::now();
+    int const RtnCode = std::system(Command.c_str());
+    double const Seconds = SecondsSince(start);
+
+    if (RtnCode) {
+      std::cout << "[Output profile " << Profiles[p_it] << "]: failed, see "
+                << WorkDir << "/GiBUUToStdHepBench.log" << std::endl;
+      continue;
+    }
+    std::cout << "[Output profile " << Profiles[p_it]
+              << "]: " << (double(NEvents) / Seconds) << " events/s, "
+              << (double(GetInputFileSize(OutFName)) / 1E6) << " MB"
+              << std::endl;
+    std::remove(OutFName.c_str());
+  }
+  std::remove(InpFName.c_str());
+}
+} // namespace
+
+///\brief Micro-benchmarks for the hot paths of GiBUUToStdHep, and end-to-end
+/// conversion rates, measured on deterministic synthetic input.
+///
+/// Prints the mean time per call, or throughput, for each benchmark. First
+/// checks that the fast paths being timed agree with the code that they
+/// replace, and exits with 1 if they do not.
+///
+/// Options:
+/// - -n <N>: the number of synthetic events to use {default:100000}.
+/// - -d <dir>: the directory for temporary files {default:.}.
+/// - -x <GiBUUToStdHep.exe>: also time the whole conversion for each input
+///   mode, and the conversion and output size for each output profile.
+int main(int argc, char const *argv[]) {
+  size_t NEvents = 100000;
+  std::string WorkDir = ".";
+  std::string Exe = "";
+  for (int a_it = 1; (a_it + 1) < argc; a_it += 2) {
+    std::string const arg = argv[a_it];
+    if (arg == "-n") {
+      NEvents = size_t(Utils::str2i(argv[a_it + 1], true));
+    } else if (arg == "-d") {
+      WorkDir = argv[a_it + 1];
+    } else if (arg == "-x") {
+      Exe = argv[a_it + 1];
+    } else {
+      std::cout << "[ERROR]: Unexpected argument: " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  // The layout that the synthetic events are written with by default.
+  GiBUUToStdHepOpts::HaveStruckNucleonInfo = true;
+  GiBUUToStdHepOpts::HaveProdChargeInfo = true;
+
+  GiBUUSynthetic::Config cfg;
+  cfg.NEvents = NEvents;
+  std::stringstream FinalEvents("");
+  GiBUUSynthetic::WriteFinalEvents(FinalEvents, cfg);
+  std::string const FinalEventsText = FinalEvents.str();
+
+  GiBUUEventBatch Events;
+  {
+    std::vector<char const *> Begins, Ends;
+    SplitLines(FinalEventsText, Begins, Ends);
+    GiBUUParsing::FinalEventsAssembler assembler;
+    for (size_t l_it = 0; l_it < Begins.size(); ++l_it) {
+      assembler.AddLine(Begins[l_it], Ends[l_it], Events);
+    }
+    assembler.Finish(Events);
+  }
+
+  size_t NFailures = CheckParseDoubles();
+  NFailures += CheckParallelParse(FinalEventsText);
+
+  std::string const LHEFName = WorkDir + "/GiBUUToStdHepBench_input.lhe";
+  {
+    std::ofstream ofs(LHEFName.c_str());
+    GiBUUSynthetic::WriteLesHouches(ofs, cfg);
+  }
+
+
+  long Sink = BenchCodeLookups();
+  Sink += BenchGetParticleLine(FinalEventsText);
+  Sink += BenchReadEvent(LHEFName);
+  std::remove(LHEFName.c_str());
+  Sink += BenchReactionCode(Events);
+  BenchFlushEventsToDisk(Events, WorkDir + "/GiBUUToStdHepBench_output.root",
+                         false);
+  BenchFlushEventsToDisk(Events, WorkDir + "/GiBUUToStdHepBench_output.root",
+                         true);
+
+  if (Exe.size()) {
+    BenchEndToEnd(Exe, WorkDir, NEvents);
+    BenchOutputProfiles(Exe, WorkDir, NEvents);
+  }
+  if (NFailures) {
+    std::cout << "[ERROR]: " << NFailures << " checks failed." << std::endl;
+    return 1;
+  }
+  // Keep the results alive.
+  return (Sink == 0xdeadbeef);
+}
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
 #include <fstream>
 
 // Unix
@@ -32,6 +35,27 @@ std::map<int, double> CompositeFluxWeight;
 bool HaveProdChargeInfo = false;
 std::vector<std::pair<std::string, std::string>> FluxFilesToAdd;
 bool StrictMode = true;
+bool UseMMapInput = false;
+bool UseInputIndex = true;
+std::string EventCacheDir = "";
+size_t NParseThreads = 1;
+unsigned NIMTThreads = 0;
+int MaxWarningsPerCategory = 5;
+bool ReportTiming = false;
+std::string TimingJSONFile = "";
+double ProgressInterval = 30;
+bool CompactP4Output = false;
+bool DerivedKinematicsOutput = false;
+int OutputCompression = -1;
+int OutputBasketSize = 0;
+long long OutputAutoFlush = 0;
+long long OutputAutoSave = 0;
+bool AppendOutput = false;
+bool ReweightOutput = false;
+double CheckpointInterval = 0;
+bool ResumeConversion = false;
+size_t ShardIndex = 0;
+size_t NShards = 1;
 } // namespace GiBUUToStdHepOpts
 
 std::vector<std::string> CLIFileArgs;
@@ -81,22 +105,29 @@ bool AddFiles(std::string const &OptVal, bool IsCC, int NuType, int TargetA,
     TRegexp matchExp(matchPat.c_str(), true);
     /* print all the files and directories within directory */
     Ssiz_t len = 0;
-    size_t NFilesAdded = 0;
+    std::vector<std::string> Matches;
     while ((ent = readdir(dir)) != NULL) {
       if (matchExp.Index(TString(ent->d_name), &len) != Ssiz_t(-1)) {
-        UDBLog("\t\t\tAdding matching file: "
-               << (dirpath + ent->d_name) << "(nu: " << NuType
-               << ", A: " << TargetA << ", Z: " << TargetZ
-               << ", TW: " << FileExtraWeight << ", IsCC: " << IsCC << ")");
-        GiBUUToStdHepOpts::InpFNames.push_back((dirpath + ent->d_name));
-        GiBUUToStdHepOpts::ProbeTypes.push_back(NuType);
-        GiBUUToStdHepOpts::TargetAs.push_back(TargetA);
-        GiBUUToStdHepOpts::TargetZs.push_back(TargetZ);
-        GiBUUToStdHepOpts::CCFiles.push_back(IsCC);
-        NFilesAdded++;
+        Matches.push_back(dirpath + ent->d_name);
       }
     }
     closedir(dir);
+    // The directory order depends on the file system, but input files must be
+    // added in the same order by every job for --shard to partition them.
+    std::sort(Matches.begin(), Matches.end());
+
+    size_t NFilesAdded = Matches.size();
+    for (size_t file_it = 0; file_it < NFilesAdded; ++file_it) {
+      UDBLog("\t\t\tAdding matching file: "
+             << Matches[file_it] << "(nu: " << NuType << ", A: " << TargetA
+             << ", Z: " << TargetZ << ", TW: " << FileExtraWeight
+             << ", IsCC: " << IsCC << ")");
+      GiBUUToStdHepOpts::InpFNames.push_back(Matches[file_it]);
+      GiBUUToStdHepOpts::ProbeTypes.push_back(NuType);
+      GiBUUToStdHepOpts::TargetAs.push_back(TargetA);
+      GiBUUToStdHepOpts::TargetZs.push_back(TargetZ);
+      GiBUUToStdHepOpts::CCFiles.push_back(IsCC);
+    }
 
     for (size_t file_it = 0; file_it < NFilesAdded; ++file_it) {
       GiBUUToStdHepOpts::FileExtraWeights.push_back(FileExtraWeight);
@@ -387,6 +418,314 @@ bool Handle_NoProdCharge(std::string const &opt) {
   return true;
 }
 
+bool Handle_MMapInput(std::string const &opt) {
+  GiBUUToStdHepOpts::UseMMapInput = true;
+  UDBLog("\t--Reading FinalEvents.dat files through a memory mapping.");
+  return true;
+}
+
+bool Handle_NoIndex(std::string const &opt) {
+  GiBUUToStdHepOpts::UseInputIndex = false;
+  UDBLog("\t--Not using FinalEvents.dat index files.");
+  return true;
+}
+
+bool Handle_EventCache(std::string const &opt) {
+  if (opt.empty()) {
+    UDBError("Expected an event cache directory.");
+    return false;
+  }
+  GiBUUToStdHepOpts::EventCacheDir = opt;
+  UDBLog("\t--Caching parsed FinalEvents.dat files in: " << opt);
+  return true;
+}
+
+bool Handle_ParseThreads(std::string const &opt) {
+  int ival = 0;
+  try {
+    ival = Utils::str2i(opt, true);
+  } catch (...) {
+    return false;
+  }
+  if (ival < 1) {
+    UDBError("Expected a positive number of parse threads, but found: "
+             << opt);
+    return false;
+  }
+  GiBUUToStdHepOpts::NParseThreads = size_t(ival);
+  UDBLog("\t--Parsing FinalEvents.dat files with " << ival << " threads.");
+  return true;
+}
+
+bool Handle_IMTThreads(std::string const &opt) {
+  int ival = 0;
+  try {
+    ival = Utils::str2i(opt, true);
+  } catch (...) {
+    return false;
+  }
+  if (ival < 1) {
+    UDBError("Expected a positive number of output threads, but found: "
+             << opt);
+    return false;
+  }
+  GiBUUToStdHepOpts::NIMTThreads = unsigned(ival);
+  UDBLog("\t--Compressing output with " << ival << " threads.");
+  return true;
+}
+
+bool Handle_MaxWarnings(std::string const &opt) {
+  int ival = 0;
+  try {
+    ival = Utils::str2i(opt, true);
+  } catch (...) {
+    return false;
+  }
+  if (ival < -1) {
+    UDBError("Expected a number of warnings >= -1, but found: " << opt);
+    return false;
+  }
+  GiBUUToStdHepOpts::MaxWarningsPerCategory = ival;
+  UDBLog("\t--Printing at most " << ival
+                                 << " warnings of each kind (-1: all).");
+  return true;
+}
+
+bool Handle_Timing(std::string const &opt) {
+  GiBUUToStdHepOpts::ReportTiming = true;
+  UDBLog("\t--Reporting per-stage timing and throughput.");
+  return true;
+}
+
+bool Handle_TimingJSON(std::string const &opt) {
+  GiBUUToStdHepOpts::ReportTiming = true;
+  GiBUUToStdHepOpts::TimingJSONFile = opt;
+  UDBLog("\t--Writing timing report to: " << opt);
+  return true;
+}
+
+bool Handle_Progress(std::string const &opt) {
+  double dval = 0;
+  try {
+    dval = Utils::str2d(opt, true);
+  } catch (...) {
+    return false;
+  }
+  if (dval < 0) {
+    UDBError("Expected a progress interval >= 0 s, but found: " << opt);
+    return false;
+  }
+  GiBUUToStdHepOpts::ProgressInterval = dval;
+  if (dval > 0) {
+    UDBLog("\t--Reporting progress every " << dval << " s.");
+  } else {
+    UDBLog("\t--Not reporting progress.");
+  }
+  return true;
+}
+
+bool Handle_CompactP4(std::string const &opt) {
+  GiBUUToStdHepOpts::CompactP4Output = true;
+  UDBLog("\t--Writing four momenta as StdHepN-sized component branches.");
+  return true;
+}
+
+bool Handle_DerivedKinematics(std::string const &opt) {
+  GiBUUToStdHepOpts::DerivedKinematicsOutput = true;
+  UDBLog("\t--Writing derived kinematics branches.");
+  return true;
+}
+
+bool Handle_Compression(std::string const &opt) {
+  std::vector<std::string> const &split = Utils::SplitStringByDelim(opt, ":");
+  if (!split.size() || (split.size() > 2)) {
+    return false;
+  }
+
+  int setting = 0;
+  // Default levels follow ROOT's own presets.
+  int alg = 0, level = 0;
+  if (split.front() == "none") {
+    alg = 0;
+  } else if (split.front() == "zlib") {
+    alg = 1;
+    level = 1;
+  } else if (split.front() == "lzma") {
+    alg = 2;
+    level = 7;
+  } else if (split.front() == "lz4") {
+    alg = 4;
+    level = 4;
+  } else if (split.front() == "zstd") {
+    alg = 5;
+    level = 5;
+  } else { // Raw ROOT compression setting
+    if (split.size() != 1) {
+      return false;
+    }
+    try {
+      setting = Utils::str2i(split.front(), true);
+    } catch (...) {
+      UDBError("Expected one of none, zlib, lzma, lz4, zstd or a ROOT "
+               "compression setting, but found: "
+               << opt);
+      return false;
+    }
+    alg = setting / 100;
+    level = setting % 100;
+  }
+
+  if (split.size() == 2) {
+    try {
+      level = Utils::str2i(split.back(), true);
+    } catch (...) {
+      return false;
+    }
+  }
+
+  if ((setting < 0) || (level < 0) || (level > 9) || (alg > 5)) {
+    UDBError("Invalid compression setting: " << opt);
+    return false;
+  }
+
+  GiBUUToStdHepOpts::OutputCompression = alg ? (100 * alg + level) : 0;
+  UDBLog("\t--Writing output with ROOT compression setting: "
+         << GiBUUToStdHepOpts::OutputCompression);
+  return true;
+}
+
+bool Handle_BasketSize(std::string const &opt) {
+  int ival = 0;
+  try {
+    ival = Utils::str2i(opt, true);
+  } catch (...) {
+    return false;
+  }
+  if (ival < 0) {
+    UDBError("Expected a non-negative basket size, but found: " << opt);
+    return false;
+  }
+  GiBUUToStdHepOpts::OutputBasketSize = ival;
+  UDBLog("\t--Using output basket size: " << ival << " bytes.");
+  return true;
+}
+
+namespace {
+// Utils::str2i only reads an int, which byte counts can overflow.
+bool ParseLongLong(std::string const &opt, long long &val) {
+  char *end = NULL;
+  errno = 0;
+  val = std::strtoll(opt.c_str(), &end, 10);
+  if (opt.empty() || errno || (*end != '\0')) {
+    UDBError("Expected an integer, but found: " << opt);
+    return false;
+  }
+  return true;
+}
+} // namespace
+
+bool Handle_AutoFlush(std::string const &opt) {
+  if (!ParseLongLong(opt, GiBUUToStdHepOpts::OutputAutoFlush)) {
+    return false;
+  }
+  UDBLog("\t--Setting output tree AutoFlush: "
+         << GiBUUToStdHepOpts::OutputAutoFlush);
+  return true;
+}
+
+bool Handle_AutoSave(std::string const &opt) {
+  if (!ParseLongLong(opt, GiBUUToStdHepOpts::OutputAutoSave)) {
+    return false;
+  }
+  UDBLog("\t--Setting output tree AutoSave: "
+         << GiBUUToStdHepOpts::OutputAutoSave);
+  return true;
+}
+
+bool Handle_OutputProfile(std::string const &opt) {
+  if (opt == "default") {
+    GiBUUToStdHepOpts::OutputCompression = -1;
+    GiBUUToStdHepOpts::OutputBasketSize = 0;
+  } else if (opt == "scratch") { // Fast to write and read back.
+    GiBUUToStdHepOpts::OutputCompression = 404;
+    GiBUUToStdHepOpts::OutputBasketSize = 256000;
+  } else if (opt == "archive") { // Small.
+    GiBUUToStdHepOpts::OutputCompression = 207;
+    GiBUUToStdHepOpts::OutputBasketSize = 256000;
+  } else {
+    UDBError("Expected one of default, scratch or archive, but found: "
+             << opt);
+    return false;
+  }
+  UDBLog("\t--Using the " << opt << " output profile.");
+  return true;
+}
+
+bool Handle_Append(std::string const &opt) {
+  GiBUUToStdHepOpts::AppendOutput = true;
+  UDBLog("\t--Appending new input files to the output file.");
+  return true;
+}
+
+bool Handle_Reweight(std::string const &opt) {
+  GiBUUToStdHepOpts::ReweightOutput = true;
+  UDBLog("\t--Reweighting the events already in the output file.");
+  return true;
+}
+
+bool Handle_Checkpoint(std::string const &opt) {
+  double dval = 0;
+  try {
+    dval = Utils::str2d(opt, true);
+  } catch (...) {
+    return false;
+  }
+  if (dval < 0) {
+    UDBError("Expected a checkpoint interval >= 0 s, but found: " << opt);
+    return false;
+  }
+  GiBUUToStdHepOpts::CheckpointInterval = dval;
+  if (dval > 0) {
+    UDBLog("\t--Checkpointing the conversion every " << dval << " s.");
+  } else {
+    UDBLog("\t--Not checkpointing the conversion.");
+  }
+  return true;
+}
+
+bool Handle_Resume(std::string const &opt) {
+  GiBUUToStdHepOpts::ResumeConversion = true;
+  UDBLog("\t--Resuming the conversion from its last checkpoint.");
+  return true;
+}
+
+bool Handle_Shard(std::string const &opt) {
+  std::vector<std::string> const &split = Utils::SplitStringByDelim(opt, "/");
+  if (split.size() != 2) {
+    UDBError("Expected --shard argument to look like `i/N`, but found: "
+             << opt);
+    return false;
+  }
+  int Index = 0, NShards = 0;
+  try {
+    Index = Utils::str2i(split[0], true);
+    NShards = Utils::str2i(split[1], true);
+  } catch (...) {
+    return false;
+  }
+  if ((NShards < 1) || (Index < 0) || (Index >= NShards)) {
+    UDBError("Expected a shard index from 0 to N-1 of N >= 1 shards, but "
+             "found: "
+             << opt);
+    return false;
+  }
+  GiBUUToStdHepOpts::ShardIndex = size_t(Index);
+  GiBUUToStdHepOpts::NShards = size_t(NShards);
+  UDBLog("\t--Converting shard " << Index << " of " << NShards
+                                 << " of the input files.");
+  return true;
+}
+
 bool Handle_SaveFluxFile(std::string const &opt) {
   std::vector<std::string> const &split = Utils::SplitStringByDelim(opt, ",");
   if (split.size() != 2) {
@@ -596,6 +935,168 @@ bool HandleArgs(int const argc, char const *argv[]) {
       LastArgOkay = Handle_NoProdCharge(opt);
       continue;
     }
+    if (("-M" == arg) || ("--mmap-input" == arg)) {
+      LastArgOkay = Handle_MMapInput(opt);
+      continue;
+    }
+    if ("--no-index" == arg) {
+      LastArgOkay = Handle_NoIndex(opt);
+      continue;
+    }
+    if ("--event-cache" == arg) {
+      if (opt_it == ArgArray.size()) {
+        UDBError("Parameter --event-cache expected an option.");
+        SayRunLike(argv);
+        exit(1);
+      }
+      opt = ArgArray[opt_it++];
+      LastArgOkay = Handle_EventCache(opt);
+      continue;
+    }
+    if (("-P" == arg) || ("--parse-threads" == arg)) {
+      if (opt_it == ArgArray.size()) {
+        UDBError("Parameter -P expected an option.");
+        SayRunLike(argv);
+        exit(1);
+      }
+      opt = ArgArray[opt_it++];
+      LastArgOkay = Handle_ParseThreads(opt);
+      continue;
+    }
+    if (("-j" == arg) || ("--output-threads" == arg)) {
+      if (opt_it == ArgArray.size()) {
+        UDBError("Parameter -j expected an option.");
+        SayRunLike(argv);
+        exit(1);
+      }
+      opt = ArgArray[opt_it++];
+      LastArgOkay = Handle_IMTThreads(opt);
+      continue;
+    }
+    if ("--max-warnings" == arg) {
+      if (opt_it == ArgArray.size()) {
+        UDBError("Parameter --max-warnings expected an option.");
+        SayRunLike(argv);
+        exit(1);
+      }
+      opt = ArgArray[opt_it++];
+      LastArgOkay = Handle_MaxWarnings(opt);
+      continue;
+    }
+    if ("--timing" == arg) {
+      LastArgOkay = Handle_Timing(opt);
+      continue;
+    }
+    if ("--timing-json" == arg) {
+      if (opt_it == ArgArray.size()) {
+        UDBError("Parameter --timing-json expected an option.");
+        SayRunLike(argv);
+        exit(1);
+      }
+      opt = ArgArray[opt_it++];
+      LastArgOkay = Handle_TimingJSON(opt);
+      continue;
+    }
+    if ("--progress" == arg) {
+      if (opt_it == ArgArray.size()) {
+        UDBError("Parameter --progress expected an option.");
+        SayRunLike(argv);
+        exit(1);
+      }
+      opt = ArgArray[opt_it++];
+      LastArgOkay = Handle_Progress(opt);
+      continue;
+    }
+    if (("-CP" == arg) || ("--compact-p4" == arg)) {
+      LastArgOkay = Handle_CompactP4(opt);
+      continue;
+    }
+    if ("--derived-kinematics" == arg) {
+      LastArgOkay = Handle_DerivedKinematics(opt);
+      continue;
+    }
+    if (("-Z" == arg) || ("--compression" == arg)) {
+      if (opt_it == ArgArray.size()) {
+        UDBError("Parameter -Z expected an option.");
+        SayRunLike(argv);
+        exit(1);
+      }
+      opt = ArgArray[opt_it++];
+      LastArgOkay = Handle_Compression(opt);
+      continue;
+    }
+    if ("--basket-size" == arg) {
+      if (opt_it == ArgArray.size()) {
+        UDBError("Parameter --basket-size expected an option.");
+        SayRunLike(argv);
+        exit(1);
+      }
+      opt = ArgArray[opt_it++];
+      LastArgOkay = Handle_BasketSize(opt);
+      continue;
+    }
+    if ("--auto-flush" == arg) {
+      if (opt_it == ArgArray.size()) {
+        UDBError("Parameter --auto-flush expected an option.");
+        SayRunLike(argv);
+        exit(1);
+      }
+      opt = ArgArray[opt_it++];
+      LastArgOkay = Handle_AutoFlush(opt);
+      continue;
+    }
+    if ("--auto-save" == arg) {
+      if (opt_it == ArgArray.size()) {
+        UDBError("Parameter --auto-save expected an option.");
+        SayRunLike(argv);
+        exit(1);
+      }
+      opt = ArgArray[opt_it++];
+      LastArgOkay = Handle_AutoSave(opt);
+      continue;
+    }
+    if ("--output-profile" == arg) {
+      if (opt_it == ArgArray.size()) {
+        UDBError("Parameter --output-profile expected an option.");
+        SayRunLike(argv);
+        exit(1);
+      }
+      opt = ArgArray[opt_it++];
+      LastArgOkay = Handle_OutputProfile(opt);
+      continue;
+    }
+    if ("--append" == arg) {
+      LastArgOkay = Handle_Append(opt);
+      continue;
+    }
+    if ("--reweight" == arg) {
+      LastArgOkay = Handle_Reweight(opt);
+      continue;
+    }
+    if ("--checkpoint" == arg) {
+      if (opt_it == ArgArray.size()) {
+        UDBError("Parameter --checkpoint expected an option.");
+        SayRunLike(argv);
+        exit(1);
+      }
+      opt = ArgArray[opt_it++];
+      LastArgOkay = Handle_Checkpoint(opt);
+      continue;
+    }
+    if ("--resume" == arg) {
+      LastArgOkay = Handle_Resume(opt);
+      continue;
+    }
+    if ("--shard" == arg) {
+      if (opt_it == ArgArray.size()) {
+        UDBError("Parameter --shard expected an option.");
+        SayRunLike(argv);
+        exit(1);
+      }
+      opt = ArgArray[opt_it++];
+      LastArgOkay = Handle_Shard(opt);
+      continue;
+    }
     if (("-F" == arg) || ("--Save-Flux-File" == arg)) {
       if (opt_it == ArgArray.size()) {
         UDBError("Parameter -F expected an option.");
@@ -673,6 +1174,47 @@ void SayRunLike(char const *argv[]) {
       << "\n\t[Arg]: (-NP|--No-Prod-Charge)"
       << "\n\t[Arg]: (-F|--Save-Flux-File) "
          "[output_hist_name,input_text_flux_file.txt]"
+      << "\n\t[Arg]: (-M|--mmap-input) Read FinalEvents.dat files through "
+         "a memory mapping."
+      << "\n\t[Arg]: (--no-index) Don't read or write FinalEvents.dat "
+         "index files."
+      << "\n\t[Arg]: (--event-cache) <Directory> Read, and write on first "
+         "read, binary caches of parsed FinalEvents.dat files."
+      << "\n\t[Arg]: (-P|--parse-threads) <N {default:1}> Parse each "
+         "FinalEvents.dat file on N threads (implies -M)."
+      << "\n\t[Arg]: (-j|--output-threads) <N> Compress output baskets "
+         "with a ROOT implicit multi-threading pool of N threads."
+      << "\n\t[Arg]: (--max-warnings) <N {default:5}> Print at most N "
+         "of each kind of recurring warning, -1 prints all."
+      << "\n\t[Arg]: (--timing) Print the time spent in each conversion "
+         "stage and the throughput."
+      << "\n\t[Arg]: (--timing-json) <File Name> As --timing, and also "
+         "write the report as JSON."
+      << "\n\t[Arg]: (--progress) <Seconds {default:30}> Interval between "
+         "progress reports, 0 disables them."
+      << "\n\t[Arg]: (-CP|--compact-p4) Write StdHepPx/Py/Pz/E[StdHepN] "
+         "branches instead of StdHepP4."
+      << "\n\t[Arg]: (--derived-kinematics) Also write Enu, Q2, q0, q3, W, "
+         "CosThetaLep and PhiLep branches."
+      << "\n\t[Arg]: (--output-profile) <default|scratch|archive> Output "
+         "compression and basket size preset."
+      << "\n\t[Arg]: (-Z|--compression) <none|zlib|lzma|lz4|zstd>[:level] or "
+         "<ROOT compression setting, e.g. 404>"
+      << "\n\t[Arg]: (--basket-size) <bytes {default:ROOT default}>"
+      << "\n\t[Arg]: (--auto-flush) <entries, or -bytes {default:ROOT "
+         "default}>"
+      << "\n\t[Arg]: (--auto-save) <entries, or -bytes {default:ROOT "
+         "default}>"
+      << "\n\t[Arg]: (--append) Add input files that are not yet in the "
+         "output file to it."
+      << "\n\t[Arg]: (--reweight) Only recompute the weights of the events "
+         "already in the output file."
+      << "\n\t[Arg]: (--checkpoint) <Seconds {default:0}> Interval between "
+         "checkpoints that a killed conversion can be resumed from."
+      << "\n\t[Arg]: (--resume) Continue from the output file's last "
+         "checkpoint."
+      << "\n\t[Arg]: (--shard) <i/N> Only convert the i-th (from 0) of N "
+         "equal shares of the input files, for GiBUUStdHepMerge."
       << std::endl;
 }
 } // namespace GiBUUToStdHep_CLIOpts
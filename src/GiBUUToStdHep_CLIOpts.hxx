@@ -1,6 +1,7 @@
 #ifndef GiBUUToStdHepCLIOpts_HXX_SEEN
 #define GiBUUToStdHepCLIOpts_HXX_SEEN
 
+#include <cstddef>
 #include <string>
 #include <vector>
 #include <map>
@@ -76,6 +77,166 @@ extern std::vector<std::pair<std::string, std::string> > FluxFilesToAdd;
 
 ///\brief Whether to exit on suspicious input file contents.
 extern bool StrictMode;
+
+///\brief Whether to read FinalEvents.dat inputs through a read-only memory
+/// mapping rather than std::ifstream.
+///
+///\note Set by
+///  `GiBUUToStdHep.exe ... -M ...'
+extern bool UseMMapInput;
+
+///\brief Whether to read, and write on first read, a sidecar index of each
+/// FinalEvents.dat input file.
+///
+///\note Unset by
+///  `GiBUUToStdHep.exe ... --no-index ...'
+extern bool UseInputIndex;
+
+///\brief The directory to read, and write on first read, binary caches of
+/// parsed FinalEvents.dat input files in. Empty disables the cache.
+///
+///\note Set by
+///  `GiBUUToStdHep.exe ... --event-cache xx ...'
+extern std::string EventCacheDir;
+
+///\brief The number of threads to parse each FinalEvents.dat file with.
+///
+/// Values larger than 1 imply UseMMapInput.
+///
+///\note Set by
+///  `GiBUUToStdHep.exe ... -P xx ...'
+extern size_t NParseThreads;
+
+///\brief The size of the ROOT implicit multi-threading pool used to compress
+/// output baskets.
+///
+/// 0 leaves implicit multi-threading disabled.
+///
+///\note Set by
+///  `GiBUUToStdHep.exe ... -j xx ...'
+extern unsigned NIMTThreads;
+
+///\brief The number of warnings of each recurring kind, e.g. malformed lines
+/// or unknown particle codes, to print in full.
+///
+/// Further occurrences are only counted and reported in the summary at the end
+/// of the conversion. -1 prints all of them.
+///
+///\note Set by
+///  `GiBUUToStdHep.exe ... --max-warnings xx ...'
+extern int MaxWarningsPerCategory;
+
+///\brief Whether to time each conversion stage and print a timing and
+/// throughput summary at the end of the conversion.
+///
+///\note Set by
+///  `GiBUUToStdHep.exe ... --timing ...' or `--timing-json xx'
+extern bool ReportTiming;
+
+///\brief The file to also write the timing summary to, as JSON.
+///
+///\note Set by
+///  `GiBUUToStdHep.exe ... --timing-json xx ...'
+extern std::string TimingJSONFile;
+
+///\brief The interval in seconds between progress reports, which give the
+/// fraction of the input read, the throughput and an estimate of the time
+/// remaining. 0 disables them.
+///
+///\note Set by
+///  `GiBUUToStdHep.exe ... --progress xx ...'
+extern double ProgressInterval;
+
+///\brief Whether to write four momenta as StdHepN-sized StdHepPx, StdHepPy,
+/// StdHepPz and StdHepE branches instead of the fixed size StdHepP4 branch.
+///
+///\note Set by
+///  `GiBUUToStdHep.exe ... -CP ...'
+extern bool CompactP4Output;
+
+///\brief Whether to write the Enu, Q2, q0, q3, W, CosThetaLep and PhiLep
+/// branches, computed from the particle stack of each event.
+///
+///\note Set by
+///  `GiBUUToStdHep.exe ... --derived-kinematics ...'
+extern bool DerivedKinematicsOutput;
+
+///\brief The ROOT compression setting (100 * algorithm + level) to write the
+/// output file with.
+///
+/// -1 keeps the ROOT default.
+///
+///\note Set by
+///  `GiBUUToStdHep.exe ... -Z xx ...' or `--output-profile xx'
+extern int OutputCompression;
+
+///\brief The basket size, in bytes, for all output tree branches.
+///
+/// 0 keeps the ROOT default.
+///
+///\note Set by
+///  `GiBUUToStdHep.exe ... --basket-size xx ...' or `--output-profile xx'
+extern int OutputBasketSize;
+
+///\brief Passed to TTree::SetAutoFlush for the output tree, positive values
+/// are a number of entries, negative values a number of bytes.
+///
+/// 0 keeps the ROOT default.
+///
+///\note Set by
+///  `GiBUUToStdHep.exe ... --auto-flush xx ...'
+extern long long OutputAutoFlush;
+
+///\brief Passed to TTree::SetAutoSave for the output tree, positive values
+/// are a number of entries, negative values a number of bytes.
+///
+/// 0 keeps the ROOT default.
+///
+///\note Set by
+///  `GiBUUToStdHep.exe ... --auto-save xx ...'
+extern long long OutputAutoSave;
+
+///\brief Whether to add the events of input files that are not yet in the
+/// output file to it, rather than recreating it.
+///
+///\note Set by
+///  `GiBUUToStdHep.exe ... --append ...'
+extern bool AppendOutput;
+
+///\brief Whether to only recompute the event weights of the output file, and
+/// its flux-weighted histograms, with the current weight options.
+///
+///\note Set by
+///  `GiBUUToStdHep.exe ... --reweight ...'
+extern bool ReweightOutput;
+
+///\brief The interval in seconds between checkpoints of the conversion, from
+/// which it can be resumed if it is killed. 0 disables them.
+///
+///\note Set by
+///  `GiBUUToStdHep.exe ... --checkpoint xx ...'
+extern double CheckpointInterval;
+
+///\brief Whether to continue the conversion into the output file from its
+/// last checkpoint.
+///
+///\note Set by
+///  `GiBUUToStdHep.exe ... --resume ...'
+extern bool ResumeConversion;
+
+///\brief The index, from 0, of the shard of the input files to convert.
+///
+///\note Set by
+///  `GiBUUToStdHep.exe ... --shard i/N ...'
+extern size_t ShardIndex;
+
+///\brief The number of shards that the input files are split into. Each
+/// shard is a contiguous range of the input files in the order that they were
+/// added.
+///
+///\note Set by
+///  `GiBUUToStdHep.exe ... --shard i/N ...'
+extern size_t NShards;
 }
 
 namespace GiBUUToStdHep_CLIOpts {
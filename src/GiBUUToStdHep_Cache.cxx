@@ -0,0 +1,454 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+// Unix
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "LUtils/Debugging.hxx"
+
+#include "GiBUUToStdHep_CLIOpts.hxx"
+#include "GiBUUToStdHep_Cache.hxx"
+#include "GiBUUToStdHep_Input.hxx"
+#include "GiBUUToStdHep_Parsing.hxx"
+
+namespace GiBUUCache {
+
+namespace {
+typedef unsigned long long U64;
+
+struct Header {
+  char Magic[8];
+  unsigned int Version;
+  unsigned int NColumns;
+  U64 LayoutTag;
+  U64 InputSize;
+  U64 NRuns;
+  U64 NEvents;
+  U64 NLines;
+  U64 NBatches;
+};
+
+struct BatchHeader {
+  U64 NEvents;
+  U64 NParticles;
+  U64 NextOffset;
+};
+
+char const kMagic[8] = {'G', '2', 'S', 'C', 'A', 'C', 'H', 'E'};
+
+// Reads differently on a machine with the other byte order, or with other
+// sizes of the integer types that are written as they are held in memory.
+U64 const kLayoutTag = 0x4732534300000000ULL | (U64(sizeof(Long_t)) << 8) |
+                       U64(sizeof(size_t));
+
+size_t ExpectedNColumns() {
+  return GiBUUParsing::kNFinalEventsColumns +
+         size_t(GiBUUToStdHepOpts::HaveProdChargeInfo);
+}
+
+inline size_t Padded(size_t NBytes) { return (NBytes + 7) & ~size_t(7); }
+
+size_t GetBatchBytes(size_t NEvents, size_t NParticles) {
+  return sizeof(BatchHeader) + 4 * Padded(NEvents * sizeof(Int_t)) +
+         2 * Padded(NEvents * sizeof(Double_t)) +
+         Padded((NEvents + 1) * sizeof(size_t)) +
+         3 * Padded(NParticles * sizeof(Int_t)) +
+         Padded(3 * NParticles * sizeof(Double_t)) +
+         Padded(4 * NParticles * sizeof(Double_t)) +
+         Padded(NParticles * sizeof(Long_t)) + Padded(NParticles);
+}
+
+template <typename T>
+void WriteColumn(std::ostream &os, std::vector<T> const &v) {
+  static char const Padding[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  size_t const NBytes = v.size() * sizeof(T);
+  if (NBytes) {
+    os.write(reinterpret_cast<char const *>(&v[0]), NBytes);
+  }
+  os.write(Padding, Padded(NBytes) - NBytes);
+}
+
+template <typename T>
+void ReadColumn(char const *&Cursor, size_t N, std::vector<T> &v) {
+  T const *begin = reinterpret_cast<T const *>(Cursor);
+  v.assign(begin, begin + N);
+  Cursor += Padded(N * sizeof(T));
+}
+
+// XXH64, with a seed of 0, of [begin, begin + N).
+U64 const P1 = 11400714785074694791ULL;
+U64 const P2 = 14029467366897019727ULL;
+U64 const P3 = 1609587929392839161ULL;
+U64 const P4 = 9650029242287828579ULL;
+U64 const P5 = 2870177450012600261ULL;
+
+inline U64 RotL(U64 x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline U64 Read64(char const *p) {
+  U64 v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline U64 Round(U64 acc, U64 input) {
+  acc += input * P2;
+  return RotL(acc, 31) * P1;
+}
+
+inline U64 MergeRound(U64 acc, U64 val) {
+  acc ^= Round(0, val);
+  return acc * P1 + P4;
+}
+
+U64 HashBytes(char const *begin, size_t N) {
+  char const *p = begin;
+  char const *const end = begin + N;
+  U64 h;
+  if (N >= 32) {
+    U64 v1 = P1 + P2, v2 = P2, v3 = 0, v4 = U64(0) - P1;
+    char const *const limit = end - 32;
+    do {
+      v1 = Round(v1, Read64(p));
+      v2 = Round(v2, Read64(p + 8));
+      v3 = Round(v3, Read64(p + 16));
+      v4 = Round(v4, Read64(p + 24));
+      p += 32;
+    } while (p <= limit);
+    h = RotL(v1, 1) + RotL(v2, 7) + RotL(v3, 12) + RotL(v4, 18);
+    h = MergeRound(h, v1);
+    h = MergeRound(h, v2);
+    h = MergeRound(h, v3);
+    h = MergeRound(h, v4);
+  } else {
+    h = P5;
+  }
+  h += U64(N);
+  for (; (p + 8) <= end; p += 8) {
+    h ^= Round(0, Read64(p));
+    h = RotL(h, 27) * P1 + P4;
+  }
+  if ((p + 4) <= end) {
+    unsigned int v;
+    memcpy(&v, p, sizeof(v));
+    h ^= U64(v) * P1;
+    h = RotL(h, 23) * P2 + P3;
+    p += 4;
+  }
+  for (; p < end; ++p) {
+    h ^= U64(static_cast<unsigned char>(*p)) * P5;
+    h = RotL(h, 11) * P1;
+  }
+  h ^= h >> 33;
+  h *= P2;
+  h ^= h >> 29;
+  h *= P3;
+  h ^= h >> 32;
+  return h;
+}
+
+bool HashFile(std::string const &FileName, U64 &Hash) {
+  int fd = open(FileName.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat sb;
+  if (fstat(fd, &sb) == -1) {
+    close(fd);
+    return false;
+  }
+  size_t const Size = size_t(sb.st_size);
+  if (!Size) {
+    close(fd);
+    Hash = HashBytes("", 0);
+    return true;
+  }
+  void *map = mmap(NULL, Size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  madvise(map, Size, MADV_SEQUENTIAL);
+  Hash = HashBytes(static_cast<char const *>(map), Size);
+  munmap(map, Size);
+  return true;
+}
+} // namespace
+
+std::string GetCacheFileName(std::string const &InputFileName) {
+  U64 Hash = 0;
+  if (!HashFile(InputFileName, Hash)) {
+    UDBWarn("Could not read " << InputFileName
+                              << " to find its event cache.");
+    return "";
+  }
+  std::stringstream ss("");
+  ss << GiBUUToStdHepOpts::EventCacheDir << "/" << std::hex
+     << std::setfill('0') << std::setw(16) << Hash << std::dec << ".c"
+     << ExpectedNColumns() << ".g2scache";
+  return ss.str();
+}
+
+EventCacheReader::EventCacheReader()
+    : fd(-1), Data(NULL), Size(0), Cursor(NULL), InputSize(0), NRuns(0),
+      NEvents(0), NLines(0) {}
+
+void EventCacheReader::Close() {
+  if (Data) {
+    munmap(const_cast<char *>(Data), Size);
+  }
+  if (fd != -1) {
+    close(fd);
+  }
+  fd = -1;
+  Data = Cursor = NULL;
+  Size = 0;
+}
+
+bool EventCacheReader::Open(std::string const &CacheFileName) {
+  Close();
+  fd = open(CacheFileName.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return false;
+  }
+
+  struct stat sb;
+  if ((fstat(fd, &sb) == -1) || (size_t(sb.st_size) < sizeof(Header))) {
+    UDBWarn("Ignoring unreadable event cache: " << CacheFileName);
+    Close();
+    return false;
+  }
+  Size = size_t(sb.st_size);
+  void *map = mmap(NULL, Size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED) {
+    UDBWarn("Failed to mmap event cache " << CacheFileName << ": "
+                                          << strerror(errno));
+    Size = 0;
+    Close();
+    return false;
+  }
+  madvise(map, Size, MADV_SEQUENTIAL);
+  Data = static_cast<char const *>(map);
+
+  Header h;
+  memcpy(&h, Data, sizeof(h));
+  if (memcmp(h.Magic, kMagic, sizeof(kMagic)) || (h.Version != kVersion) ||
+      (h.LayoutTag != kLayoutTag)) {
+    UDBWarn("Ignoring unreadable event cache: " << CacheFileName);
+    Close();
+    return false;
+  }
+  // Only reachable through a hash collision, or a renamed cache.
+  if (h.NColumns != ExpectedNColumns()) {
+    UDBWarn("Ignoring event cache " << CacheFileName << " of a file with "
+                                    << h.NColumns << " columns.");
+    Close();
+    return false;
+  }
+
+  // Check the batch structure up front, as batches are passed on as they are
+  // read and a bad cache cannot be fallen back from part way through.
+  char const *b_it = Data + sizeof(Header);
+  U64 NEventsSeen = 0;
+  for (U64 b = 0; b < h.NBatches; ++b) {
+    BatchHeader bh;
+    if (size_t((Data + Size) - b_it) < sizeof(BatchHeader)) {
+      b_it = NULL;
+      break;
+    }
+    memcpy(&bh, b_it, sizeof(bh));
+    size_t const NBytes = GetBatchBytes(bh.NEvents, bh.NParticles);
+    if (size_t((Data + Size) - b_it) < NBytes) {
+      b_it = NULL;
+      break;
+    }
+    NEventsSeen += bh.NEvents;
+    b_it += NBytes;
+  }
+  if ((b_it != (Data + Size)) || (NEventsSeen != h.NEvents)) {
+    UDBWarn("Ignoring truncated event cache: " << CacheFileName);
+    Close();
+    return false;
+  }
+
+  InputSize = h.InputSize;
+  NRuns = h.NRuns;
+  NEvents = h.NEvents;
+  NLines = h.NLines;
+  Cursor = Data + sizeof(Header);
+  return true;
+}
+
+bool EventCacheReader::SkipToOffset(unsigned long long Offset) {
+  char const *b_it = Data + sizeof(Header);
+  while (b_it != (Data + Size)) {
+    BatchHeader bh;
+    memcpy(&bh, b_it, sizeof(bh));
+    b_it += GetBatchBytes(bh.NEvents, bh.NParticles);
+    if (bh.NextOffset == Offset) {
+      Cursor = b_it;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool EventCacheReader::NextBatch(GiBUUEventBatch &Events,
+                                 unsigned long long &NextOffset) {
+  if (!Data || AtEnd()) {
+    return false;
+  }
+  BatchHeader bh;
+  memcpy(&bh, Cursor, sizeof(bh));
+  Cursor += sizeof(BatchHeader);
+  size_t const NE = bh.NEvents;
+  size_t const NP = bh.NParticles;
+
+  ReadColumn(Cursor, NE, Events.Run);
+  ReadColumn(Cursor, NE, Events.EvNum);
+  ReadColumn(Cursor, NE, Events.PerWeight);
+  ReadColumn(Cursor, NE, Events.Prodid);
+  ReadColumn(Cursor, NE, Events.EProbe);
+  ReadColumn(Cursor, NE, Events.ProdCharge);
+  ReadColumn(Cursor, NE + 1, Events.EventOffsets);
+  ReadColumn(Cursor, NP, Events.ID);
+  ReadColumn(Cursor, NP, Events.Charge);
+  ReadColumn(Cursor, 3 * NP, Events.Position);
+  ReadColumn(Cursor, 4 * NP, Events.FourMom);
+  ReadColumn(Cursor, NP, Events.History);
+  ReadColumn(Cursor, NP, Events.ln);
+  ReadColumn(Cursor, NP, Events.IDIsPDG);
+
+  NextOffset = bh.NextOffset;
+  return true;
+}
+
+unsigned long long EventCacheReader::GetInputBytesRead() const {
+  if (!Size) {
+    return 0;
+  }
+  return (unsigned long long)(double(InputSize) * double(Cursor - Data) /
+                              double(Size));
+}
+
+EventCacheReader::~EventCacheReader() { Close(); }
+
+EventCacheWriter::EventCacheWriter()
+    : CacheFileName(""), TmpFileName(""), ofs(), InputSize(0), NEvents(0),
+      NBatches(0) {}
+
+void EventCacheWriter::Abandon() {
+  if (!IsOpen()) {
+    return;
+  }
+  ofs.close();
+  std::remove(TmpFileName.c_str());
+  TmpFileName.clear();
+}
+
+bool EventCacheWriter::Open(std::string const &CacheFileName_,
+                            std::string const &InputFileName) {
+  Abandon();
+  CacheFileName = CacheFileName_;
+  InputSize = GetInputFileSize(InputFileName);
+  NEvents = 0;
+  NBatches = 0;
+
+  if ((mkdir(GiBUUToStdHepOpts::EventCacheDir.c_str(), 0777) == -1) &&
+      (errno != EEXIST)) {
+    UDBWarn("Could not create event cache directory "
+            << GiBUUToStdHepOpts::EventCacheDir << ": " << strerror(errno)
+            << ", continuing without a cache.");
+    return false;
+  }
+
+  std::stringstream TmpName("");
+  TmpName << CacheFileName << ".tmp." << getpid();
+  TmpFileName = TmpName.str();
+  ofs.open(TmpFileName.c_str(), std::ios::binary | std::ios::trunc);
+  if (!ofs.good()) {
+    UDBWarn("Could not write event cache "
+            << CacheFileName << ", continuing without it.");
+    TmpFileName.clear();
+    return false;
+  }
+  // Filled in by Finish.
+  Header h;
+  memset(&h, 0, sizeof(h));
+  ofs.write(reinterpret_cast<char const *>(&h), sizeof(h));
+  return true;
+}
+
+void EventCacheWriter::AddBatch(GiBUUEventBatch const &Events,
+                                unsigned long long NextOffset) {
+  if (!IsOpen() || Events.Empty()) {
+    return;
+  }
+  BatchHeader bh;
+  bh.NEvents = Events.GetNEvents();
+  bh.NParticles = Events.GetNParticles();
+  bh.NextOffset = NextOffset;
+  ofs.write(reinterpret_cast<char const *>(&bh), sizeof(bh));
+
+  WriteColumn(ofs, Events.Run);
+  WriteColumn(ofs, Events.EvNum);
+  WriteColumn(ofs, Events.PerWeight);
+  WriteColumn(ofs, Events.Prodid);
+  WriteColumn(ofs, Events.EProbe);
+  WriteColumn(ofs, Events.ProdCharge);
+  WriteColumn(ofs, Events.EventOffsets);
+  WriteColumn(ofs, Events.ID);
+  WriteColumn(ofs, Events.Charge);
+  WriteColumn(ofs, Events.Position);
+  WriteColumn(ofs, Events.FourMom);
+  WriteColumn(ofs, Events.History);
+  WriteColumn(ofs, Events.ln);
+  WriteColumn(ofs, Events.IDIsPDG);
+
+  if (!ofs.good()) {
+    UDBWarn("Could not write event cache "
+            << CacheFileName << ", continuing without it.");
+    Abandon();
+    return;
+  }
+  NEvents += bh.NEvents;
+  NBatches++;
+}
+
+void EventCacheWriter::Finish(size_t NRuns, size_t NLines) {
+  if (!IsOpen()) {
+    return;
+  }
+  Header h;
+  memcpy(h.Magic, kMagic, sizeof(kMagic));
+  h.Version = kVersion;
+  h.NColumns = (unsigned int)(ExpectedNColumns());
+  h.LayoutTag = kLayoutTag;
+  h.InputSize = InputSize;
+  h.NRuns = NRuns;
+  h.NEvents = NEvents;
+  h.NLines = NLines;
+  h.NBatches = NBatches;
+  ofs.seekp(0);
+  ofs.write(reinterpret_cast<char const *>(&h), sizeof(h));
+  ofs.close();
+  if (ofs.fail() || std::rename(TmpFileName.c_str(), CacheFileName.c_str())) {
+    std::remove(TmpFileName.c_str());
+    TmpFileName.clear();
+    UDBWarn("Could not write event cache "
+            << CacheFileName << ", continuing without it.");
+    return;
+  }
+  TmpFileName.clear();
+  UDBLog("Wrote event cache " << CacheFileName << ": " << NEvents
+                              << " events.");
+}
+
+EventCacheWriter::~EventCacheWriter() { Abandon(); }
+
+} // namespace GiBUUCache
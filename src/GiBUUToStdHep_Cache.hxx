@@ -0,0 +1,150 @@
+#ifndef SEEN_GIBUUToStdHep_CACHE_HXX
+#define SEEN_GIBUUToStdHep_CACHE_HXX
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+
+#include "GiBUUToStdHep_Utils.hxx"
+
+///\brief Binary caches of parsed FinalEvents.dat files.
+///
+/// Parsing the text of a FinalEvents.dat file is the dominant cost of a
+/// conversion, but its result does not depend on the per-file options, flux
+/// files or output options, so a file that is converted repeatedly need only be
+/// parsed once. The first conversion writes the parsed events, as the columns
+/// of the GiBUUEventBatch that were passed to the conversion stage, to a cache
+/// file in GiBUUToStdHepOpts::EventCacheDir, and later conversions map the
+/// cache and copy the columns straight into their event batches.
+///
+/// Caches are named for a hash of the contents of the input file, and for the
+/// particle line column layout that it was parsed with, so a renamed or copied
+/// input file still finds its cache, and an edited one does not. The hash is
+/// of the file as it is on disk, so a compressed input file is not
+/// decompressed to find its cache.
+///
+/// A cache is laid out so that every column starts 8-byte aligned in the
+/// mapping:
+///
+///     header: magic "G2SCACHE", version, columns, layout tag, input file
+///             size, runs, events, lines, batches
+///     batch:  events, particles, byte offset in the input file of the next
+///             event, then each column of GiBUUEventBatch in declaration
+///             order, padded to a multiple of 8 bytes
+///     ...
+///
+/// Values are written in the byte order and type sizes of the machine that
+/// wrote them, which the layout tag records, and caches written on a
+/// different kind of machine are ignored.
+namespace GiBUUCache {
+
+int const kVersion = 1;
+
+///\brief Gets the name of the cache file for InputFileName, which requires
+/// reading the whole input file to hash it.
+///
+/// Returns an empty string, after warning, if the input file cannot be read.
+std::string GetCacheFileName(std::string const &InputFileName);
+
+///\brief Reads the event batches of a cache file, in the order that they were
+/// written.
+class EventCacheReader {
+  int fd;
+  char const *Data;
+  size_t Size;
+  char const *Cursor;
+
+  unsigned long long InputSize;
+  size_t NRuns;
+  size_t NEvents;
+  size_t NLines;
+
+  EventCacheReader(EventCacheReader const &);
+  EventCacheReader &operator=(EventCacheReader const &);
+
+  void Close();
+
+ public:
+  EventCacheReader();
+
+  ///\brief Maps CacheFileName and checks that it is a complete cache of a
+  /// file with the expected column layout.
+  ///
+  /// Returns false if there is no such cache. A cache that exists but cannot
+  /// be used is warned about.
+  bool Open(std::string const &CacheFileName);
+
+  ///\brief Skips the batches that end before Offset, which must be the
+  /// NextOffset of one of the batches in the cache.
+  ///
+  /// Returns false if it is not, in which case the input file must be parsed
+  /// instead.
+  bool SkipToOffset(unsigned long long Offset);
+
+  ///\brief Replaces the contents of Events with the next batch in the cache,
+  /// and sets NextOffset to the byte offset in the input file of the first
+  /// event after it.
+  ///
+  /// Returns false at the end of the cache.
+  bool NextBatch(GiBUUEventBatch &Events, unsigned long long &NextOffset);
+
+  ///\brief Whether NextBatch has returned the last batch in the cache.
+  bool AtEnd() const { return Cursor == (Data + Size); }
+
+  size_t GetNRuns() const { return NRuns; }
+  size_t GetNEvents() const { return NEvents; }
+  size_t GetNLines() const { return NLines; }
+
+  ///\brief The number of bytes of the input file that the batches read so far
+  /// were parsed from, as estimated from the fraction of the cache read.
+  unsigned long long GetInputBytesRead() const;
+
+  ~EventCacheReader();
+};
+
+///\brief Writes the event batches of an input file to a cache file as they
+/// are parsed.
+///
+/// The cache is written to a temporary file which is only renamed to the
+/// cache file name by Finish, so that a conversion that stops early, or a
+/// concurrent conversion, never reads a partial cache.
+class EventCacheWriter {
+  std::string CacheFileName;
+  std::string TmpFileName;
+  std::ofstream ofs;
+  unsigned long long InputSize;
+  size_t NEvents;
+  size_t NBatches;
+
+  EventCacheWriter(EventCacheWriter const &);
+  EventCacheWriter &operator=(EventCacheWriter const &);
+
+ public:
+  EventCacheWriter();
+
+  ///\brief Starts writing the cache of InputFileName to CacheFileName.
+  ///
+  /// Returns false, after warning, if the cache cannot be written, e.g. in a
+  /// read-only directory.
+  bool Open(std::string const &CacheFileName,
+            std::string const &InputFileName);
+
+  bool IsOpen() const { return !TmpFileName.empty(); }
+
+  ///\brief Appends a batch, after which the next event starts NextOffset bytes
+  /// into the input file. Does nothing if the writer is not open.
+  void AddBatch(GiBUUEventBatch const &Events, unsigned long long NextOffset);
+
+  ///\brief Completes the cache of a whole input file.
+  void Finish(size_t NRuns, size_t NLines);
+
+  ///\brief Discards the cache of an input file that was not read in full.
+  void Abandon();
+
+  ///\brief Removes the temporary file of an unfinished cache.
+  ~EventCacheWriter();
+};
+
+} // namespace GiBUUCache
+
+#endif
@@ -0,0 +1,265 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+// Unix
+#include <unistd.h>
+
+#include "TArrayD.h"
+
+#include "LUtils/Debugging.hxx"
+
+#include "GiBUUToStdHep_CLIOpts.hxx"
+#include "GiBUUToStdHep_Checkpoint.hxx"
+
+namespace GiBUUCheckpoint {
+
+namespace {
+typedef std::chrono::steady_clock Clock;
+Clock::time_point LastCommit;
+
+// TH1::GetStats fills at most this many values.
+size_t const kMaxStats = 13;
+
+bool ExpectWord(std::istream &is, char const *word) {
+  std::string w;
+  return (is >> w) && (w == word);
+}
+
+void WriteValues(std::ostream &os, std::vector<double> const &v) {
+  os << " " << v.size();
+  for (size_t v_it = 0; v_it < v.size(); ++v_it) {
+    os << " " << v[v_it];
+  }
+}
+
+bool ReadValues(std::istream &is, std::vector<double> &v) {
+  size_t N = 0;
+  if (!(is >> N)) {
+    return false;
+  }
+  v.resize(N);
+  for (size_t v_it = 0; v_it < N; ++v_it) {
+    if (!(is >> v[v_it])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Reads the rest of the line, without the separating space, into str.
+bool ReadName(std::istream &is, std::string &str) {
+  if (is.get() != ' ') {
+    return false;
+  }
+  return bool(std::getline(is, str));
+}
+
+bool Write(State const &s) {
+  std::string const FileName =
+      GetCheckpointFileName(GiBUUToStdHepOpts::OutFName);
+  std::stringstream TmpName("");
+  TmpName << FileName << ".tmp." << getpid();
+  {
+    std::ofstream ofs(TmpName.str().c_str());
+    if (!ofs.good()) {
+      UDBWarn("Could not write checkpoint " << FileName << ".");
+      return false;
+    }
+    ofs << std::setprecision(std::numeric_limits<double>::max_digits10)
+        << "GiBUUToStdHepCheckpoint " << kVersion << "\ncomplete "
+        << int(s.Complete) << "\nentries " << s.NEntries << "\nresume "
+        << s.InputFile << " " << s.FileNumber << " " << s.Offset
+        << "\ninputs " << s.InputFiles.size() << "\n";
+    for (size_t f_it = 0; f_it < s.InputFiles.size(); ++f_it) {
+      ofs << s.InputFiles[f_it] << "\n";
+    }
+    ofs << "records " << s.Records.size() << "\n";
+    for (size_t r_it = 0; r_it < s.Records.size(); ++r_it) {
+      InputFileRecord const &rec = s.Records[r_it];
+      ofs << rec.NRuns << " " << rec.FirstEntry << " " << rec.NEntries << " "
+          << rec.NFilesAddedWeight << " " << rec.TreeNumRunsWeight << " "
+          << rec.FileExtraWeight << " " << rec.ProbePDG << " " << rec.TargetA
+          << " " << rec.TargetZ << " " << rec.IsCC << " " << rec.SumPerWeight
+          << " " << rec.FileName << "\n";
+    }
+    ofs << "hists " << s.Hists.size() << "\n";
+    for (size_t h_it = 0; h_it < s.Hists.size(); ++h_it) {
+      HistState const &h = s.Hists[h_it];
+      ofs << h.Name << " " << h.Entries;
+      WriteValues(ofs, h.Stats);
+      WriteValues(ofs, h.Contents);
+      WriteValues(ofs, h.Sumw2);
+      ofs << "\n";
+    }
+    if (!ofs.good()) {
+      ofs.close();
+      std::remove(TmpName.str().c_str());
+      UDBWarn("Could not write checkpoint " << FileName << ".");
+      return false;
+    }
+  }
+  if (std::rename(TmpName.str().c_str(), FileName.c_str())) {
+    std::remove(TmpName.str().c_str());
+    UDBWarn("Could not write checkpoint " << FileName << ".");
+    return false;
+  }
+  return true;
+}
+} // namespace
+
+std::string GetCheckpointFileName(std::string const &OutputFileName) {
+  return OutputFileName + ".g2sckpt";
+}
+
+bool Enabled() { return GiBUUToStdHepOpts::CheckpointInterval > 0; }
+
+void Start(bool Resuming) {
+  LastCommit = Clock::now();
+  if (!Resuming) {
+    std::remove(GetCheckpointFileName(GiBUUToStdHepOpts::OutFName).c_str());
+  }
+}
+
+bool Due() {
+  return Enabled() &&
+         (std::chrono::duration<double>(Clock::now() - LastCommit).count() >=
+          GiBUUToStdHepOpts::CheckpointInterval);
+}
+
+void SaveHist(TH1 *h, HistState &s) {
+  s.Name = h->GetName();
+  s.Entries = h->GetEntries();
+  s.Stats.resize(kMaxStats);
+  h->GetStats(&s.Stats[0]);
+  // Only the sums of weights are used for one dimensional histograms.
+  s.Stats.resize(4);
+  s.Contents.resize(size_t(h->GetNcells()));
+  for (size_t b_it = 0; b_it < s.Contents.size(); ++b_it) {
+    s.Contents[b_it] = h->GetBinContent(Int_t(b_it));
+  }
+  s.Sumw2.resize(size_t(h->GetSumw2N()));
+  for (size_t b_it = 0; b_it < s.Sumw2.size(); ++b_it) {
+    s.Sumw2[b_it] = (*h->GetSumw2())[Int_t(b_it)];
+  }
+}
+
+void RestoreHist(TH1 *h, HistState const &s) {
+  if (s.Contents.size() != size_t(h->GetNcells())) {
+    UDBError("Checkpointed histogram " << s.Name << " had "
+                                       << s.Contents.size()
+                                       << " bins, but it now has "
+                                       << h->GetNcells() << ".");
+    throw std::runtime_error("Mismatched checkpoint histogram.");
+  }
+  for (size_t b_it = 0; b_it < s.Contents.size(); ++b_it) {
+    h->SetBinContent(Int_t(b_it), s.Contents[b_it]);
+  }
+  if (s.Sumw2.size()) {
+    if (!h->GetSumw2N()) {
+      h->Sumw2();
+    }
+    for (size_t b_it = 0; b_it < s.Sumw2.size(); ++b_it) {
+      (*h->GetSumw2())[Int_t(b_it)] = s.Sumw2[b_it];
+    }
+  }
+  std::vector<double> Stats(s.Stats);
+  Stats.resize(kMaxStats, 0);
+  h->PutStats(&Stats[0]);
+  h->SetEntries(s.Entries);
+}
+
+bool Commit(TTree *OutputTree, State &s) {
+  // Flushes the baskets and writes the tree header and file directory, so
+  // that every entry counted below can be read back after a crash.
+  OutputTree->AutoSave("SaveSelf");
+  s.NEntries = OutputTree->GetEntries();
+  LastCommit = Clock::now();
+  if (!Write(s)) {
+    return false;
+  }
+  UDBLog("Checkpoint: " << s.NEntries << " entries written, next input file "
+                        << (s.InputFile + 1) << "/" << s.InputFiles.size()
+                        << " from byte " << s.Offset << ".");
+  return true;
+}
+
+void MarkComplete() {
+  State s;
+  s.Complete = true;
+  s.InputFiles = GiBUUToStdHepOpts::InpFNames;
+  s.InputFile = s.InputFiles.size();
+  Write(s);
+}
+
+bool Read(State &s) {
+  std::string const FileName =
+      GetCheckpointFileName(GiBUUToStdHepOpts::OutFName);
+  std::ifstream ifs(FileName.c_str());
+  if (!ifs.good()) {
+    return false;
+  }
+
+  s = State();
+  int Version = 0;
+  int Complete = 0;
+  size_t NInputs = 0;
+  if (!ExpectWord(ifs, "GiBUUToStdHepCheckpoint") || !(ifs >> Version) ||
+      (Version != kVersion) || !ExpectWord(ifs, "complete") ||
+      !(ifs >> Complete) || !ExpectWord(ifs, "entries") ||
+      !(ifs >> s.NEntries) || !ExpectWord(ifs, "resume") ||
+      !(ifs >> s.InputFile >> s.FileNumber >> s.Offset) ||
+      !ExpectWord(ifs, "inputs") || !(ifs >> NInputs) ||
+      (ifs.get() != '\n')) {
+    UDBWarn("Ignoring unreadable checkpoint: " << FileName);
+    return false;
+  }
+  s.Complete = Complete;
+  s.InputFiles.resize(NInputs);
+  for (size_t f_it = 0; f_it < NInputs; ++f_it) {
+    if (!std::getline(ifs, s.InputFiles[f_it])) {
+      UDBWarn("Ignoring unreadable checkpoint: " << FileName);
+      return false;
+    }
+  }
+
+  size_t NRecords = 0;
+  if (!ExpectWord(ifs, "records") || !(ifs >> NRecords)) {
+    UDBWarn("Ignoring unreadable checkpoint: " << FileName);
+    return false;
+  }
+  s.Records.resize(NRecords);
+  for (size_t r_it = 0; r_it < NRecords; ++r_it) {
+    InputFileRecord &rec = s.Records[r_it];
+    if (!(ifs >> rec.NRuns >> rec.FirstEntry >> rec.NEntries >>
+          rec.NFilesAddedWeight >> rec.TreeNumRunsWeight >>
+          rec.FileExtraWeight >> rec.ProbePDG >> rec.TargetA >>
+          rec.TargetZ >> rec.IsCC >> rec.SumPerWeight) ||
+        !ReadName(ifs, rec.FileName)) {
+      UDBWarn("Ignoring unreadable checkpoint: " << FileName);
+      return false;
+    }
+  }
+
+  size_t NHists = 0;
+  if (!ExpectWord(ifs, "hists") || !(ifs >> NHists)) {
+    UDBWarn("Ignoring unreadable checkpoint: " << FileName);
+    return false;
+  }
+  s.Hists.resize(NHists);
+  for (size_t h_it = 0; h_it < NHists; ++h_it) {
+    HistState &h = s.Hists[h_it];
+    if (!(ifs >> h.Name >> h.Entries) || !ReadValues(ifs, h.Stats) ||
+        !ReadValues(ifs, h.Contents) || !ReadValues(ifs, h.Sumw2)) {
+      UDBWarn("Ignoring unreadable checkpoint: " << FileName);
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace GiBUUCheckpoint
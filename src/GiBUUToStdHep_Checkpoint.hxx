@@ -0,0 +1,119 @@
+#ifndef SEEN_GIBUUToStdHep_CHECKPOINT_HXX
+#define SEEN_GIBUUToStdHep_CHECKPOINT_HXX
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "TH1.h"
+#include "TTree.h"
+
+#include "GiBUUToStdHep_Output.hxx"
+
+///\brief Checkpoints of long conversions, from which a killed conversion can
+/// be resumed.
+///
+/// A checkpoint is only taken by the writing stage, immediately after the
+/// output tree has been autosaved, and records everything that is needed to
+/// continue from the last entry that the autosave holds: the input file and
+/// byte offset of the next event to parse, the records of the input files
+/// converted so far, and the contents of the flux-weighted histograms, which
+/// are only written at the end of the conversion. It is written next to the
+/// output file, as GetCheckpointFileName(OutFName).
+///
+/// The checkpoint is a text file:
+///
+///     GiBUUToStdHepCheckpoint <version>
+///     complete <0|1>
+///     entries <N>
+///     resume <input file index> <file options index> <byte offset>
+///     inputs <N>
+///     <input file name>
+///     ...
+///     records <N>
+///     <NRuns> <FirstEntry> <NEntries> <NFilesAddedWeight> ... <file name>
+///     ...
+///     hists <N>
+///     <name> <entries> <N stats> <stats...> <N bins> <contents...>
+///       <N sumw2> <sumw2...>
+///     ...
+///
+/// Floating point values are written with enough digits to be read back
+/// exactly.
+namespace GiBUUCheckpoint {
+
+int const kVersion = 2;
+
+///\brief The state of a histogram that is filled during the conversion.
+struct HistState {
+  std::string Name;
+  double Entries;
+  std::vector<double> Stats;
+  std::vector<double> Contents;
+  std::vector<double> Sumw2;
+};
+
+struct State {
+  State()
+      : Complete(false), NEntries(0), InputFile(0), FileNumber(0), Offset(0),
+        InputFiles(), Records(), Hists() {}
+
+  ///\brief Whether the conversion finished.
+  bool Complete;
+  ///\brief The number of entries in the autosaved output tree.
+  Long64_t NEntries;
+  ///\brief The index in GiBUUToStdHepOpts::InpFNames of the input file to
+  /// continue from.
+  size_t InputFile;
+  ///\brief The index of the per-file options to continue with, which only
+  /// counts the input files that contained events.
+  size_t FileNumber;
+  ///\brief The byte offset in the uncompressed contents of InputFile of the
+  /// first event to parse. If non-zero, earlier events of InputFile have been
+  /// written and Records.back() is its record.
+  unsigned long long Offset;
+  ///\brief The input files being converted, which a resumed conversion must
+  /// be given again.
+  std::vector<std::string> InputFiles;
+  std::vector<InputFileRecord> Records;
+  std::vector<HistState> Hists;
+};
+
+///\brief Gets the name of the checkpoint file for OutputFileName.
+std::string GetCheckpointFileName(std::string const &OutputFileName);
+
+///\brief Whether checkpoints are being taken.
+bool Enabled();
+
+///\brief Starts the checkpoint interval, and removes any checkpoint left by
+/// an earlier conversion into the output file unless it is being resumed.
+void Start(bool Resuming);
+
+///\brief Whether the checkpoint interval has passed since the last
+/// checkpoint.
+bool Due();
+
+///\brief Copies the state of h into s.
+void SaveHist(TH1 *h, HistState &s);
+
+///\brief Restores the state of h from s.
+void RestoreHist(TH1 *h, HistState const &s);
+
+///\brief Autosaves OutputTree, and then writes s, with s.NEntries set to the
+/// number of entries in OutputTree, as the checkpoint of the output file.
+///
+/// Returns false, after warning, if the checkpoint could not be written.
+bool Commit(TTree *OutputTree, State &s);
+
+///\brief Marks the checkpoint of the output file as complete, so that a
+/// repeated --resume does not convert anything.
+void MarkComplete();
+
+///\brief Reads the checkpoint of the output file into s.
+///
+/// Returns false if there is none or it cannot be parsed.
+bool Read(State &s);
+
+} // namespace GiBUUCheckpoint
+
+#endif
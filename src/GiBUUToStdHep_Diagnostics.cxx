@@ -0,0 +1,88 @@
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include "LUtils/Debugging.hxx"
+
+#include "GiBUUToStdHep_CLIOpts.hxx"
+#include "GiBUUToStdHep_Diagnostics.hxx"
+
+namespace GiBUUDiagnostics {
+
+namespace {
+char const *const kCategoryNames[kNCategories] = {
+    "Malformed particle line",   "Skipped malformed event",
+    "Zero weight particle",      "Particle with PDG 0",
+    "Too many particles",        "Unknown GiBUU particle code",
+    "Odd resonance charge",      "Unknown PDG code",
+    "Resonance heuristics",      "Unknown reaction code"};
+
+std::atomic<size_t> Counts[kNCategories];
+
+// Only locked when a message is reported.
+std::mutex ReportMutex;
+std::vector<std::string> Exemplars[kNCategories];
+
+// Long exemplars are cut down to their first line in the summary.
+std::string FirstLine(std::string const &Message, size_t MaxLength) {
+  std::string line = Message.substr(0, Message.find('\n'));
+  if (line.size() > MaxLength) {
+    line = line.substr(0, MaxLength - 3) + "...";
+  }
+  return line;
+}
+} // namespace
+
+bool Count(Category Cat) {
+  size_t const N = Counts[Cat].fetch_add(1, std::memory_order_relaxed);
+  int const Max = GiBUUToStdHepOpts::MaxWarningsPerCategory;
+  return (Max < 0) || (N < size_t(Max));
+}
+
+void Report(Category Cat, std::string const &Message) {
+  std::lock_guard<std::mutex> lock(ReportMutex);
+  UDBWarn(Message);
+  Exemplars[Cat].push_back(Message);
+  if (int(Exemplars[Cat].size()) == GiBUUToStdHepOpts::MaxWarningsPerCategory) {
+    UDBWarn("Further \"" << kCategoryNames[Cat]
+                         << "\" warnings will only be counted, see the summary "
+                            "at the end of the conversion (--max-warnings).");
+  }
+}
+
+size_t GetCount(Category Cat) {
+  return Counts[Cat].load(std::memory_order_relaxed);
+}
+
+void PrintSummary() {
+  std::lock_guard<std::mutex> lock(ReportMutex);
+  bool Any = false;
+  for (int c = 0; c < kNCategories; ++c) {
+    Any = Any || GetCount(Category(c));
+  }
+  if (!Any) {
+    return;
+  }
+
+  std::stringstream ss("");
+  ss << "Warning summary:" << std::endl
+     << "\t" << std::left << std::setw(30) << "Category" << std::right
+     << std::setw(12) << "Count" << std::setw(12) << "Printed" << std::endl;
+  for (int c = 0; c < kNCategories; ++c) {
+    size_t const N = GetCount(Category(c));
+    if (!N) {
+      continue;
+    }
+    ss << "\t" << std::left << std::setw(30) << kCategoryNames[c] << std::right
+       << std::setw(12) << N << std::setw(12) << Exemplars[c].size()
+       << std::endl;
+    if (Exemplars[c].size()) {
+      ss << "\t  e.g. " << FirstLine(Exemplars[c].front(), 100) << std::endl;
+    }
+  }
+  UDBLog(ss.str());
+}
+
+} // namespace GiBUUDiagnostics
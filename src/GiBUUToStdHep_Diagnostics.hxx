@@ -0,0 +1,60 @@
+#ifndef SEEN_GIBUUToStdHep_DIAGNOSTICS_HXX
+#define SEEN_GIBUUToStdHep_DIAGNOSTICS_HXX
+
+#include <sstream>
+#include <string>
+
+///\brief Aggregated reporting of warnings that can recur for every event or
+/// particle.
+///
+/// Each occurrence is counted, but only the first
+/// GiBUUToStdHepOpts::MaxWarningsPerCategory of each category are formatted
+/// and printed. A summary of the counts is printed at the end of the
+/// conversion by PrintSummary.
+namespace GiBUUDiagnostics {
+
+enum Category {
+  kMalformedLine = 0,
+  kMalformedEvent,
+  kZeroWeightParticle,
+  kZeroPDGParticle,
+  kTooManyParticles,
+  kUnknownGiBUUCode,
+  kOddGiBUUCharge,
+  kUnknownPDGCode,
+  kResonanceHeuristics,
+  kUnknownReactionCode,
+  kNCategories
+};
+
+///\brief Counts an occurrence of Cat.
+///
+/// Returns true if this occurrence should be reported in full with Report.
+/// Safe to call from any thread.
+bool Count(Category Cat);
+
+///\brief Prints, and keeps for the summary, the message for an occurrence
+/// of Cat that Count returned true for.
+void Report(Category Cat, std::string const &Message);
+
+///\brief Gets the number of occurrences of Cat so far.
+size_t GetCount(Category Cat);
+
+///\brief Prints a table of the number of occurrences of each category of
+/// warning, with the first message reported for each.
+void PrintSummary();
+
+} // namespace GiBUUDiagnostics
+
+///\brief Counts a warning of category Cat, only building and printing the
+/// message for the first few of each category.
+#define GiBUUDiagWarn(Cat, msg)                                                \
+  do {                                                                         \
+    if (GiBUUDiagnostics::Count(Cat)) {                                        \
+      std::stringstream ss_diag("");                                           \
+      ss_diag << msg;                                                          \
+      GiBUUDiagnostics::Report(Cat, ss_diag.str());                            \
+    }                                                                          \
+  } while (0)
+
+#endif
@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+// Unix
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "LUtils/Debugging.hxx"
+
+#include "GiBUUToStdHep_CLIOpts.hxx"
+#include "GiBUUToStdHep_Index.hxx"
+#include "GiBUUToStdHep_Parsing.hxx"
+
+namespace GiBUUIndex {
+
+namespace {
+bool GetFileStamp(std::string const &FileName, unsigned long long &Size,
+                  long long &MTime) {
+  struct stat sb;
+  if (stat(FileName.c_str(), &sb) == -1) {
+    return false;
+  }
+  Size = (unsigned long long)(sb.st_size);
+  MTime = (long long)(sb.st_mtime);
+  return true;
+}
+
+size_t ExpectedNColumns() {
+  return GiBUUParsing::kNFinalEventsColumns +
+         size_t(GiBUUToStdHepOpts::HaveProdChargeInfo);
+}
+
+bool ExpectWord(std::istream &is, char const *word) {
+  std::string w;
+  return (is >> w) && (w == word);
+}
+
+bool BlockBefore(BlockEntry const &b, unsigned long long Offset) {
+  return b.Offset < Offset;
+}
+} // namespace
+
+unsigned long long
+FinalEventsIndex::NextBlockOffset(unsigned long long Offset) const {
+  std::vector<BlockEntry>::const_iterator b_it =
+      std::lower_bound(Blocks.begin(), Blocks.end(), Offset, BlockBefore);
+  return (b_it == Blocks.end()) ? DataSize : b_it->Offset;
+}
+
+std::string GetIndexFileName(std::string const &InputFileName) {
+  return InputFileName + ".g2sidx";
+}
+
+bool ReadIndex(std::string const &InputFileName, FinalEventsIndex &Index) {
+  std::string const IndexFileName = GetIndexFileName(InputFileName);
+  std::ifstream ifs(IndexFileName.c_str());
+  if (!ifs.good()) {
+    return false;
+  }
+
+  unsigned long long Size = 0;
+  long long MTime = 0;
+  if (!GetFileStamp(InputFileName, Size, MTime)) {
+    return false;
+  }
+
+  Index = FinalEventsIndex();
+  int Version = 0;
+  if (!ExpectWord(ifs, "GiBUUToStdHepIndex") || !(ifs >> Version) ||
+      (Version != kVersion) || !ExpectWord(ifs, "size") ||
+      !(ifs >> Index.FileSize) || !ExpectWord(ifs, "mtime") ||
+      !(ifs >> Index.MTime) || !ExpectWord(ifs, "length") ||
+      !(ifs >> Index.DataSize) || !ExpectWord(ifs, "columns") ||
+      !(ifs >> Index.NColumns) || !ExpectWord(ifs, "runs") ||
+      !(ifs >> Index.NRuns) || !ExpectWord(ifs, "events") ||
+      !(ifs >> Index.NEvents) || !ExpectWord(ifs, "lines") ||
+      !(ifs >> Index.NLines)) {
+    UDBWarn("Ignoring unreadable index: " << IndexFileName);
+    return false;
+  }
+
+  if ((Index.FileSize != Size) || (Index.MTime != MTime)) {
+    UDBLog("Index " << IndexFileName << " is out of date, it will be rebuilt.");
+    return false;
+  }
+  if (Index.NColumns != ExpectedNColumns()) {
+    UDBLog("Index " << IndexFileName << " was built for " << Index.NColumns
+                    << " column particle lines, it will be rebuilt.");
+    return false;
+  }
+
+  std::string Kind;
+  while (ifs >> Kind) {
+    if (Kind == "run") {
+      RunEntry r;
+      if (!(ifs >> r.Run >> r.Offset >> r.FirstEvent)) {
+        break;
+      }
+      Index.Runs.push_back(r);
+    } else if (Kind == "block") {
+      BlockEntry b;
+      if (!(ifs >> b.Offset >> b.FirstEvent)) {
+        break;
+      }
+      if ((b.Offset >= Index.DataSize) ||
+          (Index.Blocks.size() && (b.Offset <= Index.Blocks.back().Offset))) {
+        break;
+      }
+      Index.Blocks.push_back(b);
+    } else {
+      break;
+    }
+  }
+  if (!ifs.eof()) {
+    UDBWarn("Ignoring unreadable index: " << IndexFileName);
+    return false;
+  }
+  return true;
+}
+
+bool WriteIndex(std::string const &InputFileName, FinalEventsIndex &Index) {
+  std::string const IndexFileName = GetIndexFileName(InputFileName);
+  if (!GetFileStamp(InputFileName, Index.FileSize, Index.MTime)) {
+    return false;
+  }
+
+  std::stringstream TmpName("");
+  TmpName << IndexFileName << ".tmp." << getpid();
+  {
+    std::ofstream ofs(TmpName.str().c_str());
+    if (!ofs.good()) {
+      UDBWarn("Could not write index " << IndexFileName
+                                       << ", continuing without it.");
+      return false;
+    }
+    ofs << "GiBUUToStdHepIndex " << kVersion << "\nsize " << Index.FileSize
+        << " mtime " << Index.MTime << " length " << Index.DataSize
+        << "\ncolumns " << Index.NColumns
+        << " runs " << Index.NRuns << " events " << Index.NEvents << " lines "
+        << Index.NLines << "\n";
+    for (size_t r_it = 0; r_it < Index.Runs.size(); ++r_it) {
+      ofs << "run " << Index.Runs[r_it].Run << " " << Index.Runs[r_it].Offset
+          << " " << Index.Runs[r_it].FirstEvent << "\n";
+    }
+    for (size_t b_it = 0; b_it < Index.Blocks.size(); ++b_it) {
+      ofs << "block " << Index.Blocks[b_it].Offset << " "
+          << Index.Blocks[b_it].FirstEvent << "\n";
+    }
+    if (!ofs.good()) {
+      ofs.close();
+      std::remove(TmpName.str().c_str());
+      UDBWarn("Could not write index " << IndexFileName
+                                       << ", continuing without it.");
+      return false;
+    }
+  }
+  if (std::rename(TmpName.str().c_str(), IndexFileName.c_str())) {
+    std::remove(TmpName.str().c_str());
+    UDBWarn("Could not write index " << IndexFileName
+                                     << ", continuing without it.");
+    return false;
+  }
+  UDBLog("Wrote index: " << IndexFileName);
+  return true;
+}
+
+void FinalEventsIndexBuilder::Reset(unsigned long long Base) {
+  Index = FinalEventsIndex();
+  BaseOffset = Base;
+  LastOffset = Base;
+}
+
+void FinalEventsIndexBuilder::AddEvent(Int_t Run, unsigned long long Offset) {
+  Offset += BaseOffset;
+  // A new block starts with the first event in each kBlockBytes stretch.
+  if (!Index.NEvents || ((Offset / kBlockBytes) != (LastOffset / kBlockBytes))) {
+    BlockEntry b = {Offset, Index.NEvents};
+    Index.Blocks.push_back(b);
+  }
+  if (!Index.NEvents || (Run != Index.Runs.back().Run)) {
+    RunEntry r = {Run, Offset, Index.NEvents};
+    Index.Runs.push_back(r);
+  }
+  LastOffset = Offset;
+  Index.NEvents++;
+}
+
+void FinalEventsIndexBuilder::Append(FinalEventsIndexBuilder const &other) {
+  if (!other.Index.NEvents) {
+    return;
+  }
+  bool const Empty = !Index.NEvents;
+  size_t const NEventsBefore = Index.NEvents;
+
+  for (size_t b_it = 0; b_it < other.Index.Blocks.size(); ++b_it) {
+    BlockEntry b = other.Index.Blocks[b_it];
+    if (!b_it && !Empty &&
+        ((b.Offset / kBlockBytes) == (LastOffset / kBlockBytes))) {
+      continue;
+    }
+    b.FirstEvent += NEventsBefore;
+    Index.Blocks.push_back(b);
+  }
+  for (size_t r_it = 0; r_it < other.Index.Runs.size(); ++r_it) {
+    RunEntry r = other.Index.Runs[r_it];
+    if (!r_it && !Empty && (r.Run == Index.Runs.back().Run)) {
+      continue;
+    }
+    r.FirstEvent += NEventsBefore;
+    Index.Runs.push_back(r);
+  }
+  LastOffset = other.LastOffset;
+  Index.NEvents += other.Index.NEvents;
+}
+
+FinalEventsIndex &FinalEventsIndexBuilder::Finish(size_t NRuns, size_t NLines,
+                                                 unsigned long long DataSize) {
+  Index.DataSize = DataSize;
+  Index.NColumns = ExpectedNColumns();
+  Index.NRuns = NRuns;
+  Index.NLines = NLines;
+  return Index;
+}
+
+} // namespace GiBUUIndex
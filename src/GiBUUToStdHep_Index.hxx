@@ -0,0 +1,133 @@
+#ifndef SEEN_GIBUUToStdHep_INDEX_HXX
+#define SEEN_GIBUUToStdHep_INDEX_HXX
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Rtypes.h"
+
+///\brief Sidecar indices of FinalEvents.dat files.
+///
+/// An index records the structure of an input file that would otherwise be
+/// rediscovered by every conversion: the number of runs, the number of events
+/// and lines, the column layout, and the byte offsets at which each run and
+/// each block of events starts. It is written next to the input file, as
+/// GetIndexFileName(InputFileName), the first time the file is read in full,
+/// and is only used while the size and modification time of the input file
+/// match those recorded in it. For a compressed input file, the size is of the
+/// file on disk, and the offsets are into its decompressed contents, whose
+/// length is recorded separately.
+///
+/// The index is a whitespace separated text file:
+///
+///     GiBUUToStdHepIndex <version>
+///     size <bytes> mtime <seconds> length <bytes>
+///     columns <N> runs <N> events <N> lines <N>
+///     run <run number> <byte offset> <first event>
+///     ...
+///     block <byte offset> <first event>
+///     ...
+///
+/// Offsets are of the first particle line of an event. Events are counted
+/// from 0 in file order, as FinalEventsAssembler groups them.
+namespace GiBUUIndex {
+
+int const kVersion = 2;
+
+///\brief The granularity of the event block offsets.
+///
+/// The first event that starts in each kBlockBytes-sized stretch of the file
+/// is recorded, so any byte range can be rounded to event boundaries without
+/// reading it.
+unsigned long long const kBlockBytes = 1024 * 1024;
+
+struct RunEntry {
+  Int_t Run;
+  unsigned long long Offset;
+  size_t FirstEvent;
+};
+
+struct BlockEntry {
+  unsigned long long Offset;
+  size_t FirstEvent;
+};
+
+struct FinalEventsIndex {
+  FinalEventsIndex()
+      : FileSize(0), MTime(0), DataSize(0), NColumns(0), NRuns(0),
+        NEvents(0), NLines(0), Runs(), Blocks() {}
+
+  ///\brief The size of the file on disk.
+  unsigned long long FileSize;
+  long long MTime;
+  ///\brief The length of the contents of the file that the offsets are into,
+  /// which for a compressed file is its decompressed length.
+  unsigned long long DataSize;
+  ///\brief The number of columns expected on each particle line when the
+  /// index was built, which determines which lines are malformed.
+  size_t NColumns;
+  ///\brief The number of runs as used to normalise the event weights.
+  size_t NRuns;
+  size_t NEvents;
+  ///\brief The number of non-comment lines.
+  size_t NLines;
+  std::vector<RunEntry> Runs;
+  std::vector<BlockEntry> Blocks;
+
+  ///\brief Gets the offset of the first event that starts at or after
+  /// Offset, or DataSize if there is none that is known.
+  unsigned long long NextBlockOffset(unsigned long long Offset) const;
+};
+
+///\brief Gets the name of the index file for InputFileName.
+std::string GetIndexFileName(std::string const &InputFileName);
+
+///\brief Reads the index for InputFileName into Index.
+///
+/// Returns false if there is no index, it cannot be parsed, or it does not
+/// match the current size, modification time or expected column layout of the
+/// input file.
+bool ReadIndex(std::string const &InputFileName, FinalEventsIndex &Index);
+
+///\brief Writes Index for InputFileName, stamped with the current size and
+/// modification time of the input file.
+///
+/// The index is written to a temporary file which is then renamed, so that a
+/// concurrent conversion never reads a partial index. Returns false, after
+/// warning, if it could not be written, e.g. in a read-only directory.
+bool WriteIndex(std::string const &InputFileName, FinalEventsIndex &Index);
+
+///\brief Accumulates the index of a FinalEvents.dat file, or of a byte range
+/// of it, as its events are assembled.
+class FinalEventsIndexBuilder {
+  FinalEventsIndex Index;
+  unsigned long long BaseOffset;
+  unsigned long long LastOffset;
+
+ public:
+  FinalEventsIndexBuilder() : Index(), BaseOffset(0), LastOffset(0) {}
+
+  ///\brief Clears the builder for a range of the file that starts BaseOffset
+  /// bytes in.
+  void Reset(unsigned long long Base = 0);
+
+  ///\brief Records an event that starts Offset bytes after the start of the
+  /// range.
+  void AddEvent(Int_t Run, unsigned long long Offset);
+
+  ///\brief Appends the events of the range that immediately follows this
+  /// one.
+  void Append(FinalEventsIndexBuilder const &other);
+
+  size_t GetNEvents() const { return Index.NEvents; }
+
+  ///\brief Completes the index of a whole file, whose contents are DataSize
+  /// bytes long.
+  FinalEventsIndex &Finish(size_t NRuns, size_t NLines,
+                           unsigned long long DataSize);
+};
+
+} // namespace GiBUUIndex
+
+#endif
@@ -0,0 +1,694 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Unix
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "LUtils/Debugging.hxx"
+
+#include "GiBUUToStdHep_Input.hxx"
+#include "GiBUUToStdHep_Pipeline.hxx"
+#include "GiBUUToStdHep_Timing.hxx"
+
+namespace {
+inline bool IsSpace(char c) {
+  return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n') ||
+         (c == '\v') || (c == '\f');
+}
+
+std::istream &Ignoreline(std::ifstream &in, std::ifstream::pos_type &pos) {
+  pos = in.tellg();
+  return in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+}
+} // namespace
+
+StreamLineReader::StreamLineReader(std::string const &FileName)
+    : ifs(FileName.c_str()), line(), NBytesRead(0) {}
+
+bool StreamLineReader::IsOpen() const { return ifs.good(); }
+
+bool StreamLineReader::NextLine(char const *&begin, char const *&end) {
+  if (!std::getline(ifs, line)) {
+    return false;
+  }
+  NBytesRead += line.size() + 1;
+  begin = line.data();
+  end = line.data() + line.size();
+  return true;
+}
+
+bool StreamLineReader::Seek(unsigned long long Offset) {
+  ifs.clear();
+  if (!ifs.seekg(std::ifstream::off_type(Offset))) {
+    return false;
+  }
+  NBytesRead = Offset;
+  return true;
+}
+
+std::string StreamLineReader::GetLastLine() {
+  std::ifstream::pos_type start = ifs.tellg();
+  std::ifstream::pos_type pos = start;
+
+  std::ifstream::pos_type lastPos;
+  while (ifs >> std::ws && Ignoreline(ifs, lastPos)) {
+    pos = lastPos;
+  }
+
+  ifs.clear();
+  ifs.seekg(pos);
+
+  std::string lastline;
+  std::getline(ifs, lastline);
+
+  /// Rewind
+  ifs.clear();
+  ifs.seekg(start);
+  return lastline;
+}
+
+MappedLineReader::MappedLineReader(std::string const &FileName)
+    : fd(-1), Data(NULL), Size(0), Cursor(NULL) {
+  fd = open(FileName.c_str(), O_RDONLY);
+  if (fd == -1) {
+    UDBError("Failed to open " << FileName << ": " << strerror(errno));
+    return;
+  }
+
+  struct stat sb;
+  if (fstat(fd, &sb) == -1) {
+    UDBError("Failed to stat " << FileName << ": " << strerror(errno));
+    close(fd);
+    fd = -1;
+    return;
+  }
+  Size = size_t(sb.st_size);
+
+  if (!Size) { // Can't map an empty file, but it is still a valid file.
+    Data = Cursor = "";
+    return;
+  }
+
+  void *map = mmap(NULL, Size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED) {
+    UDBError("Failed to mmap " << FileName << ": " << strerror(errno));
+    close(fd);
+    fd = -1;
+    Size = 0;
+    return;
+  }
+  madvise(map, Size, MADV_SEQUENTIAL);
+  Data = Cursor = static_cast<char const *>(map);
+}
+
+bool MappedLineReader::IsOpen() const { return (Data != NULL); }
+
+bool MappedLineReader::NextLine(char const *&begin, char const *&end) {
+  char const *FileEnd = Data + Size;
+  if (Cursor >= FileEnd) {
+    return false;
+  }
+  begin = Cursor;
+  char const *nl = static_cast<char const *>(
+      memchr(Cursor, '\n', size_t(FileEnd - Cursor)));
+  end = nl ? nl : FileEnd;
+  Cursor = nl ? (nl + 1) : FileEnd;
+  return true;
+}
+
+bool MappedLineReader::Seek(unsigned long long Offset) {
+  if (Offset > Size) {
+    return false;
+  }
+  Cursor = Data + Offset;
+  return true;
+}
+
+std::string MappedLineReader::GetLastLine() {
+  char const *end = Data + Size;
+  while ((end != Data) && IsSpace(*(end - 1))) {
+    --end;
+  }
+  char const *begin = end;
+  while ((begin != Data) && (*(begin - 1) != '\n')) {
+    --begin;
+  }
+  while ((begin != end) && IsSpace(*begin)) {
+    ++begin;
+  }
+  return std::string(begin, end);
+}
+
+MappedLineReader::~MappedLineReader() {
+  if (Size && Data) {
+    munmap(const_cast<char *>(Data), Size);
+  }
+  if (fd != -1) {
+    close(fd);
+  }
+}
+
+namespace {
+char const *const kCompressionNames[] = {"uncompressed", "gzip", "xz",
+                                         "zstd"};
+
+// Decodes one compressed format in pieces.
+class StreamDecoder {
+ public:
+  virtual ~StreamDecoder() {}
+
+  // Decodes from [in, in + NIn) into [out, out + NOut), advancing both.
+  // InputEnded is set once the last of the file has been passed in. Sets
+  // Finished once the end of the compressed data has been decoded, returns
+  // false if it is corrupt.
+  virtual bool Decode(char const *&in, size_t &NIn, char *&out, size_t &NOut,
+                      bool InputEnded, bool &Finished) = 0;
+};
+
+#ifdef HAVE_ZLIB
+class GzipDecoder : public StreamDecoder {
+  z_stream strm;
+  bool AtMemberEnd;
+
+ public:
+  GzipDecoder() : AtMemberEnd(false) {
+    std::memset(&strm, 0, sizeof(strm));
+    // +32: detect gzip or zlib headers.
+    if (inflateInit2(&strm, 15 + 32) != Z_OK) {
+      throw std::runtime_error("Failed to initialise zlib.");
+    }
+  }
+  ~GzipDecoder() { inflateEnd(&strm); }
+
+  bool Decode(char const *&in, size_t &NIn, char *&out, size_t &NOut,
+              bool InputEnded, bool &Finished) {
+    if (AtMemberEnd) {
+      if (!NIn) {
+        Finished = InputEnded;
+        return true;
+      }
+      // Concatenated gzip files, e.g. from parallel compressors, are a
+      // series of complete members.
+      inflateReset(&strm);
+      AtMemberEnd = false;
+    }
+    strm.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in));
+    strm.avail_in = uInt(NIn);
+    strm.next_out = reinterpret_cast<Bytef *>(out);
+    strm.avail_out = uInt(NOut);
+    int rtn = inflate(&strm, Z_NO_FLUSH);
+    in += (NIn - strm.avail_in);
+    NIn = strm.avail_in;
+    out += (NOut - strm.avail_out);
+    NOut = strm.avail_out;
+    if (rtn == Z_STREAM_END) {
+      AtMemberEnd = true;
+      Finished = (!NIn && InputEnded);
+      return true;
+    }
+    return (rtn == Z_OK) || (rtn == Z_BUF_ERROR);
+  }
+};
+#endif
+
+#ifdef HAVE_LZMA
+class XzDecoder : public StreamDecoder {
+  lzma_stream strm;
+
+ public:
+  XzDecoder() {
+    lzma_stream init = LZMA_STREAM_INIT;
+    strm = init;
+    if (lzma_stream_decoder(&strm, UINT64_MAX, LZMA_CONCATENATED) !=
+        LZMA_OK) {
+      throw std::runtime_error("Failed to initialise liblzma.");
+    }
+  }
+  ~XzDecoder() { lzma_end(&strm); }
+
+  bool Decode(char const *&in, size_t &NIn, char *&out, size_t &NOut,
+              bool InputEnded, bool &Finished) {
+    strm.next_in = reinterpret_cast<uint8_t const *>(in);
+    strm.avail_in = NIn;
+    strm.next_out = reinterpret_cast<uint8_t *>(out);
+    strm.avail_out = NOut;
+    lzma_ret rtn = lzma_code(&strm, InputEnded ? LZMA_FINISH : LZMA_RUN);
+    in += (NIn - strm.avail_in);
+    NIn = strm.avail_in;
+    out += (NOut - strm.avail_out);
+    NOut = strm.avail_out;
+    if (rtn == LZMA_STREAM_END) {
+      Finished = true;
+      return true;
+    }
+    return (rtn == LZMA_OK) || (rtn == LZMA_BUF_ERROR);
+  }
+};
+#endif
+
+#ifdef HAVE_ZSTD
+class ZstdDecoder : public StreamDecoder {
+  ZSTD_DStream *strm;
+  bool AtFrameEnd;
+
+ public:
+  ZstdDecoder() : strm(ZSTD_createDStream()), AtFrameEnd(false) {
+    if (!strm || ZSTD_isError(ZSTD_initDStream(strm))) {
+      throw std::runtime_error("Failed to initialise libzstd.");
+    }
+  }
+  ~ZstdDecoder() { ZSTD_freeDStream(strm); }
+
+  bool Decode(char const *&in, size_t &NIn, char *&out, size_t &NOut,
+              bool InputEnded, bool &Finished) {
+    ZSTD_inBuffer ib = {in, NIn, 0};
+    ZSTD_outBuffer ob = {out, NOut, 0};
+    size_t rtn = ZSTD_decompressStream(strm, &ob, &ib);
+    in += ib.pos;
+    NIn -= ib.pos;
+    out += ob.pos;
+    NOut -= ob.pos;
+    if (ZSTD_isError(rtn)) {
+      return false;
+    }
+    // 0 once a frame has been completely decoded and flushed, further frames
+    // are decoded by the same stream.
+    if (rtn == 0) {
+      AtFrameEnd = true;
+    } else if (ib.pos || ob.pos) {
+      AtFrameEnd = false;
+    }
+    Finished = (AtFrameEnd && !NIn && InputEnded);
+    return true;
+  }
+};
+#endif
+
+std::unique_ptr<StreamDecoder> MakeDecoder(InputCompression Compression) {
+  switch (Compression) {
+#ifdef HAVE_ZLIB
+  case kGzip: {
+    return std::unique_ptr<StreamDecoder>(new GzipDecoder());
+  }
+#endif
+#ifdef HAVE_LZMA
+  case kXz: {
+    return std::unique_ptr<StreamDecoder>(new XzDecoder());
+  }
+#endif
+#ifdef HAVE_ZSTD
+  case kZstd: {
+    return std::unique_ptr<StreamDecoder>(new ZstdDecoder());
+  }
+#endif
+  default: { return std::unique_ptr<StreamDecoder>(); }
+  }
+}
+
+size_t const kCompressedReadBytes = 1024 * 1024;
+size_t const kDecodedBlockBytes = 4 * 1024 * 1024;
+size_t const kDecodedBlockDepth = 4;
+
+// Receives the decoded contents of a file, a buffer at a time.
+class DecodedSink {
+ public:
+  virtual ~DecodedSink() {}
+  // Gets the buffer to decode into next.
+  virtual char *GetBuffer(size_t &Capacity) = 0;
+  // Takes the Size bytes decoded into the last buffer, after NInputBytes of
+  // the file have been consumed. Returns false to stop decoding.
+  virtual bool Flush(size_t Size, unsigned long long NInputBytes) = 0;
+};
+
+// Decodes the whole of ifile into Sink. Returns an error message, or an empty
+// string on success.
+std::string DecodeFile(FILE *ifile, StreamDecoder &Decoder, DecodedSink &Sink) {
+  std::vector<char> InBuf(kCompressedReadBytes);
+  char const *in = &InBuf[0];
+  size_t NIn = 0;
+  bool InputEnded = false;
+  unsigned long long NInputBytes = 0;
+
+  size_t Capacity = 0;
+  char *Buffer = Sink.GetBuffer(Capacity);
+  size_t Size = 0;
+  bool Finished = false;
+  while (!Finished) {
+    if (!NIn && !InputEnded) {
+      NIn = fread(&InBuf[0], 1, InBuf.size(), ifile);
+      in = &InBuf[0];
+      if (ferror(ifile)) {
+        return std::string("Read error: ") + strerror(errno);
+      }
+      InputEnded = feof(ifile);
+    }
+
+    char *out = Buffer + Size;
+    size_t NOut = Capacity - Size;
+    size_t const NInBefore = NIn;
+    if (!Decoder.Decode(in, NIn, out, NOut, InputEnded, Finished)) {
+      return "Corrupt compressed data.";
+    }
+    bool const Progressed = (NIn != NInBefore) || (NOut != (Capacity - Size));
+    NInputBytes += (NInBefore - NIn);
+    Size = Capacity - NOut;
+
+    if ((Size == Capacity) || (Finished && Size)) {
+      if (!Sink.Flush(Size, NInputBytes)) {
+        return "";
+      }
+      Buffer = Sink.GetBuffer(Capacity);
+      Size = 0;
+    } else if (!Finished && !Progressed && InputEnded && !NIn) {
+      return "Unexpected end of file, it may be truncated.";
+    }
+  }
+  return "";
+}
+
+std::FILE *OpenCompressedFile(std::string const &FileName) {
+  std::FILE *ifile = fopen(FileName.c_str(), "rb");
+  if (!ifile) {
+    UDBError("Failed to open " << FileName << ": " << strerror(errno));
+  }
+  return ifile;
+}
+
+struct DecodedBlock {
+  DecodedBlock() : Data(kDecodedBlockBytes), Size(0), NInputBytes(0) {}
+
+  std::vector<char> Data;
+  size_t Size;
+  ///\brief The number of bytes of the compressed file consumed to decode up to
+  /// the end of this block.
+  unsigned long long NInputBytes;
+
+  void Clear() { Size = 0; }
+};
+
+// Passes decoded blocks to the reading thread.
+class BlockSink : public DecodedSink {
+  BatchChannel<DecodedBlock> &Blocks;
+  DecodedBlock *Block;
+
+ public:
+  BlockSink(BatchChannel<DecodedBlock> &blocks) : Blocks(blocks), Block(NULL) {}
+  ~BlockSink() { delete Block; }
+
+  char *GetBuffer(size_t &Capacity) {
+    Block = Blocks.Acquire();
+    Capacity = Block->Data.size();
+    return &Block->Data[0];
+  }
+  bool Flush(size_t Size, unsigned long long NInputBytes) {
+    Block->Size = Size;
+    Block->NInputBytes = NInputBytes;
+    bool const Pushed = Blocks.Push(Block);
+    // Push deletes the block if the reader has gone away.
+    Block = NULL;
+    return Pushed;
+  }
+};
+
+// Keeps only the last non-empty line of the decoded file.
+class LastLineSink : public DecodedSink {
+  std::vector<char> Buffer;
+  std::string Partial;
+
+  static bool IsBlank(char const *begin, char const *end) {
+    for (; begin != end; ++begin) {
+      if (!IsSpace(*begin)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ public:
+  std::string LastLine;
+
+  LastLineSink() : Buffer(kDecodedBlockBytes), Partial(), LastLine() {}
+
+  char *GetBuffer(size_t &Capacity) {
+    Capacity = Buffer.size();
+    return &Buffer[0];
+  }
+  bool Flush(size_t Size, unsigned long long) {
+    char const *begin = &Buffer[0];
+    char const *end = begin + Size;
+    char const *lbegin = begin;
+    char const *LastBegin = NULL, *LastEnd = NULL;
+    for (;;) {
+      char const *nl = static_cast<char const *>(
+          memchr(lbegin, '\n', size_t(end - lbegin)));
+      if (!nl) {
+        break;
+      }
+      if (lbegin == begin) { // Completes the line carried over.
+        Partial.append(lbegin, nl);
+        if (!IsBlank(Partial.data(), Partial.data() + Partial.size())) {
+          LastLine = Partial;
+        }
+        Partial.clear();
+      } else if (!IsBlank(lbegin, nl)) {
+        LastBegin = lbegin;
+        LastEnd = nl;
+      }
+      lbegin = nl + 1;
+    }
+    if (LastBegin) {
+      LastLine.assign(LastBegin, LastEnd);
+    }
+    Partial.append(lbegin, end);
+    return true;
+  }
+  void Finish() {
+    if (!IsBlank(Partial.data(), Partial.data() + Partial.size())) {
+      LastLine = Partial;
+    }
+  }
+};
+
+///\brief Reads lines out of a compressed file, which is decompressed by a
+/// separate thread a few blocks ahead of the reader.
+///
+/// Lines are returned directly from the decoded blocks, unless they straddle
+/// two blocks, in which case they are copied.
+class DecompressingLineReader : public InputLineReader {
+  std::string FileName;
+  InputCompression Compression;
+  std::FILE *ifile;
+
+  BatchChannel<DecodedBlock> Blocks;
+  std::thread Decompressor;
+  // Written by the decompressor before it closes Blocks.
+  std::string Error;
+
+  DecodedBlock *Current;
+  char const *Cursor;
+  std::string Carry;
+  bool CarryReturned;
+  unsigned long long NInputBytes;
+
+  DecompressingLineReader(DecompressingLineReader const &);
+  DecompressingLineReader &operator=(DecompressingLineReader const &);
+
+  void Decompress() {
+    try {
+      std::unique_ptr<StreamDecoder> Decoder = MakeDecoder(Compression);
+      BlockSink Sink(Blocks);
+      Error = DecodeFile(ifile, *Decoder, Sink);
+    } catch (std::exception const &e) {
+      Error = e.what();
+    }
+    Blocks.Close();
+    GiBUUTiming::FinishThread("Decompressor");
+  }
+
+ public:
+  DecompressingLineReader(std::string const &fname, InputCompression comp)
+      : FileName(fname), Compression(comp), ifile(OpenCompressedFile(fname)),
+        Blocks(kDecodedBlockDepth), Decompressor(), Error(), Current(NULL),
+        Cursor(NULL), Carry(), CarryReturned(false), NInputBytes(0) {
+    if (!ifile) {
+      return;
+    }
+    UDBLog("Decompressing " << kCompressionNames[Compression] << " input "
+                            << FileName << " on a separate thread.");
+    Decompressor = std::thread(&DecompressingLineReader::Decompress, this);
+  }
+
+  bool IsOpen() const { return (ifile != NULL); }
+
+  bool NextLine(char const *&begin, char const *&end) {
+    if (CarryReturned) {
+      Carry.clear();
+      CarryReturned = false;
+    }
+    for (;;) {
+      if (Current) {
+        char const *BlockEnd = &Current->Data[0] + Current->Size;
+        char const *nl = static_cast<char const *>(
+            memchr(Cursor, '\n', size_t(BlockEnd - Cursor)));
+        if (nl && Carry.empty()) {
+          begin = Cursor;
+          end = nl;
+          Cursor = nl + 1;
+          return true;
+        }
+        if (nl) {
+          Carry.append(Cursor, nl);
+          Cursor = nl + 1;
+          break;
+        }
+        Carry.append(Cursor, BlockEnd);
+        Blocks.Release(Current);
+        Current = NULL;
+      }
+
+      if (!IsOpen() || !Blocks.Pop(Current)) {
+        Current = NULL;
+        if (Error.size()) {
+          UDBError("Failed to decompress " << FileName << ": " << Error);
+          throw std::runtime_error("Failed to decompress input file.");
+        }
+        if (Carry.empty()) { // The last line did not end with a newline.
+          return false;
+        }
+        break;
+      }
+      Cursor = &Current->Data[0];
+      NInputBytes = Current->NInputBytes;
+    }
+    begin = Carry.data();
+    end = Carry.data() + Carry.size();
+    CarryReturned = true;
+    return true;
+  }
+
+  bool Seek(unsigned long long) { return false; }
+
+  std::string GetLastLine() {
+    UDBLog("Decompressing the whole of " << FileName
+                                         << " to find its last line.");
+    std::FILE *lfile = OpenCompressedFile(FileName);
+    if (!lfile) {
+      return "";
+    }
+    LastLineSink Sink;
+    std::unique_ptr<StreamDecoder> Decoder = MakeDecoder(Compression);
+    std::string err = DecodeFile(lfile, *Decoder, Sink);
+    fclose(lfile);
+    if (err.size()) {
+      UDBError("Failed to decompress " << FileName << ": " << err);
+      throw std::runtime_error("Failed to decompress input file.");
+    }
+    Sink.Finish();
+    std::string const &line = Sink.LastLine;
+    size_t first = 0;
+    while ((first < line.size()) && IsSpace(line[first])) {
+      ++first;
+    }
+    return line.substr(first);
+  }
+
+  unsigned long long GetInputBytesRead() const { return NInputBytes; }
+
+  ~DecompressingLineReader() {
+    // Stops the decompressor if it is waiting to pass on a block.
+    Blocks.Close();
+    if (Decompressor.joinable()) {
+      Decompressor.join();
+    }
+    if (Current) {
+      Blocks.Release(Current);
+    }
+    if (ifile) {
+      fclose(ifile);
+    }
+  }
+};
+} // namespace
+
+InputCompression GetInputCompression(std::string const &FileName) {
+  unsigned char Magic[6] = {0, 0, 0, 0, 0, 0};
+  std::FILE *ifile = fopen(FileName.c_str(), "rb");
+  if (!ifile) {
+    return kUncompressed;
+  }
+  size_t NRead = fread(Magic, 1, sizeof(Magic), ifile);
+  fclose(ifile);
+
+  if ((NRead >= 2) && (Magic[0] == 0x1f) && (Magic[1] == 0x8b)) {
+    return kGzip;
+  }
+  unsigned char const XzMagic[6] = {0xfd, '7', 'z', 'X', 'Z', 0x00};
+  if ((NRead >= 6) && !std::memcmp(Magic, XzMagic, 6)) {
+    return kXz;
+  }
+  if ((NRead >= 4) && (Magic[0] == 0x28) && (Magic[1] == 0xb5) &&
+      (Magic[2] == 0x2f) && (Magic[3] == 0xfd)) {
+    return kZstd;
+  }
+  return kUncompressed;
+}
+
+std::string GetInputFormatExtension(std::string const &FileName) {
+  std::string name = FileName.substr(FileName.find_last_of('/') + 1);
+  for (;;) {
+    size_t dot = name.find_last_of('.');
+    if (dot == std::string::npos) {
+      return "";
+    }
+    std::string ext = name.substr(dot + 1);
+    if ((ext != "gz") && (ext != "xz") && (ext != "zst")) {
+      return ext;
+    }
+    name = name.substr(0, dot);
+  }
+}
+
+std::unique_ptr<InputLineReader> OpenInputLineReader(std::string const &FileName,
+                                                     bool UseMMap) {
+  InputCompression Compression = GetInputCompression(FileName);
+  if (Compression != kUncompressed) {
+    if (!MakeDecoder(Compression)) {
+      UDBError(FileName << " is " << kCompressionNames[Compression]
+                        << " compressed, but this build of GiBUUToStdHep "
+                           "cannot decompress it.");
+      throw std::runtime_error("Unsupported input compression.");
+    }
+    return std::unique_ptr<InputLineReader>(
+        new DecompressingLineReader(FileName, Compression));
+  }
+  if (UseMMap) {
+    return std::unique_ptr<InputLineReader>(new MappedLineReader(FileName));
+  }
+  return std::unique_ptr<InputLineReader>(new StreamLineReader(FileName));
+}
+
+unsigned long long GetInputFileSize(std::string const &FileName) {
+  struct stat sb;
+  if (stat(FileName.c_str(), &sb) == -1) {
+    return 0;
+  }
+  return (unsigned long long)(sb.st_size);
+}
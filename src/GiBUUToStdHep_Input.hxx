@@ -0,0 +1,114 @@
+#ifndef SEEN_GIBUUToStdHep_INPUT_HXX
+#define SEEN_GIBUUToStdHep_INPUT_HXX
+
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <string>
+
+///\brief Line-by-line access to a GiBUU text output file.
+///
+/// The [begin, end) range returned by NextLine does not include the line
+/// terminator and is only valid until the next call to NextLine.
+class InputLineReader {
+ public:
+  virtual ~InputLineReader() {}
+
+  virtual bool IsOpen() const = 0;
+
+  ///\brief Moves to the next line, returns false at the end of the file.
+  virtual bool NextLine(char const *&begin, char const *&end) = 0;
+
+  ///\brief Moves to Offset bytes into the contents of the file, which must be
+  /// the start of a line.
+  ///
+  /// Returns false, without moving, if the file can only be read from start
+  /// to end, as compressed files are.
+  virtual bool Seek(unsigned long long Offset) = 0;
+
+  ///\brief Gets the last non-empty line in the file, with any leading
+  /// whitespace removed.
+  ///
+  /// Does not move the current read position.
+  virtual std::string GetLastLine() = 0;
+
+  ///\brief The number of bytes of the file on disk consumed so far.
+  ///
+  /// For compressed files, this is the amount of compressed data that has been
+  /// decoded, not the length of the lines read.
+  virtual unsigned long long GetInputBytesRead() const = 0;
+};
+
+///\brief Reads lines through std::getline.
+class StreamLineReader : public InputLineReader {
+  std::ifstream ifs;
+  std::string line;
+  unsigned long long NBytesRead;
+
+ public:
+  StreamLineReader(std::string const &FileName);
+
+  bool IsOpen() const;
+  bool NextLine(char const *&begin, char const *&end);
+  bool Seek(unsigned long long Offset);
+  std::string GetLastLine();
+  unsigned long long GetInputBytesRead() const { return NBytesRead; }
+};
+
+///\brief Reads lines directly out of a read-only memory mapping of the file.
+///
+/// The kernel is advised that the mapping will be read sequentially, and no
+/// copy of each line is made. The last line is found by scanning backwards
+/// from the end of the mapping, rather than by reading the whole file.
+class MappedLineReader : public InputLineReader {
+  int fd;
+  char const *Data;
+  size_t Size;
+  char const *Cursor;
+
+  MappedLineReader(MappedLineReader const &);
+  MappedLineReader &operator=(MappedLineReader const &);
+
+ public:
+  MappedLineReader(std::string const &FileName);
+
+  bool IsOpen() const;
+  bool NextLine(char const *&begin, char const *&end);
+  bool Seek(unsigned long long Offset);
+  std::string GetLastLine();
+  unsigned long long GetInputBytesRead() const {
+    return (unsigned long long)(Cursor - Data);
+  }
+
+  ///\brief The start of the mapped file contents.
+  char const *Begin() const { return Data; }
+  ///\brief One past the end of the mapped file contents.
+  char const *End() const { return Data + Size; }
+
+  ~MappedLineReader();
+};
+
+///\brief Gets the size of FileName in bytes, or 0 if it cannot be found.
+unsigned long long GetInputFileSize(std::string const &FileName);
+
+enum InputCompression { kUncompressed = 0, kGzip, kXz, kZstd };
+
+///\brief Identifies the compression of FileName from its first few bytes.
+InputCompression GetInputCompression(std::string const &FileName);
+
+///\brief Gets the extension that identifies the GiBUU output format of
+/// FileName, skipping any compression extension, e.g. "lhe" for
+/// "EventOutput.Pert.00000001.lhe.gz".
+std::string GetInputFormatExtension(std::string const &FileName);
+
+///\brief Opens FileName for line-by-line reading, through a memory mapping if
+/// UseMMap is true.
+///
+/// Gzip, xz and zstd compressed files, as identified by
+/// GetInputCompression, are instead decompressed on a separate thread as they
+/// are read, whatever UseMMap is. Each format is only available if the
+/// corresponding library was found at build time.
+std::unique_ptr<InputLineReader> OpenInputLineReader(std::string const &FileName,
+                                                     bool UseMMap);
+
+#endif
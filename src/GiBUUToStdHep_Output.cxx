@@ -0,0 +1,307 @@
+#include <sstream>
+
+#include "TNamed.h"
+
+#include "LUtils/Debugging.hxx"
+
+#include "GiBUUToStdHep_CLIOpts.hxx"
+#include "GiBUUToStdHep_Output.hxx"
+#include "GiBUUToStdHep_Timing.hxx"
+
+size_t FlushEventsToDisk(TTree *OutputTree, GiRooTracker *giRooTracker,
+                         GiRooTrackerBatch const &Converted) {
+  size_t NEvents = Converted.GetNEvents();
+  size_t ParticleOffset = 0;
+  for (size_t ev_it = 0; ev_it < NEvents; ++ev_it) {
+    Converted.Load(ev_it, ParticleOffset, *giRooTracker);
+    if (GiBUUToStdHepOpts::CompactP4Output) {
+      giRooTracker->FillCompactP4();
+    }
+    if (GiBUUToStdHepOpts::DerivedKinematicsOutput) {
+      giRooTracker->FillDerivedKinematics();
+    }
+    GiBUUTiming::ScopedTimer timer(GiBUUTiming::kTreeFill);
+    OutputTree->Fill();
+  }
+  GiBUUTiming::AddEventsWritten(NEvents);
+  UDBInfo("Wrote " << NEvents << " events to disk.");
+  return NEvents;
+}
+
+namespace {
+// Sums the GiBUUPerWeight of the giRooTracker entries of each of Records, for
+// files written before the sums were recorded.
+void SumPerWeights(TFile *File, std::vector<InputFileRecord> &Records) {
+  TTree *Tree = NULL;
+  File->GetObject("giRooTracker", Tree);
+  if (!Tree) {
+    return;
+  }
+  UDBLog("Summing the event weights of the " << Tree->GetEntries()
+                                             << " entries in "
+                                             << File->GetName() << ".");
+  Double_t PerWeight = 0;
+  Tree->SetBranchStatus("*", false);
+  Tree->SetBranchStatus("GiBUUPerWeight", true);
+  Tree->SetBranchAddress("GiBUUPerWeight", &PerWeight);
+  for (size_t f_it = 0; f_it < Records.size(); ++f_it) {
+    InputFileRecord &rec = Records[f_it];
+    rec.SumPerWeight = 0;
+    for (Long64_t e_it = rec.FirstEntry;
+         (e_it < (rec.FirstEntry + rec.NEntries)) &&
+         (e_it < Tree->GetEntries());
+         ++e_it) {
+      Tree->GetEntry(e_it);
+      rec.SumPerWeight += PerWeight;
+    }
+  }
+  Tree->SetBranchStatus("*", true);
+  Tree->ResetBranchAddresses();
+}
+} // namespace
+
+bool ConversionOptionsRecord::operator==(
+    ConversionOptionsRecord const &other) const {
+  return (OverallWeight == other.OverallWeight) &&
+         (EventMode == other.EventMode) &&
+         (EScatteringEnergy == other.EScatteringEnergy) &&
+         (HaveStruckNucleonInfo == other.HaveStruckNucleonInfo) &&
+         (HaveProdChargeInfo == other.HaveProdChargeInfo);
+}
+
+ConversionOptionsRecord GetConversionOptions() {
+  ConversionOptionsRecord Options;
+  Options.OverallWeight = GiBUUToStdHepOpts::OverallWeight;
+  if (GiBUUToStdHepOpts::IsElectronScattering) {
+    Options.EventMode = 1;
+    Options.EScatteringEnergy = GiBUUToStdHepOpts::EScatteringInputEnergy;
+  } else if (GiBUUToStdHepOpts::IsNDK) {
+    Options.EventMode = 2;
+  }
+  Options.HaveStruckNucleonInfo = GiBUUToStdHepOpts::HaveStruckNucleonInfo;
+  Options.HaveProdChargeInfo = GiBUUToStdHepOpts::HaveProdChargeInfo;
+  return Options;
+}
+
+bool ReadInputFileRecords(TFile *File, std::vector<InputFileRecord> &Records) {
+  TTree *FilesTree = NULL;
+  File->GetObject(kInputFilesTreeName, FilesTree);
+  if (!FilesTree) {
+    return false;
+  }
+
+  InputFileRecord rec;
+  std::string *FileName = NULL;
+  FilesTree->SetBranchAddress("FileName", &FileName);
+  FilesTree->SetBranchAddress("NRuns", &rec.NRuns);
+  FilesTree->SetBranchAddress("FirstEntry", &rec.FirstEntry);
+  FilesTree->SetBranchAddress("NEntries", &rec.NEntries);
+  FilesTree->SetBranchAddress("NFilesAddedWeight", &rec.NFilesAddedWeight);
+  FilesTree->SetBranchAddress("TreeNumRunsWeight", &rec.TreeNumRunsWeight);
+  FilesTree->SetBranchAddress("FileExtraWeight", &rec.FileExtraWeight);
+  FilesTree->SetBranchAddress("ProbePDG", &rec.ProbePDG);
+  FilesTree->SetBranchAddress("TargetA", &rec.TargetA);
+  FilesTree->SetBranchAddress("TargetZ", &rec.TargetZ);
+  FilesTree->SetBranchAddress("IsCC", &rec.IsCC);
+  bool const HaveSums = (FilesTree->GetBranch("SumPerWeight") != NULL);
+  if (HaveSums) {
+    FilesTree->SetBranchAddress("SumPerWeight", &rec.SumPerWeight);
+  }
+
+  Records.clear();
+  for (Long64_t f_it = 0; f_it < FilesTree->GetEntries(); ++f_it) {
+    FilesTree->GetEntry(f_it);
+    rec.FileName = FileName ? *FileName : "";
+    Records.push_back(rec);
+  }
+  // Replaced by WriteInputFileRecords.
+  delete FilesTree;
+  delete FileName;
+  if (!HaveSums) {
+    SumPerWeights(File, Records);
+  }
+  return true;
+}
+
+void WriteInputFileRecords(std::vector<InputFileRecord> const &Records,
+                           ConversionOptionsRecord const &Options) {
+  TTree *FilesTree =
+      new TTree(kInputFilesTreeName, "GiBUUToStdHep input files");
+  InputFileRecord rec;
+  FilesTree->Branch("FileName", &rec.FileName);
+  FilesTree->Branch("NRuns", &rec.NRuns, "NRuns/I");
+  FilesTree->Branch("FirstEntry", &rec.FirstEntry, "FirstEntry/L");
+  FilesTree->Branch("NEntries", &rec.NEntries, "NEntries/L");
+  FilesTree->Branch("NFilesAddedWeight", &rec.NFilesAddedWeight,
+                    "NFilesAddedWeight/D");
+  FilesTree->Branch("TreeNumRunsWeight", &rec.TreeNumRunsWeight,
+                    "TreeNumRunsWeight/D");
+  FilesTree->Branch("FileExtraWeight", &rec.FileExtraWeight,
+                    "FileExtraWeight/D");
+  FilesTree->Branch("ProbePDG", &rec.ProbePDG, "ProbePDG/I");
+  FilesTree->Branch("TargetA", &rec.TargetA, "TargetA/I");
+  FilesTree->Branch("TargetZ", &rec.TargetZ, "TargetZ/I");
+  FilesTree->Branch("IsCC", &rec.IsCC, "IsCC/I");
+  FilesTree->Branch("SumPerWeight", &rec.SumPerWeight, "SumPerWeight/D");
+
+  TTree *MetaTree =
+      new TTree(kMetaTreeName, "GiBUUToStdHep input file summary");
+  Double_t NumRunsWeight = 1;
+  Double_t SumEvtWght = 0;
+  ConversionOptionsRecord opts = Options;
+  MetaTree->Branch("FileName", &rec.FileName);
+  MetaTree->Branch("NRuns", &rec.NRuns, "NRuns/I");
+  MetaTree->Branch("FirstEntry", &rec.FirstEntry, "FirstEntry/L");
+  MetaTree->Branch("NEntries", &rec.NEntries, "NEntries/L");
+  MetaTree->Branch("ProbePDG", &rec.ProbePDG, "ProbePDG/I");
+  MetaTree->Branch("TargetA", &rec.TargetA, "TargetA/I");
+  MetaTree->Branch("TargetZ", &rec.TargetZ, "TargetZ/I");
+  MetaTree->Branch("IsCC", &rec.IsCC, "IsCC/I");
+  MetaTree->Branch("NumRunsWeight", &NumRunsWeight, "NumRunsWeight/D");
+  MetaTree->Branch("FileExtraWeight", &rec.FileExtraWeight,
+                   "FileExtraWeight/D");
+  MetaTree->Branch("SumPerWeight", &rec.SumPerWeight, "SumPerWeight/D");
+  MetaTree->Branch("SumEvtWght", &SumEvtWght, "SumEvtWght/D");
+  MetaTree->Branch("OverallWeight", &opts.OverallWeight, "OverallWeight/D");
+  MetaTree->Branch("EventMode", &opts.EventMode, "EventMode/I");
+  MetaTree->Branch("EScatteringEnergy", &opts.EScatteringEnergy,
+                   "EScatteringEnergy/D");
+  MetaTree->Branch("HaveStruckNucleonInfo", &opts.HaveStruckNucleonInfo,
+                   "HaveStruckNucleonInfo/I");
+  MetaTree->Branch("HaveProdChargeInfo", &opts.HaveProdChargeInfo,
+                   "HaveProdChargeInfo/I");
+
+  for (size_t f_it = 0; f_it < Records.size(); ++f_it) {
+    rec = Records[f_it];
+    FilesTree->Fill();
+    NumRunsWeight = rec.GetNumRunsWeight();
+    // As GetEvtWght, but with the options of Options.
+    SumEvtWght = rec.SumPerWeight *
+                 (NumRunsWeight * rec.FileExtraWeight * opts.OverallWeight) *
+                 ((opts.EventMode == 1) ? 1E5 : 1);
+    MetaTree->Fill();
+  }
+  FilesTree->Write("", TObject::kOverwrite);
+  MetaTree->Write("", TObject::kOverwrite);
+}
+
+bool ReadConversionOptions(TFile *File, ConversionOptionsRecord &Options) {
+  TTree *MetaTree = NULL;
+  File->GetObject(kMetaTreeName, MetaTree);
+  if (!MetaTree) {
+    return false;
+  }
+  bool const HaveEntry = (MetaTree->GetEntries() > 0);
+  if (HaveEntry) {
+    MetaTree->SetBranchStatus("*", false);
+    MetaTree->SetBranchStatus("OverallWeight", true);
+    MetaTree->SetBranchStatus("EventMode", true);
+    MetaTree->SetBranchStatus("EScatteringEnergy", true);
+    MetaTree->SetBranchStatus("HaveStruckNucleonInfo", true);
+    MetaTree->SetBranchStatus("HaveProdChargeInfo", true);
+    MetaTree->SetBranchAddress("OverallWeight", &Options.OverallWeight);
+    MetaTree->SetBranchAddress("EventMode", &Options.EventMode);
+    MetaTree->SetBranchAddress("EScatteringEnergy",
+                               &Options.EScatteringEnergy);
+    MetaTree->SetBranchAddress("HaveStruckNucleonInfo",
+                               &Options.HaveStruckNucleonInfo);
+    MetaTree->SetBranchAddress("HaveProdChargeInfo",
+                               &Options.HaveProdChargeInfo);
+    MetaTree->GetEntry(0);
+  }
+  delete MetaTree;
+  return HaveEntry;
+}
+
+void WriteShardInfo(size_t ShardIndex, size_t NShards) {
+  std::stringstream ss("");
+  ss << ShardIndex << "/" << NShards;
+  TNamed ShardInfo(kShardInfoName, ss.str().c_str());
+  ShardInfo.Write("", TObject::kOverwrite);
+}
+
+bool ReadShardInfo(TFile *File, size_t &ShardIndex, size_t &NShards) {
+  TNamed *ShardInfo = NULL;
+  File->GetObject(kShardInfoName, ShardInfo);
+  if (!ShardInfo) {
+    return false;
+  }
+  std::stringstream ss(ShardInfo->GetTitle());
+  delete ShardInfo;
+  char Separator = 0;
+  return (ss >> ShardIndex >> Separator >> NShards) && (Separator == '/') &&
+         (ShardIndex < NShards);
+}
+
+Double_t GetEvtWght(Double_t GiBUUPerWeight, Double_t NumRunsWeight,
+                    Double_t FileExtraWeight) {
+  return GiBUUPerWeight *
+         (NumRunsWeight * FileExtraWeight * GiBUUToStdHepOpts::OverallWeight) *
+         (GiBUUToStdHepOpts::IsElectronScattering ? 1E5 : 1);
+}
+
+Long64_t GetNRecordedEntries(std::vector<InputFileRecord> const &Records) {
+  Long64_t NRecorded = 0;
+  for (size_t f_it = 0; f_it < Records.size(); ++f_it) {
+    if (Records[f_it].FirstEntry != NRecorded) {
+      break;
+    }
+    NRecorded += Records[f_it].NEntries;
+  }
+  return NRecorded;
+}
+
+bool WriteWeightsFriendTree(TTree *OutputTree, GiRooTracker *giRooTracker,
+                            std::vector<InputFileRecord> const &Records) {
+  Long64_t const NRecorded = GetNRecordedEntries(Records);
+  if (NRecorded != OutputTree->GetEntries()) {
+    UDBWarn("The " << kInputFilesTreeName << " tree accounts for " << NRecorded
+                   << " of the " << OutputTree->GetEntries()
+                   << " entries in the output tree, not writing recomputed "
+                      "weights.");
+    return false;
+  }
+
+  // The weights written by a previous append or reweight are superseded, and
+  // must not be read alongside the output tree below.
+  TTree *OldWeightsTree = OutputTree->GetFriend(kWeightsTreeName);
+  if (OldWeightsTree) {
+    OutputTree->RemoveFriend(OldWeightsTree);
+  }
+
+  TTree *WeightsTree =
+      new TTree(kWeightsTreeName, "Recomputed GiBUU event weights");
+  Double_t NumRunsWeight = 1;
+  Double_t FileExtraWeight = 1;
+  Double_t EvtWght = 0;
+  WeightsTree->Branch("NumRunsWeight", &NumRunsWeight, "NumRunsWeight/D");
+  WeightsTree->Branch("FileExtraWeight", &FileExtraWeight,
+                      "FileExtraWeight/D");
+  WeightsTree->Branch("EvtWght", &EvtWght, "EvtWght/D");
+
+  OutputTree->SetBranchStatus("*", false);
+  OutputTree->SetBranchStatus("GiBUUPerWeight", true);
+  for (size_t f_it = 0; f_it < Records.size(); ++f_it) {
+    InputFileRecord const &rec = Records[f_it];
+    NumRunsWeight = rec.GetNumRunsWeight();
+    FileExtraWeight = rec.FileExtraWeight;
+    Double_t const Rescale = NumRunsWeight / rec.TreeNumRunsWeight;
+    if (Rescale != 1) {
+      UDBLog("Rescaling the NumRunsWeight of "
+             << rec.NEntries << " events from " << rec.FileName << " by "
+             << Rescale << ".");
+    }
+    for (Long64_t e_it = rec.FirstEntry;
+         e_it < (rec.FirstEntry + rec.NEntries); ++e_it) {
+      OutputTree->GetEntry(e_it);
+      EvtWght = GetEvtWght(giRooTracker->GiBUUPerWeight, NumRunsWeight,
+                           FileExtraWeight);
+      WeightsTree->Fill();
+    }
+  }
+  OutputTree->SetBranchStatus("*", true);
+
+  WeightsTree->Write("", TObject::kOverwrite);
+  OutputTree->AddFriend(WeightsTree);
+  return true;
+}
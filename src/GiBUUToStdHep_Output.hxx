@@ -0,0 +1,149 @@
+#ifndef SEEN_GIBUUToStdHep_OUTPUT_HXX
+#define SEEN_GIBUUToStdHep_OUTPUT_HXX
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "TFile.h"
+#include "TTree.h"
+
+#include "GiRooTracker.hxx"
+
+///\brief Writes a batch of converted events to OutputTree through the branch
+/// addresses of giRooTracker.
+///
+/// Returns the number of events written.
+size_t FlushEventsToDisk(TTree *OutputTree, GiRooTracker *giRooTracker,
+                         GiRooTrackerBatch const &Converted);
+
+
+///\brief The name of the meta tree that records which input files an output
+/// file was converted from.
+char const *const kInputFilesTreeName = "giRooTrackerFiles";
+
+///\brief The name of the friend tree of giRooTracker that holds event weights
+/// recomputed by later appends or reweights.
+char const *const kWeightsTreeName = "giRooTrackerWeights";
+
+///\brief The name of the object that records which shard of the input files
+/// an output file was converted from, as `i/N'.
+char const *const kShardInfoName = "giRooTrackerShard";
+
+///\brief The name of the tree that summarises each input file of an output
+/// file, and the options that it was converted with, so that downstream tools
+/// need not read every entry to normalise or merge it.
+char const *const kMetaTreeName = "giRooTrackerMeta";
+
+///\brief An input file that has been converted into an output file, as stored
+/// in each entry of the kInputFilesTreeName tree.
+struct InputFileRecord {
+  InputFileRecord()
+      : FileName(""), NRuns(1), FirstEntry(0), NEntries(0),
+        NFilesAddedWeight(1), TreeNumRunsWeight(1), FileExtraWeight(1),
+        ProbePDG(0), TargetA(0), TargetZ(0), IsCC(0), SumPerWeight(0) {}
+
+  std::string FileName;
+  ///\brief The number of GiBUU runs in the file, which its event weights are
+  /// averaged over.
+  Int_t NRuns;
+  ///\brief The first giRooTracker entry converted from this file.
+  Long64_t FirstEntry;
+  Long64_t NEntries;
+  ///\brief The weight that averages over the files added by the same -f
+  /// argument, as it applies after the latest conversion into, or reweight
+  /// of, the file.
+  Double_t NFilesAddedWeight;
+  ///\brief The NumRunsWeight that the giRooTracker entries of this file were
+  /// written with.
+  Double_t TreeNumRunsWeight;
+  ///\brief The -W weight of the file, as it applies after the latest
+  /// conversion into, or reweight of, the file.
+  Double_t FileExtraWeight;
+  Int_t ProbePDG;
+  Int_t TargetA;
+  Int_t TargetZ;
+  Int_t IsCC;
+  ///\brief The sum of the GiBUUPerWeight of the giRooTracker entries of this
+  /// file.
+  Double_t SumPerWeight;
+
+  Double_t GetNumRunsWeight() const {
+    return NFilesAddedWeight / Double_t(NRuns);
+  }
+};
+
+///\brief The options of a conversion that apply to every input file, as
+/// stored in each entry of the kMetaTreeName tree.
+struct ConversionOptionsRecord {
+  ConversionOptionsRecord()
+      : OverallWeight(1), EventMode(0), EScatteringEnergy(0),
+        HaveStruckNucleonInfo(0), HaveProdChargeInfo(0) {}
+
+  ///\brief The -R weight.
+  Double_t OverallWeight;
+  ///\brief As passed to GiRooTracker::AddBranches: 0 for neutrino, 1 for
+  /// electron scattering and 2 for nucleon decay events.
+  Int_t EventMode;
+  ///\brief The electron beam energy, for electron scattering events only.
+  Double_t EScatteringEnergy;
+  Int_t HaveStruckNucleonInfo;
+  Int_t HaveProdChargeInfo;
+
+  bool operator==(ConversionOptionsRecord const &other) const;
+  bool operator!=(ConversionOptionsRecord const &other) const {
+    return !(*this == other);
+  }
+};
+
+///\brief Gets the options of the current conversion.
+ConversionOptionsRecord GetConversionOptions();
+
+///\brief Gets the EvtWght of an event from its weights and the current
+/// -R weight.
+Double_t GetEvtWght(Double_t GiBUUPerWeight, Double_t NumRunsWeight,
+                    Double_t FileExtraWeight);
+
+///\brief Gets the number of giRooTracker entries, from the first, that
+/// Records accounts for without a gap.
+Long64_t GetNRecordedEntries(std::vector<InputFileRecord> const &Records);
+
+///\brief Reads the kInputFilesTreeName tree from File into Records.
+///
+/// If it was written without the SumPerWeight of each file, the sums are
+/// recomputed from the GiBUUPerWeight branch of the giRooTracker tree in File.
+/// Returns false if there is no such tree.
+bool ReadInputFileRecords(TFile *File, std::vector<InputFileRecord> &Records);
+
+///\brief Writes Records as the kInputFilesTreeName tree, and their summary,
+/// with the current weights of each file and Options, as the kMetaTreeName
+/// tree in the current directory, replacing any previous versions.
+void WriteInputFileRecords(std::vector<InputFileRecord> const &Records,
+                           ConversionOptionsRecord const &Options);
+
+///\brief Reads the conversion options from the kMetaTreeName tree in File.
+///
+/// Returns false if there is no such tree, or it has no entries.
+bool ReadConversionOptions(TFile *File, ConversionOptionsRecord &Options);
+
+///\brief Writes the kShardInfoName object in the current directory,
+/// replacing any previous version.
+void WriteShardInfo(size_t ShardIndex, size_t NShards);
+
+///\brief Reads the kShardInfoName object from File.
+///
+/// Returns false if there is no such object or it cannot be parsed.
+bool ReadShardInfo(TFile *File, size_t &ShardIndex, size_t &NShards);
+
+///\brief Writes the kWeightsTreeName friend tree of OutputTree, with the
+/// NumRunsWeight, FileExtraWeight and EvtWght of every entry recomputed from
+/// the current weights of its input file and the current -R weight, and makes
+/// it the friend of OutputTree in place of any previous version.
+///
+/// Only the GiBUUPerWeight branch of OutputTree is read, through the branch
+/// addresses of giRooTracker. Returns false, after warning, if Records does
+/// not account for every entry of OutputTree.
+bool WriteWeightsFriendTree(TTree *OutputTree, GiRooTracker *giRooTracker,
+                            std::vector<InputFileRecord> const &Records);
+
+#endif
@@ -0,0 +1,566 @@
+#include <cfloat>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "LUtils/Debugging.hxx"
+
+#include "GiBUUToStdHep_CLIOpts.hxx"
+#include "GiBUUToStdHep_Diagnostics.hxx"
+#include "GiBUUToStdHep_Parsing.hxx"
+#include "GiBUUToStdHep_Timing.hxx"
+
+#include "GiRooTracker.hxx"
+
+namespace {
+inline bool IsSpace(char c) {
+  return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+}
+inline bool IsDigit(char c) { return (c >= '0') && (c <= '9'); }
+
+// Every power of ten up to 1E22 is exactly representable as a double.
+double const kExactPowersOfTen[] = {1E0,  1E1,  1E2,  1E3,  1E4,  1E5,
+                                    1E6,  1E7,  1E8,  1E9,  1E10, 1E11,
+                                    1E12, 1E13, 1E14, 1E15, 1E16, 1E17,
+                                    1E18, 1E19, 1E20, 1E21, 1E22};
+int const kMaxExactPowerOfTen = 22;
+unsigned long long const kMaxExactMantissa = (1ULL << 53);
+
+// Slow path, used for anything the fast path cannot convert exactly.
+bool ParseDouble_strtod(char const *begin, char const *end, Double_t &val) {
+  char buf[128];
+  size_t len = size_t(end - begin);
+  if (len >= sizeof(buf)) {
+    return false;
+  }
+  std::memcpy(buf, begin, len);
+  buf[len] = '\0';
+  char *pEnd = NULL;
+  val = std::strtod(buf, &pEnd);
+  return (pEnd == (buf + len));
+}
+
+// Gets the event number that GetParticleLine would parse from a line,
+// without reporting anything for malformed lines.
+Int_t PeekEvNum(char const *begin, char const *end) {
+  size_t const NExpectedColumns =
+      GiBUUParsing::kNFinalEventsColumns +
+      size_t(GiBUUToStdHepOpts::HaveProdChargeInfo);
+
+  GiBUUParsing::Column cols[GiBUUParsing::kMaxColumns];
+  if ((GiBUUParsing::SplitColumns(begin, end, cols) != NExpectedColumns) &&
+      (GiBUUParsing::SplitColumns(begin, end, cols, true) !=
+       NExpectedColumns)) {
+    return 0;
+  }
+  Int_t EvNum = 0;
+  if (!GiBUUParsing::ParseInt(cols[1].begin, cols[1].end, EvNum)) {
+    return 0;
+  }
+  return EvNum;
+}
+
+inline char const *EndOfLine(char const *begin, char const *end) {
+  char const *nl =
+      static_cast<char const *>(memchr(begin, '\n', size_t(end - begin)));
+  return nl ? nl : end;
+}
+
+inline bool IsComment(char const *begin, char const *end) {
+  return (begin != end) && (begin[0] == '#');
+}
+
+// Whether a line of a Les Houches event block is a comment, which may be
+// indented.
+inline bool IsIndentedComment(char const *begin, char const *end) {
+  while ((begin != end) && IsSpace(*begin)) {
+    ++begin;
+  }
+  return IsComment(begin, end);
+}
+
+// GiBUU writes the event information, including the final state lepton
+// kinematics, on a comment line with at least this many columns, counting the
+// '#', at the end of each Les Houches event block.
+size_t const kNLesHouchesInfoColumns = 12;
+
+void ThrowBadColumn(char const *begin, char const *end,
+                    GiBUUParsing::Column const &col) {
+  UDBError("Failed to parse one of the values: \""
+           << std::string(col.begin, col.end) << "\" in line: \""
+           << std::string(begin, end) << "\"");
+  throw std::invalid_argument("Failed to parse GiBUU output column.");
+}
+} // namespace
+
+namespace GiBUUParsing {
+
+size_t SplitColumns(char const *begin, char const *end, Column *Columns,
+                    bool SplitGluedNegatives) {
+  size_t NColumns = 0;
+  char const *c = begin;
+  while (c != end) {
+    while ((c != end) && IsSpace(*c)) {
+      ++c;
+    }
+    if (c == end) {
+      break;
+    }
+    char const *ColBegin = c++;
+    while ((c != end) && !IsSpace(*c)) {
+      if (SplitGluedNegatives && (*c == '-') && (*(c - 1) != 'E')) {
+        break;
+      }
+      ++c;
+    }
+    if (NColumns < kMaxColumns) {
+      Columns[NColumns].begin = ColBegin;
+      Columns[NColumns].end = c;
+    }
+    NColumns++;
+  }
+  return NColumns;
+}
+
+bool ParseLong(char const *begin, char const *end, Long_t &val) {
+  char const *c = begin;
+  bool Neg = false;
+  if ((c != end) && ((*c == '-') || (*c == '+'))) {
+    Neg = (*c == '-');
+    ++c;
+  }
+  if (c == end) {
+    return false;
+  }
+  unsigned long long acc = 0;
+  unsigned long long const Limit =
+      Neg ? (static_cast<unsigned long long>(LONG_MAX) + 1)
+          : static_cast<unsigned long long>(LONG_MAX);
+  for (; c != end; ++c) {
+    if (!IsDigit(*c)) {
+      return false;
+    }
+    unsigned digit = unsigned(*c - '0');
+    if (acc > ((Limit - digit) / 10)) {
+      return false;
+    }
+    acc = acc * 10 + digit;
+  }
+  val = Neg ? Long_t(-static_cast<long long>(acc - 1) - 1) : Long_t(acc);
+  return true;
+}
+
+bool ParseInt(char const *begin, char const *end, Int_t &val) {
+  Long_t lval;
+  if (!ParseLong(begin, end, lval) || (lval > INT_MAX) || (lval < INT_MIN)) {
+    return false;
+  }
+  val = Int_t(lval);
+  return true;
+}
+
+bool ParseDouble(char const *begin, char const *end, Double_t &val) {
+#if defined(FLT_EVAL_METHOD) && (FLT_EVAL_METHOD == 0)
+  char const *c = begin;
+  bool Neg = false;
+  if ((c != end) && ((*c == '-') || (*c == '+'))) {
+    Neg = (*c == '-');
+    ++c;
+  }
+
+  unsigned long long Mantissa = 0;
+  int NSigDigits = 0;
+  int Exponent = 0;
+  bool SawDigit = false;
+
+  for (; (c != end) && IsDigit(*c); ++c) {
+    SawDigit = true;
+    if (Mantissa || (*c != '0')) {
+      Mantissa = Mantissa * 10 + unsigned(*c - '0');
+      NSigDigits++;
+    }
+    if (NSigDigits > 19) {
+      return ParseDouble_strtod(begin, end, val);
+    }
+  }
+  if ((c != end) && (*c == '.')) {
+    ++c;
+    for (; (c != end) && IsDigit(*c); ++c) {
+      SawDigit = true;
+      if (Mantissa || (*c != '0')) {
+        Mantissa = Mantissa * 10 + unsigned(*c - '0');
+        NSigDigits++;
+      }
+      if (NSigDigits > 19) {
+        return ParseDouble_strtod(begin, end, val);
+      }
+      Exponent--;
+    }
+  }
+  if (!SawDigit) { // e.g. NaN/Inf, let strtod decide.
+    return ParseDouble_strtod(begin, end, val);
+  }
+  if ((c != end) && ((*c == 'E') || (*c == 'e'))) {
+    ++c;
+    bool NegExp = false;
+    if ((c != end) && ((*c == '-') || (*c == '+'))) {
+      NegExp = (*c == '-');
+      ++c;
+    }
+    if ((c == end) || !IsDigit(*c)) {
+      return ParseDouble_strtod(begin, end, val);
+    }
+    int ExplicitExponent = 0;
+    for (; (c != end) && IsDigit(*c); ++c) {
+      if (ExplicitExponent < 10000) {
+        ExplicitExponent = ExplicitExponent * 10 + int(*c - '0');
+      }
+    }
+    Exponent += NegExp ? -ExplicitExponent : ExplicitExponent;
+  }
+  if (c != end) {
+    return ParseDouble_strtod(begin, end, val);
+  }
+
+  if (!Mantissa) {
+    val = Neg ? -0.0 : 0.0;
+    return true;
+  }
+  if ((Mantissa > kMaxExactMantissa) || (Exponent > kMaxExactPowerOfTen) ||
+      (Exponent < -kMaxExactPowerOfTen)) {
+    return ParseDouble_strtod(begin, end, val);
+  }
+
+  // Both operands are exact, so the single rounding of the product/quotient
+  // is the correctly rounded result.
+  double dval = double(Mantissa);
+  if (Exponent < 0) {
+    dval /= kExactPowersOfTen[-Exponent];
+  } else {
+    dval *= kExactPowersOfTen[Exponent];
+  }
+  val = Neg ? -dval : dval;
+  return true;
+#else
+  return ParseDouble_strtod(begin, end, val);
+#endif
+}
+
+bool GetParticleLine(char const *begin, char const *end, GiBUUPartBlob &pblob) {
+  size_t const NExpectedColumns =
+      kNFinalEventsColumns + size_t(GiBUUToStdHepOpts::HaveProdChargeInfo);
+
+  Column cols[kMaxColumns];
+  if (SplitColumns(begin, end, cols) != NExpectedColumns) {
+    // try to fix known parsing error
+    if (SplitColumns(begin, end, cols, true) != NExpectedColumns) {
+      GiBUUDiagWarn(GiBUUDiagnostics::kMalformedLine,
+                    "Event had malformed particle line: \""
+                        << std::string(begin, end) << "\"");
+      pblob = GiBUUPartBlob();
+      return false;
+    }
+  }
+
+#define GIBUU_PARSE_COL(Parser, idx, target)                                   \
+  if (!Parser(cols[idx].begin, cols[idx].end, target)) {                       \
+    ThrowBadColumn(begin, end, cols[idx]);                                     \
+  }
+
+  GIBUU_PARSE_COL(ParseInt, 0, pblob.Run);
+  GIBUU_PARSE_COL(ParseInt, 1, pblob.EvNum);
+  GIBUU_PARSE_COL(ParseInt, 2, pblob.ID);
+  GIBUU_PARSE_COL(ParseInt, 3, pblob.Charge);
+  GIBUU_PARSE_COL(ParseDouble, 4, pblob.PerWeight);
+  GIBUU_PARSE_COL(ParseDouble, 5, pblob.Position[GiRooTracker::kStdHepIdxPx]);
+  GIBUU_PARSE_COL(ParseDouble, 6, pblob.Position[GiRooTracker::kStdHepIdxPy]);
+  GIBUU_PARSE_COL(ParseDouble, 7, pblob.Position[GiRooTracker::kStdHepIdxPz]);
+  GIBUU_PARSE_COL(ParseDouble, 8, pblob.FourMom[GiRooTracker::kStdHepIdxE]);
+  GIBUU_PARSE_COL(ParseDouble, 9, pblob.FourMom[GiRooTracker::kStdHepIdxPx]);
+  GIBUU_PARSE_COL(ParseDouble, 10, pblob.FourMom[GiRooTracker::kStdHepIdxPy]);
+  GIBUU_PARSE_COL(ParseDouble, 11, pblob.FourMom[GiRooTracker::kStdHepIdxPz]);
+  GIBUU_PARSE_COL(ParseLong, 12, pblob.History);
+  GIBUU_PARSE_COL(ParseInt, 13, pblob.Prodid);
+  GIBUU_PARSE_COL(ParseDouble, 14, pblob.EProbe);
+  if (GiBUUToStdHepOpts::HaveProdChargeInfo) {
+    GIBUU_PARSE_COL(ParseInt, 15, pblob.ProdCharge);
+  }
+
+#undef GIBUU_PARSE_COL
+
+  UDBVerbose("Parsed particle: " << pblob);
+
+  return true;
+}
+
+bool FinalEventsAssembler::AddLine(char const *begin, char const *end,
+                                   GiBUUEventBatch &Events) {
+  UDBVerbose("[LINE:" << LineNum << "]: " << std::string(begin, end));
+
+  unsigned long long const LineOffset = NBytes;
+  NBytes += (unsigned long long)(end - begin) + 1;
+
+  if (IsComment(begin, end)) { // Skip comments
+    return false;
+  }
+
+  GiBUUPartBlob part;
+  GetParticleLine(begin, end, part);
+  GiBUUTiming::Lap(GiBUUTiming::kParticleParse);
+
+  if ((part.PerWeight == 0) && (!GiBUUToStdHepOpts::HaveStruckNucleonInfo)) {
+    GiBUUDiagWarn(GiBUUDiagnostics::kZeroWeightParticle,
+                  "Found particle with 0 weight, but do not have "
+                  "initial state information enabled (-v -1 to silence this "
+                  "message).");
+  }
+
+  bool CompletedEvent = false;
+  if ((part.EvNum != LastEvNum) && LastEvNum) {
+    Events.Append(CurrEv);
+    CurrEv.Clear();
+    CompletedEvent = true;
+  }
+  if (CurrEv.Empty()) {
+    EventOffset = LineOffset;
+    if (Index) {
+      Index->AddEvent(part.Run, LineOffset);
+    }
+  }
+  part.ln = LineNum;
+  CurrEv.AddParticle(part, false);
+  LastEvNum = part.EvNum;
+  LastRun = part.Run;
+  LineNum++;
+  GiBUUTiming::Lap(GiBUUTiming::kEventAssembly);
+  return CompletedEvent;
+}
+
+bool FinalEventsAssembler::Finish(GiBUUEventBatch &Events) {
+  if (CurrEv.Empty()) {
+    return false;
+  }
+  Events.Append(CurrEv);
+  CurrEv.Clear();
+  LastEvNum = 0;
+  return true;
+}
+
+char const *FindNextEventBoundary(char const *from, char const *end) {
+  char const *lbegin = from;
+  if (*(from - 1) != '\n') { // Move to the start of the next line
+    lbegin = EndOfLine(from, end);
+    lbegin = (lbegin == end) ? end : (lbegin + 1);
+  }
+
+  Int_t LastEvNum = 0;
+  bool First = true;
+  while (lbegin < end) {
+    char const *lend = EndOfLine(lbegin, end);
+    if (!IsComment(lbegin, lend)) {
+      Int_t EvNum = PeekEvNum(lbegin, lend);
+      if (!First && (EvNum != LastEvNum) && LastEvNum) {
+        return lbegin;
+      }
+      LastEvNum = EvNum;
+      First = false;
+    }
+    lbegin = (lend == end) ? end : (lend + 1);
+  }
+  return end;
+}
+
+void ParseFinalEventsChunk(FinalEventsChunk &chunk) {
+  FinalEventsAssembler assembler;
+  if (chunk.BuildIndex) {
+    assembler.SetIndexBuilder(&chunk.Index);
+  }
+  char const *lbegin = chunk.begin;
+  GiBUUTiming::StartLap();
+  while (lbegin < chunk.end) {
+    char const *lend = EndOfLine(lbegin, chunk.end);
+    GiBUUTiming::Lap(GiBUUTiming::kLineRead);
+    assembler.AddLine(lbegin, lend, chunk.Events);
+    lbegin = (lend == chunk.end) ? chunk.end : (lend + 1);
+  }
+  assembler.Finish(chunk.Events);
+  chunk.NLines = assembler.GetNLines();
+}
+
+FinalEventsChunkParser::FinalEventsChunkParser(size_t NThreads)
+    : NRunning(0), Stopping(false) {
+  for (size_t t_it = 0; t_it < NThreads; ++t_it) {
+    Workers.push_back(std::thread(&FinalEventsChunkParser::Work, this));
+  }
+}
+
+FinalEventsChunkParser::~FinalEventsChunkParser() {
+  Cancel();
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    Stopping = true;
+  }
+  Queued.notify_all();
+  for (size_t t_it = 0; t_it < Workers.size(); ++t_it) {
+    Workers[t_it].join();
+  }
+}
+
+void FinalEventsChunkParser::Work() {
+  std::unique_lock<std::mutex> lock(Mutex);
+  for (;;) {
+    Queued.wait(lock, [this]() { return Stopping || !Queue.empty(); });
+    if (Queue.empty()) {
+      break;
+    }
+    FinalEventsChunk &chunk = *Queue.front();
+    Queue.pop_front();
+    NRunning++;
+    lock.unlock();
+    try {
+      ParseFinalEventsChunk(chunk);
+    } catch (...) {
+      chunk.Error = std::current_exception();
+    }
+    lock.lock();
+    chunk.Parsed = true;
+    NRunning--;
+    Done.notify_all();
+  }
+  lock.unlock();
+  GiBUUTiming::FinishThread("Parse workers");
+}
+
+void FinalEventsChunkParser::Submit(FinalEventsChunk &chunk) {
+  chunk.Parsed = false;
+  chunk.Error = std::exception_ptr();
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    Queue.push_back(&chunk);
+  }
+  Queued.notify_one();
+}
+
+void FinalEventsChunkParser::Wait(FinalEventsChunk &chunk) {
+  {
+    std::unique_lock<std::mutex> lock(Mutex);
+    Done.wait(lock, [&chunk]() { return chunk.Parsed; });
+  }
+  if (chunk.Error) {
+    std::exception_ptr Error = chunk.Error;
+    chunk.Error = std::exception_ptr();
+    std::rethrow_exception(Error);
+  }
+}
+
+void FinalEventsChunkParser::Cancel() {
+  std::unique_lock<std::mutex> lock(Mutex);
+  Queue.clear();
+  Done.wait(lock, [this]() { return !NRunning; });
+}
+
+size_t GetLesHouchesEvent(char const *begin, char const *end, Int_t EvNum,
+                          GiBUUEventBatch &Events) {
+  Column cols[kMaxColumns];
+
+  // Find the first and last non-blank lines, the event header and the final
+  // state lepton (or NDK kaon) line. Comments are skipped, apart from GiBUU's
+  // event information line.
+  char const *hbegin = begin, *hend = begin;
+  for (; hbegin < end; hbegin = (hend == end) ? end : (hend + 1)) {
+    hend = EndOfLine(hbegin, end);
+    if (!IsIndentedComment(hbegin, hend) && SplitColumns(hbegin, hend, cols)) {
+      break;
+    }
+  }
+  if (hbegin >= end) {
+    return 0;
+  }
+
+  char const *lbegin = end, *lend = end;
+  for (;;) {
+    lend = lbegin;
+    if ((lend != begin) && (*(lend - 1) == '\n')) {
+      --lend;
+    }
+    lbegin = lend;
+    while ((lbegin != begin) && (*(lbegin - 1) != '\n')) {
+      --lbegin;
+    }
+    size_t const NLineCols = SplitColumns(lbegin, lend, cols);
+    if ((NLineCols && (!IsIndentedComment(lbegin, lend) ||
+                       (NLineCols >= kNLesHouchesInfoColumns))) ||
+        (lbegin == hbegin)) {
+      break;
+    }
+  }
+
+  UDBVerbose("LH Event: " << std::string(hbegin, hend));
+
+#define GIBUU_PARSE_COL(Parser, idx, target)                                   \
+  if ((idx >= NCols) || !Parser(cols[idx].begin, cols[idx].end, target)) {     \
+    ThrowBadColumn(lbegin, lend, cols[(idx < NCols) ? idx : 0]);               \
+  }
+
+  size_t NCols = SplitColumns(lbegin, lend, cols);
+  Double_t Px, Py, Pz, E;
+
+  GiBUUPartBlob Lead;
+  Lead.Run = 1;
+  Lead.EvNum = EvNum;
+  Lead.ID = 0;
+  Lead.IDIsPDG = true;
+  // We have found the FS lepton kinematics in the event line, otherwise it
+  // might be an NDK event.
+  if (NCols >= kNLesHouchesInfoColumns) {
+    GIBUU_PARSE_COL(ParseInt, 2, Lead.Prodid);
+    GIBUU_PARSE_COL(ParseDouble, 3, Lead.PerWeight);
+    GIBUU_PARSE_COL(ParseDouble, 4, Lead.EProbe);
+    GIBUU_PARSE_COL(ParseDouble, 8, E);
+    GIBUU_PARSE_COL(ParseDouble, 9, Px);
+    GIBUU_PARSE_COL(ParseDouble, 10, Py);
+    GIBUU_PARSE_COL(ParseDouble, 11, Pz);
+  } else {
+    GIBUU_PARSE_COL(ParseDouble, 2, E);
+    GIBUU_PARSE_COL(ParseDouble, 3, Px);
+    GIBUU_PARSE_COL(ParseDouble, 4, Py);
+    GIBUU_PARSE_COL(ParseDouble, 5, Pz);
+  }
+  Lead.SetFourMom(Px, Py, Pz, E);
+  Events.AddParticle(Lead, true);
+  UDBVerbose("\t" << Lead);
+  size_t NParts = 1;
+
+  // Everything between the header and the last line is a final state hadron.
+  char const *const hadrend = lbegin;
+  for (lbegin = (hend == end) ? end : (hend + 1); lbegin < hadrend;
+       lbegin = (lend == end) ? end : (lend + 1)) {
+    lend = EndOfLine(lbegin, hadrend);
+    if (IsIndentedComment(lbegin, lend) ||
+        !(NCols = SplitColumns(lbegin, lend, cols))) {
+      continue;
+    }
+    GiBUUPartBlob FSHadr;
+    FSHadr.Run = 1;
+    FSHadr.EvNum = EvNum;
+    GIBUU_PARSE_COL(ParseInt, 0, FSHadr.ID);
+    GIBUU_PARSE_COL(ParseDouble, 6, Px);
+    GIBUU_PARSE_COL(ParseDouble, 7, Py);
+    GIBUU_PARSE_COL(ParseDouble, 8, Pz);
+    GIBUU_PARSE_COL(ParseDouble, 9, E);
+    FSHadr.SetFourMom(Px, Py, Pz, E);
+    FSHadr.IDIsPDG = true;
+
+    UDBVerbose("\t" << FSHadr);
+    Events.AddParticle(FSHadr, false);
+    NParts++;
+  }
+
+#undef GIBUU_PARSE_COL
+
+  return NParts;
+}
+
+} // namespace GiBUUParsing
@@ -0,0 +1,213 @@
+#ifndef SEEN_GIBUUToStdHep_PARSING_HXX
+#define SEEN_GIBUUToStdHep_PARSING_HXX
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Rtypes.h"
+
+#include "GiBUUToStdHep_Index.hxx"
+#include "GiBUUToStdHep_Utils.hxx"
+
+/// Allocation-free parsing of GiBUU text output.
+namespace GiBUUParsing {
+
+///\brief The number of columns in a FinalEvents.dat particle line without the
+/// patched-in production charge column.
+size_t const kNFinalEventsColumns = 15;
+
+///\brief The maximum number of columns that will be located on a single line.
+///
+/// Lines with more columns are still counted correctly, but only the first
+/// kMaxColumns are recorded.
+size_t const kMaxColumns = 32;
+
+///\brief A non-owning view of a single column in a line.
+struct Column {
+  char const *begin;
+  char const *end;
+};
+
+///\brief Splits [begin, end) on whitespace into at most kMaxColumns columns.
+///
+/// If SplitGluedNegatives is true, a '-' that is not preceded by an 'E' also
+/// starts a new column. This fixes up Fortran formatted output where a negative
+/// number has been printed directly after the previous column, e.g.
+/// "1.0E+00-2.0E+00".
+///
+/// Returns the total number of columns found, which may be larger than
+/// kMaxColumns.
+size_t SplitColumns(char const *begin, char const *end, Column *Columns,
+                    bool SplitGluedNegatives = false);
+
+///\brief Parses a decimal integer from [begin, end).
+///
+/// Returns false if the whole range is not a valid integer.
+bool ParseLong(char const *begin, char const *end, Long_t &val);
+///\brief Parses a decimal integer from [begin, end).
+///
+/// Returns false if the whole range is not a valid integer that fits in an
+/// Int_t.
+bool ParseInt(char const *begin, char const *end, Int_t &val);
+
+///\brief Parses a floating point number from [begin, end).
+///
+/// Numbers with at most 19 significant digits and a decimal exponent within
+/// +/-22 are converted exactly with a single floating point operation, others
+/// fall back to strtod. The result is always identical to strtod's correctly
+/// rounded conversion.
+///
+/// Returns false if the whole range is not a valid number.
+bool ParseDouble(char const *begin, char const *end, Double_t &val);
+
+///\brief Parses a FinalEvents.dat particle line in [begin, end) into pblob.
+///
+/// Returns false if the line had an unexpected number of columns, in which
+/// case pblob is left in its default state (EvNum == 0) so that the event is
+/// later skipped.
+///
+///\note Throws std::invalid_argument if one of the columns could not be
+/// parsed as a number.
+bool GetParticleLine(char const *begin, char const *end, GiBUUPartBlob &pblob);
+
+///\brief Groups consecutive FinalEvents.dat particle lines into events.
+///
+/// An event is completed whenever the event number changes from one
+/// particle line to the next. Comment lines are skipped.
+class FinalEventsAssembler {
+  GiBUUEventBatch CurrEv;
+  Int_t LastEvNum;
+  Int_t LastRun;
+  size_t LineNum;
+  unsigned long long NBytes;
+  unsigned long long EventOffset;
+  GiBUUIndex::FinalEventsIndexBuilder *Index;
+
+ public:
+  FinalEventsAssembler()
+      : CurrEv(), LastEvNum(0), LastRun(0), LineNum(0), NBytes(0),
+        EventOffset(0), Index(NULL) {}
+
+  ///\brief Sets the offset of the first line that will be passed to AddLine,
+  /// from which event offsets are counted.
+  void SetStartOffset(unsigned long long Offset) { NBytes = Offset; }
+
+  ///\brief Records the start of each event in Index, at its offset from the
+  /// first line passed to AddLine.
+  void SetIndexBuilder(GiBUUIndex::FinalEventsIndexBuilder *Builder) {
+    Index = Builder;
+  }
+
+  ///\brief Parses a line, returns true if it completed the previous event,
+  /// which is appended to Events.
+  bool AddLine(char const *begin, char const *end, GiBUUEventBatch &Events);
+  ///\brief Appends any partially assembled event to Events, returns true if
+  /// there was one.
+  bool Finish(GiBUUEventBatch &Events);
+
+  ///\brief The number of non-comment lines seen so far.
+  size_t GetNLines() const { return LineNum; }
+
+  ///\brief The run number of the last non-comment line seen, which at the end
+  /// of a file is the number of runs in it.
+  Int_t GetLastRun() const { return LastRun; }
+
+  ///\brief The offset of the end of the last line seen, including its
+  /// terminator.
+  unsigned long long GetNBytes() const { return NBytes; }
+
+  ///\brief The offset of the first line of the event being assembled, i.e.
+  /// of the first event that has not been appended to an event batch.
+  unsigned long long GetEventOffset() const { return EventOffset; }
+};
+
+///\brief Finds the first line at or after from, that starts a new event.
+///
+/// from must be greater than the start of the file. A line starts a new event
+/// if FinalEventsAssembler would complete an event upon reading it, so that
+/// assembling the events either side of the boundary separately gives the
+/// same events as assembling the whole file serially.
+///
+/// Returns end if no boundary was found.
+char const *FindNextEventBoundary(char const *from, char const *end);
+
+///\brief A block of events assembled from a byte range of a FinalEvents.dat
+/// file.
+struct FinalEventsChunk {
+  char const *begin;
+  char const *end;
+  GiBUUEventBatch Events;
+  size_t NLines;
+  ///\brief Whether to fill Index with the events in the chunk.
+  bool BuildIndex;
+  GiBUUIndex::FinalEventsIndexBuilder Index;
+  ///\brief Set by FinalEventsChunkParser once the chunk has been parsed.
+  bool Parsed;
+  std::exception_ptr Error;
+};
+
+///\brief Assembles the events in [chunk.begin, chunk.end) into chunk.Events.
+///
+/// Line numbers are relative to the start of the chunk, and if
+/// chunk.BuildIndex is set, index offsets are relative to the start of the
+/// range passed to chunk.Index.Reset.
+void ParseFinalEventsChunk(FinalEventsChunk &chunk);
+
+///\brief A pool of threads that parse the FinalEventsChunks handed to it with
+/// ParseFinalEventsChunk.
+///
+/// The threads are started once and kept for the lifetime of the pool, so
+/// that a file is parsed by feeding them one chunk after another rather than
+/// by starting threads for each group of chunks.
+class FinalEventsChunkParser {
+  std::vector<std::thread> Workers;
+  std::mutex Mutex;
+  std::condition_variable Queued;
+  std::condition_variable Done;
+  std::deque<FinalEventsChunk *> Queue;
+  size_t NRunning;
+  bool Stopping;
+
+  FinalEventsChunkParser(FinalEventsChunkParser const &);
+  FinalEventsChunkParser &operator=(FinalEventsChunkParser const &);
+
+  void Work();
+
+ public:
+  explicit FinalEventsChunkParser(size_t NThreads);
+  ///\brief Drops any chunks that are still queued and joins the threads.
+  ~FinalEventsChunkParser();
+
+  ///\brief Queues chunk to be parsed. It must not be touched until Wait or
+  /// Cancel has returned.
+  void Submit(FinalEventsChunk &chunk);
+  ///\brief Waits for chunk to be parsed, and rethrows anything that parsing
+  /// it threw.
+  void Wait(FinalEventsChunk &chunk);
+  ///\brief Drops any chunks that are still queued and waits for those being
+  /// parsed to finish.
+  void Cancel();
+};
+
+///\brief Parses the content of a single Les Houches <event> block in
+/// [begin, end), appending it to Events as event EvNum.
+///
+/// The last non-blank line is expected to hold the final state lepton
+/// kinematics, or for NDK events, the pre-FSI kaon. Lines between the header
+/// and the last line are final state hadrons.
+///
+/// Returns the number of particles appended, 0 if the block was blank.
+///
+///\note Throws std::invalid_argument if a required column is missing or could
+/// not be parsed as a number.
+size_t GetLesHouchesEvent(char const *begin, char const *end, Int_t EvNum,
+                          GiBUUEventBatch &Events);
+
+} // namespace GiBUUParsing
+
+#endif
@@ -0,0 +1,255 @@
+#ifndef SEEN_GIBUUToStdHep_PIPELINE_HXX
+#define SEEN_GIBUUToStdHep_PIPELINE_HXX
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "GiBUUToStdHep_Checkpoint.hxx"
+#include "GiBUUToStdHep_Utils.hxx"
+
+#include "GiRooTracker.hxx"
+
+///\brief A fixed-capacity, single-producer single-consumer queue used to pass
+/// batches between the stages of the conversion pipeline.
+///
+/// Push blocks while the queue is full and Pop blocks while it is empty, both
+/// return false once the queue has been closed. After Close, Pop continues to
+/// return any items already in the queue, so that a producer can signal the
+/// end of its output by closing the queue.
+///
+/// The ring itself is lock-free. A blocked Push or Pop spins briefly, as the
+/// other stage is often about to catch up, and then sleeps on a condition
+/// variable until it is notified by the other end or by Close.
+template <typename T> class BoundedQueue {
+  std::vector<T> Ring;
+  size_t const Capacity;
+  std::atomic<size_t> Head; // Next slot to read, only written by the consumer.
+  std::atomic<size_t> Tail; // Next slot to write, only written by the producer.
+  std::atomic<bool> Closed;
+
+  std::mutex WaitMutex;
+  std::condition_variable NotFull;
+  std::condition_variable NotEmpty;
+
+  static int const kSpinTries = 64;
+
+  BoundedQueue(BoundedQueue const &);
+  BoundedQueue &operator=(BoundedQueue const &);
+
+  bool IsFull(size_t next) const {
+    return next == Head.load(std::memory_order_acquire);
+  }
+  bool IsEmpty(size_t head) const {
+    return head == Tail.load(std::memory_order_acquire);
+  }
+  // Taking the mutex orders the notification after the other end has either
+  // seen the change or started waiting, so that it cannot be missed.
+  void Notify(std::condition_variable &cv) {
+    { std::lock_guard<std::mutex> lock(WaitMutex); }
+    cv.notify_one();
+  }
+
+ public:
+  BoundedQueue(size_t capacity)
+      : Ring(capacity + 1), Capacity(capacity + 1), Head(0), Tail(0),
+        Closed(false) {}
+
+  bool Push(T item) {
+    size_t const tail = Tail.load(std::memory_order_relaxed);
+    size_t const next = (tail + 1) % Capacity;
+    for (int s_it = 0; IsFull(next) && (s_it < kSpinTries); ++s_it) {
+      if (Closed.load(std::memory_order_acquire)) {
+        return false;
+      }
+      std::this_thread::yield();
+    }
+    if (IsFull(next)) {
+      std::unique_lock<std::mutex> lock(WaitMutex);
+      NotFull.wait(lock, [&] {
+        return !IsFull(next) || Closed.load(std::memory_order_acquire);
+      });
+    }
+    if (Closed.load(std::memory_order_acquire)) {
+      return false;
+    }
+    Ring[tail] = item;
+    Tail.store(next, std::memory_order_release);
+    Notify(NotEmpty);
+    return true;
+  }
+
+  bool Pop(T &item) {
+    size_t const head = Head.load(std::memory_order_relaxed);
+    for (int s_it = 0; IsEmpty(head) && (s_it < kSpinTries); ++s_it) {
+      if (Closed.load(std::memory_order_acquire)) {
+        break;
+      }
+      std::this_thread::yield();
+    }
+    if (IsEmpty(head)) {
+      std::unique_lock<std::mutex> lock(WaitMutex);
+      NotEmpty.wait(lock, [&] {
+        return !IsEmpty(head) || Closed.load(std::memory_order_acquire);
+      });
+      // Re-check, the producer may have pushed before closing.
+      if (IsEmpty(head)) {
+        return false;
+      }
+    }
+    item = Ring[head];
+    Head.store((head + 1) % Capacity, std::memory_order_release);
+    Notify(NotFull);
+    return true;
+  }
+
+  ///\brief Pushes item if there is space, without waiting.
+  bool TryPush(T item) {
+    size_t const tail = Tail.load(std::memory_order_relaxed);
+    size_t const next = (tail + 1) % Capacity;
+    if (IsFull(next) || Closed.load(std::memory_order_acquire)) {
+      return false;
+    }
+    Ring[tail] = item;
+    Tail.store(next, std::memory_order_release);
+    Notify(NotEmpty);
+    return true;
+  }
+
+  ///\brief Pops an item if there is one, without waiting.
+  bool TryPop(T &item) {
+    size_t const head = Head.load(std::memory_order_relaxed);
+    if (IsEmpty(head)) {
+      return false;
+    }
+    item = Ring[head];
+    Head.store((head + 1) % Capacity, std::memory_order_release);
+    Notify(NotFull);
+    return true;
+  }
+
+  void Close() {
+    {
+      std::lock_guard<std::mutex> lock(WaitMutex);
+      Closed.store(true, std::memory_order_release);
+    }
+    NotFull.notify_all();
+    NotEmpty.notify_all();
+  }
+};
+
+///\brief Passes heap-allocated batches from one pipeline stage to the next,
+/// and returns emptied batches to the producer so that their storage is
+/// reused rather than reallocated for every batch.
+///
+/// T must be default constructible and provide Clear().
+template <typename T> class BatchChannel {
+  BoundedQueue<T *> Full;
+  BoundedQueue<T *> Spare;
+
+  BatchChannel(BatchChannel const &);
+  BatchChannel &operator=(BatchChannel const &);
+
+ public:
+  BatchChannel(size_t depth) : Full(depth), Spare(depth + 2) {}
+
+  ///\brief Producer: gets an empty batch.
+  T *Acquire() {
+    T *batch;
+    if (Spare.TryPop(batch)) {
+      return batch;
+    }
+    return new T();
+  }
+  ///\brief Producer: passes batch to the consumer, blocking while the channel
+  /// is full. Returns false, and deletes batch, if the channel is closed.
+  bool Push(T *batch) {
+    if (!Full.Push(batch)) {
+      delete batch;
+      return false;
+    }
+    return true;
+  }
+  ///\brief Producer or consumer: no more batches will be passed.
+  void Close() { Full.Close(); }
+
+  ///\brief Consumer: gets the next batch, returns false once the channel has
+  /// been closed and drained.
+  bool Pop(T *&batch) { return Full.Pop(batch); }
+  ///\brief Consumer: returns a batch for reuse.
+  void Release(T *batch) {
+    batch->Clear();
+    if (!Spare.TryPush(batch)) {
+      delete batch;
+    }
+  }
+
+  ~BatchChannel() {
+    Full.Close();
+    T *batch;
+    while (Full.Pop(batch)) {
+      delete batch;
+    }
+    while (Spare.TryPop(batch)) {
+      delete batch;
+    }
+  }
+};
+
+///\brief Where in the input the events of a batch were read from, and so
+/// where a conversion can be resumed from once they have been written.
+struct BatchOrigin {
+  BatchOrigin()
+      : InputFile(0), Resumable(false), EndOfFile(false), NextOffset(0) {}
+
+  ///\brief The index of the input file in GiBUUToStdHepOpts::InpFNames.
+  size_t InputFile;
+  ///\brief Whether the conversion can be resumed from immediately after the
+  /// events of the batch.
+  bool Resumable;
+  ///\brief Whether no more events are read from InputFile after this batch.
+  bool EndOfFile;
+  ///\brief The byte offset in the uncompressed contents of InputFile of the
+  /// first event after this batch.
+  unsigned long long NextOffset;
+};
+
+///\brief A batch of parsed, but not yet converted, events from a single input
+/// file.
+struct ParsedEventBatch {
+  ParsedEventBatch()
+      : Events(), FileNumber(0), NRunsInFile(1), HaveStruckNucleonInfo(false),
+        HaveProdChargeInfo(false), Origin() {}
+
+  GiBUUEventBatch Events;
+  ///\brief The file options index that these events should be converted with.
+  size_t FileNumber;
+  size_t NRunsInFile;
+  ///\brief Copied from GiBUUToStdHepOpts when the batch was parsed, as the Les
+  /// Houches reader disables these for the files that it reads.
+  bool HaveStruckNucleonInfo;
+  bool HaveProdChargeInfo;
+  BatchOrigin Origin;
+
+  void Clear() { Events.Clear(); }
+};
+
+///\brief A batch of converted events, and what the writing stage needs to
+/// know about where they came from.
+struct ConvertedEventBatch {
+  ConvertedEventBatch() : Events(), NRunsInFile(1), Origin(), Hists() {}
+
+  GiRooTrackerBatch Events;
+  size_t NRunsInFile;
+  BatchOrigin Origin;
+  ///\brief The flux-weighted histograms once these events had been
+  /// converted, only kept while checkpoints are being taken.
+  std::vector<GiBUUCheckpoint::HistState> Hists;
+
+  void Clear() { Events.Clear(); }
+};
+
+#endif
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "LUtils/Debugging.hxx"
+
+#include "GiBUUToStdHep_CLIOpts.hxx"
+#include "GiBUUToStdHep_Input.hxx"
+#include "GiBUUToStdHep_Progress.hxx"
+
+namespace GiBUUProgress {
+
+namespace {
+typedef std::chrono::steady_clock Clock;
+
+// The throughput is averaged over this many of the most recent reports, so
+// that the ETA follows changes in the event mix between files without jumping
+// about with every batch.
+size_t const kRateWindow = 6;
+
+struct Sample {
+  Clock::time_point Time;
+  unsigned long long Bytes;
+};
+
+std::vector<unsigned long long> FileSizes;
+unsigned long long TotalBytes = 0;
+// The input consumed before the conversion was resumed.
+unsigned long long StartBytes = 0;
+Clock::time_point StartTime;
+
+// Only written by the parsing stage.
+unsigned long long CompletedFilesBytes = 0;
+std::atomic<size_t> CurrentFile(0);
+std::atomic<unsigned long long> BytesRead(0);
+std::atomic<unsigned long long> EventsWritten(0);
+
+std::thread Reporter;
+std::mutex ReporterMutex;
+std::condition_variable ReporterWake;
+bool Stopping = false;
+
+std::string FormatDuration(double Seconds) {
+  long s = long(Seconds + 0.5);
+  std::stringstream ss("");
+  ss << (s / 3600) << ":" << std::setfill('0') << std::setw(2)
+     << ((s / 60) % 60) << ":" << std::setw(2) << (s % 60);
+  return ss.str();
+}
+
+double Seconds(Clock::time_point const &begin, Clock::time_point const &end) {
+  return std::chrono::duration<double>(end - begin).count();
+}
+
+void Print(std::deque<Sample> &Samples) {
+  Sample now;
+  now.Time = Clock::now();
+  now.Bytes = BytesRead.load(std::memory_order_relaxed);
+  Samples.push_back(now);
+  if (Samples.size() > kRateWindow) {
+    Samples.pop_front();
+  }
+
+  double const Window = Seconds(Samples.front().Time, now.Time);
+  double const Rate =
+      (Window > 0) ? (double(now.Bytes - Samples.front().Bytes) / Window) : 0;
+
+  std::stringstream ss("");
+  ss << "Progress: " << std::fixed << std::setprecision(1);
+  if (TotalBytes) {
+    ss << (100.0 * double(now.Bytes) / double(TotalBytes)) << "% ("
+       << (double(now.Bytes) / 1E6) << "/" << (double(TotalBytes) / 1E6)
+       << " MB)";
+  } else {
+    ss << (double(now.Bytes) / 1E6) << " MB";
+  }
+  ss << ", file " << (CurrentFile.load(std::memory_order_relaxed) + 1) << "/"
+     << FileSizes.size() << ", " << (Rate / 1E6) << " MB/s, "
+     << EventsWritten.load(std::memory_order_relaxed) << " events written";
+  if (TotalBytes && (Rate > 0) && (now.Bytes < TotalBytes)) {
+    ss << ", ETA " << FormatDuration(double(TotalBytes - now.Bytes) / Rate);
+  }
+  UDBLog(ss.str());
+}
+
+void RunReporter() {
+  std::chrono::duration<double> const Interval(
+      GiBUUToStdHepOpts::ProgressInterval);
+  std::deque<Sample> Samples;
+  Sample first;
+  first.Time = StartTime;
+  first.Bytes = StartBytes;
+  Samples.push_back(first);
+
+  std::unique_lock<std::mutex> lock(ReporterMutex);
+  while (!ReporterWake.wait_for(lock, Interval, []() { return Stopping; })) {
+    Print(Samples);
+  }
+}
+} // namespace
+
+void Start(size_t FirstFile, unsigned long long FirstFileOffset) {
+  FileSizes.clear();
+  TotalBytes = 0;
+  CompletedFilesBytes = 0;
+  for (size_t f_it = 0; f_it < GiBUUToStdHepOpts::InpFNames.size(); ++f_it) {
+    FileSizes.push_back(GetInputFileSize(GiBUUToStdHepOpts::InpFNames[f_it]));
+    TotalBytes += FileSizes.back();
+    if (f_it < FirstFile) {
+      CompletedFilesBytes += FileSizes.back();
+    }
+  }
+  CurrentFile = FirstFile;
+  StartBytes = CompletedFilesBytes;
+  // The offset into a compressed file says little about how much of the file
+  // on disk has been consumed.
+  if ((FirstFile < FileSizes.size()) &&
+      (GetInputCompression(GiBUUToStdHepOpts::InpFNames[FirstFile]) ==
+       kUncompressed)) {
+    StartBytes += std::min(FirstFileOffset, FileSizes[FirstFile]);
+  }
+  BytesRead = StartBytes;
+  EventsWritten = 0;
+  StartTime = Clock::now();
+
+  if (GiBUUToStdHepOpts::ProgressInterval <= 0) {
+    return;
+  }
+  Stopping = false;
+  Reporter = std::thread(RunReporter);
+}
+
+void StartFile(size_t FileIndex) {
+  // A resumed file has already been consumed up to where it is resumed from.
+  if (BytesRead.load(std::memory_order_relaxed) > CompletedFilesBytes) {
+    return;
+  }
+  CurrentFile.store(FileIndex, std::memory_order_relaxed);
+  SetFileBytesRead(0);
+}
+
+void SetFileBytesRead(unsigned long long NBytes) {
+  size_t const f_it = CurrentFile.load(std::memory_order_relaxed);
+  // Readers count the line endings that they consume, which may not match
+  // the file on disk exactly, e.g. for a missing final newline.
+  if ((f_it < FileSizes.size()) && (NBytes > FileSizes[f_it])) {
+    NBytes = FileSizes[f_it];
+  }
+  BytesRead.store(CompletedFilesBytes + NBytes, std::memory_order_relaxed);
+}
+
+void FinishFile() {
+  size_t const f_it = CurrentFile.load(std::memory_order_relaxed);
+  if (f_it < FileSizes.size()) {
+    CompletedFilesBytes += FileSizes[f_it];
+  }
+  BytesRead.store(CompletedFilesBytes, std::memory_order_relaxed);
+}
+
+void AddEventsWritten(size_t N) {
+  EventsWritten.fetch_add(N, std::memory_order_relaxed);
+}
+
+void Stop() {
+  if (!Reporter.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(ReporterMutex);
+    Stopping = true;
+  }
+  ReporterWake.notify_one();
+  Reporter.join();
+
+  double const Elapsed = Seconds(StartTime, Clock::now());
+  unsigned long long const Bytes = BytesRead.load() - StartBytes;
+  std::stringstream ss("");
+  ss << "Progress: read " << std::fixed << std::setprecision(1)
+     << (double(Bytes) / 1E6) << " MB from " << FileSizes.size()
+     << " file(s) in " << FormatDuration(Elapsed) << " ("
+     << ((Elapsed > 0) ? (double(Bytes) / 1E6 / Elapsed) : 0)
+     << " MB/s), " << EventsWritten.load() << " events written.";
+  UDBLog(ss.str());
+}
+
+} // namespace GiBUUProgress
@@ -0,0 +1,45 @@
+#ifndef SEEN_GIBUUToStdHep_PROGRESS_HXX
+#define SEEN_GIBUUToStdHep_PROGRESS_HXX
+
+#include <cstddef>
+
+///\brief Periodic progress reporting against the total size of the input
+/// files.
+///
+/// The parsing stage publishes how far through the current file it has read,
+/// and the writing stage how many events it has written. A reporter thread
+/// wakes every GiBUUToStdHepOpts::ProgressInterval seconds and prints the
+/// fraction of the input consumed, the recent throughput and an estimate of
+/// the time remaining. Publishing is a relaxed atomic store, so it is cheap
+/// enough to leave on.
+namespace GiBUUProgress {
+
+///\brief Sums the sizes of GiBUUToStdHepOpts::InpFNames and, if the interval
+/// is positive, starts the reporter thread.
+///
+/// A resumed conversion starts FirstFileOffset bytes into the uncompressed
+/// contents of input file FirstFile, and the input before that is counted as
+/// already consumed, but not towards the throughput.
+void Start(size_t FirstFile = 0, unsigned long long FirstFileOffset = 0);
+
+///\brief Marks the start of reading input file FileIndex. Called by the
+/// parsing stage only.
+void StartFile(size_t FileIndex);
+
+///\brief Sets the number of bytes of the current input file that have been
+/// consumed. Called by the parsing stage only.
+void SetFileBytesRead(unsigned long long NBytes);
+
+///\brief Marks the current input file as completely consumed, whatever its
+/// reader reported.
+void FinishFile();
+
+///\brief Adds N to the number of events written to the output tree.
+void AddEventsWritten(size_t N);
+
+///\brief Stops the reporter thread and prints a final progress line.
+void Stop();
+
+} // namespace GiBUUProgress
+
+#endif
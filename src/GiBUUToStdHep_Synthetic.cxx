@@ -0,0 +1,392 @@
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "GiBUUToStdHep_Synthetic.hxx"
+#include "GiBUUToStdHep_Utils.hxx"
+
+namespace GiBUUSynthetic {
+
+namespace {
+
+// A 64 bit LCG, rather than <random>, so that the output does not depend on
+// the standard library implementation.
+class Random {
+  unsigned long long State;
+
+ public:
+  Random(unsigned long Seed) : State(Seed) { Uniform(); }
+
+  // Uniform in [0, 1).
+  double Uniform() {
+    State = (State * 6364136223846793005ULL) + 1442695040888963407ULL;
+    return double(State >> 11) * (1.0 / 9007199254740992.0);
+  }
+  size_t Index(size_t N) { return size_t(Uniform() * double(N)); }
+  double Range(double Low, double High) {
+    return Low + ((High - Low) * Uniform());
+  }
+};
+
+struct Particle {
+  int ID;
+  int Charge;
+  double Mass;
+  double Position[3];
+  ///\brief Px, Py, Pz, E
+  double P4[4];
+  long History;
+};
+
+struct Event {
+  int Prodid;
+  int ProdCharge;
+  double Weight;
+  double EProbe;
+  ///\brief The final state lepton, or the pre-FSI kaon for NDK events.
+  Particle Lead;
+  Particle StruckNucleon;
+  std::vector<Particle> Hadrons;
+};
+
+// GiBUU particle code, relative frequency, mass in GeV.
+struct HadronSpecies {
+  int ID;
+  double Frequency;
+  double Mass;
+  int MinCharge;
+  int MaxCharge;
+};
+HadronSpecies const kHadronMix[] = {
+    {1, 0.50, 0.93827, 0, 1},   // N
+    {101, 0.38, 0.13957, -1, 1}, // pi
+    {999, 0.04, 0, 0, 0},       // photon
+    {102, 0.03, 0.54786, 0, 0}, // eta
+    {110, 0.03, 0.49368, 0, 1}, // K
+    {32, 0.02, 1.11568, 0, 0},  // Lambda
+};
+size_t const kNHadronSpecies = sizeof(kHadronMix) / sizeof(kHadronMix[0]);
+
+// Reaction code, relative frequency. 3 stands in for all of the higher
+// resonances, whose code is then picked uniformly from 3-31.
+struct ReactionFrequency {
+  int Prodid;
+  double Frequency;
+};
+ReactionFrequency const kReactionMix[] = {
+    {1, 0.40},  // QE
+    {2, 0.22},  // Delta
+    {3, 0.05},  // Higher resonances
+    {32, 0.03}, // 1pi background
+    {33, 0.02}, // 1pi background
+    {34, 0.15}, // DIS
+    {35, 0.08}, // 2p2h QE
+    {36, 0.04}, // 2p2h Delta
+    {37, 0.01}, // 2pi background
+};
+size_t const kNReactions = sizeof(kReactionMix) / sizeof(kReactionMix[0]);
+
+double const kNucleonMass = 0.93827;
+double const kKaonMass = 0.49368;
+// The largest number of hadrons that still fits in the output arrays.
+size_t const kMaxHadrons = 90;
+
+class EventGenerator {
+  Config const &cfg;
+  Random rng;
+  Int_t EvNum;
+
+  void SetMomentum(Particle &part, double PMax) {
+    double const P = rng.Range(0.02, PMax);
+    double const CosTheta = rng.Range(-1, 1);
+    double const SinTheta = std::sqrt(1 - (CosTheta * CosTheta));
+    double const Phi = rng.Range(0, 6.283185307179586);
+    part.P4[0] = P * SinTheta * std::cos(Phi);
+    part.P4[1] = P * SinTheta * std::sin(Phi);
+    part.P4[2] = P * CosTheta;
+    part.P4[3] = std::sqrt((P * P) + (part.Mass * part.Mass));
+  }
+
+  void SetPosition(Particle &part) {
+    for (int i = 0; i < 3; ++i) {
+      part.Position[i] = rng.Range(-6, 6);
+    }
+  }
+
+  void Make(Particle &part, int ID, int Charge, double Mass) {
+    part.ID = ID;
+    part.Charge = Charge;
+    part.Mass = Mass;
+    part.History = 0;
+    SetPosition(part);
+  }
+
+  int PickProdid() {
+    double u = rng.Uniform();
+    size_t r_it = 0;
+    for (; r_it < (kNReactions - 1); ++r_it) {
+      if (u < kReactionMix[r_it].Frequency) {
+        break;
+      }
+      u -= kReactionMix[r_it].Frequency;
+    }
+    int const Prodid = kReactionMix[r_it].Prodid;
+    return (Prodid == 3) ? int(3 + rng.Index(29)) : Prodid;
+  }
+
+  // The resonance charges that GiBUU2NeutReacCode accepts for this probe.
+  int PickResonanceCharge() {
+    bool const Second = (rng.Uniform() < 0.5);
+    if ((cfg.EventMode == Config::kNeutrino) && cfg.IsCC) {
+      return (cfg.ProbePDG > 0) ? (Second ? 2 : 1) : (Second ? -1 : 0);
+    }
+    return Second ? 1 : 0;
+  }
+
+  // History codes are Generation * 1E6 + Parent2 * 1E3 + Parent1, or
+  // -(Generation * 1E6 + ThreeBodyCode) for three-body processes.
+  long PickHistory(int Prodid) {
+    double const u = rng.Uniform();
+    if (u < 0.7) {
+      return 1000000L + (((Prodid >= 2) && (Prodid <= 31)) ? Prodid : 0);
+    }
+    long const Gen = 2 + long(rng.Index(3));
+    if (u < 0.95) {
+      static int const Parents[] = {1, 101, 2};
+      return (Gen * 1000000L) + (Parents[rng.Index(3)] * 1000L) +
+             Parents[rng.Index(3)];
+    }
+    return -((Gen * 1000000L) + 1 + long(rng.Index(5)));
+  }
+
+  size_t PickMultiplicity() {
+    // Roughly exponential about the mean, with at least one hadron.
+    double const N =
+        1 - (std::log(1 - rng.Uniform()) * (cfg.MeanMultiplicity - 1));
+    return (N > double(kMaxHadrons)) ? kMaxHadrons : size_t(N);
+  }
+
+  void MakeLepton(Event &ev) {
+    if (cfg.EventMode == Config::kElectron) {
+      Make(ev.Lead, 901, -1, 0.000511);
+    } else {
+      int const Flavour = std::abs(cfg.ProbePDG);
+      int const Sign = (cfg.ProbePDG > 0) ? 1 : -1;
+      if (cfg.IsCC) {
+        Make(ev.Lead, (Flavour == 12) ? 901 : 902, -Sign,
+             (Flavour == 12) ? 0.000511 : 0.10566);
+      } else {
+        Make(ev.Lead, Sign * ((Flavour == 12) ? 911 : 912), 0, 0);
+      }
+    }
+    SetMomentum(ev.Lead, 0.9 * ev.EProbe);
+  }
+
+  void MakeHadron(Particle &part, int Prodid) {
+    double u = rng.Uniform();
+    size_t s_it = 0;
+    for (; s_it < (kNHadronSpecies - 1); ++s_it) {
+      if (u < kHadronMix[s_it].Frequency) {
+        break;
+      }
+      u -= kHadronMix[s_it].Frequency;
+    }
+    HadronSpecies const &species = kHadronMix[s_it];
+    Make(part, species.ID,
+         species.MinCharge +
+             int(rng.Index(size_t(species.MaxCharge - species.MinCharge + 1))),
+         species.Mass);
+    part.History = PickHistory(Prodid);
+  }
+
+ public:
+  EventGenerator(Config const &config)
+      : cfg(config), rng(config.Seed), EvNum(0) {}
+
+  Int_t GetEvNum() const { return EvNum; }
+
+  void Next(Event &ev) {
+    EvNum++;
+    ev.Hadrons.clear();
+    ev.Weight = 1E-3 * rng.Range(0.05, 2);
+    ev.ProdCharge = 0;
+
+    if (cfg.EventMode == Config::kNDK) {
+      ev.Prodid = 0;
+      ev.EProbe = 0;
+      Make(ev.Lead, 110, 1, kKaonMass);
+      SetMomentum(ev.Lead, 0.34);
+      ev.Hadrons.resize(1 + rng.Index(size_t(cfg.MeanMultiplicity) + 1));
+      Make(ev.Hadrons[0], 110, 1, kKaonMass);
+      SetMomentum(ev.Hadrons[0], 0.4);
+      for (size_t h_it = 1; h_it < ev.Hadrons.size(); ++h_it) {
+        Make(ev.Hadrons[h_it], 1, int(rng.Index(2)), kNucleonMass);
+        SetMomentum(ev.Hadrons[h_it], 0.6);
+      }
+      return;
+    }
+
+    ev.EProbe = (cfg.EventMode == Config::kElectron)
+                    ? cfg.EProbe
+                    : (cfg.EProbe * rng.Range(0.2, 1.8));
+    ev.Prodid = PickProdid();
+    if ((ev.Prodid >= 2) && (ev.Prodid <= 31)) {
+      ev.ProdCharge = PickResonanceCharge();
+    }
+
+    MakeLepton(ev);
+
+    Make(ev.StruckNucleon, 1, int(rng.Index(2)), kNucleonMass);
+    SetMomentum(ev.StruckNucleon, 0.25);
+
+    ev.Hadrons.resize(PickMultiplicity());
+    for (size_t h_it = 0; h_it < ev.Hadrons.size(); ++h_it) {
+      MakeHadron(ev.Hadrons[h_it], ev.Prodid);
+      SetMomentum(ev.Hadrons[h_it], 0.8 * ev.EProbe);
+    }
+  }
+};
+
+size_t AppendFinalEventsLine(std::string &out, Config const &cfg, int Run,
+                             int EvNum, Particle const &part, double Weight,
+                             Event const &ev) {
+  char buf[256];
+  int len = std::snprintf(
+      buf, sizeof(buf),
+      "%8d%9d%6d%4d%15.6E%11.4f%11.4f%11.4f%13.6f%13.6f%13.6f%13.6f%12ld%5d%"
+      "13.6f",
+      Run, EvNum, part.ID, part.Charge, Weight, part.Position[0],
+      part.Position[1], part.Position[2], part.P4[3], part.P4[0], part.P4[1],
+      part.P4[2], part.History, ev.Prodid, ev.EProbe);
+  if (cfg.ProdChargeInfo) {
+    len += std::snprintf(buf + len, sizeof(buf) - size_t(len), "%4d",
+                         ev.ProdCharge);
+  }
+  out.append(buf, size_t(len));
+  out += '\n';
+  return size_t(len) + 1;
+}
+
+size_t AppendLesHouchesLine(std::string &out, Particle const &part) {
+  char buf[256];
+  int const len = std::snprintf(
+      buf, sizeof(buf),
+      " %8d%5d%5d%5d%5d%5d%18.10E%18.10E%18.10E%18.10E%18.10E%4.1f%5.1f\n",
+      GiBUUUtils::GiBUUToPDG(part.ID, part.Charge), 1, 0, 0, 0, 0, part.P4[0],
+      part.P4[1], part.P4[2], part.P4[3], part.Mass, 0.0, 9.0);
+  out.append(buf, size_t(len));
+  return size_t(len);
+}
+
+bool Done(Config const &cfg, size_t NEvents, size_t NBytes) {
+  return cfg.MaxBytes ? (NBytes >= cfg.MaxBytes) : (NEvents >= cfg.NEvents);
+}
+
+// Events are written in blocks to keep the stream calls out of the loop.
+size_t const kFlushBytes = 1 << 20;
+
+} // namespace
+
+size_t WriteFinalEvents(std::ostream &os, Config const &cfg) {
+  if (cfg.EventMode == Config::kNDK) {
+    throw std::invalid_argument(
+        "NDK events can only be written as Les Houches files.");
+  }
+
+  std::string out =
+      "#   1:Run  2:Event  3:ID  4:Charge  5:perweight  6:position(1)  "
+      "7:position(2)  8:position(3)  9:momentum(0)  10:momentum(1)  "
+      "11:momentum(2)  12:momentum(3)  13:history  14:production_ID  15:enu";
+  out += cfg.ProdChargeInfo ? "  16:prodcharge\n" : "\n";
+  size_t NBytes = out.size();
+
+  // The events are spread evenly over the runs, so that the run number of the
+  // last line is the number of runs, as GiBUUToStdHep expects.
+  size_t const EventsPerRun =
+      cfg.MaxBytes ? 1000 : ((cfg.NEvents + cfg.NRuns - 1) / cfg.NRuns);
+
+  EventGenerator gen(cfg);
+  Event ev;
+  size_t NEvents = 0;
+  while (!Done(cfg, NEvents, NBytes)) {
+    gen.Next(ev);
+    int const Run = int(1 + (NEvents / (EventsPerRun ? EventsPerRun : 1)));
+    int const EvNum = gen.GetEvNum();
+
+    NBytes += AppendFinalEventsLine(out, cfg, Run, EvNum, ev.Lead, ev.Weight,
+                                    ev);
+    if (cfg.StruckNucleonInfo) {
+      NBytes += AppendFinalEventsLine(out, cfg, Run, EvNum, ev.StruckNucleon,
+                                      0, ev);
+    }
+    for (size_t h_it = 0; h_it < ev.Hadrons.size(); ++h_it) {
+      NBytes += AppendFinalEventsLine(out, cfg, Run, EvNum, ev.Hadrons[h_it],
+                                      ev.Weight, ev);
+    }
+    NEvents++;
+
+    if (out.size() > kFlushBytes) {
+      os.write(out.data(), std::streamsize(out.size()));
+      out.clear();
+    }
+  }
+  os.write(out.data(), std::streamsize(out.size()));
+  return NEvents;
+}
+
+size_t WriteLesHouches(std::ostream &os, Config const &cfg) {
+  std::string out = "<LesHouchesEvents version=\"1.0\">\n"
+                    "<!-- Synthetic GiBUU output, for benchmarking only -->\n"
+                    "<init>\n"
+                    "</init>\n";
+  size_t NBytes = out.size();
+
+  EventGenerator gen(cfg);
+  Event ev;
+  size_t NEvents = 0;
+  char buf[256];
+  while (!Done(cfg, NEvents, NBytes)) {
+    gen.Next(ev);
+
+    int len = std::snprintf(buf, sizeof(buf),
+                            "<event>\n %4d%4d%15.6E%15.6E%15.6E%15.6E\n",
+                            int(ev.Hadrons.size()), 0, ev.Weight, 0.0, 0.0,
+                            0.0);
+    out.append(buf, size_t(len));
+    NBytes += size_t(len);
+    for (size_t h_it = 0; h_it < ev.Hadrons.size(); ++h_it) {
+      NBytes += AppendLesHouchesLine(out, ev.Hadrons[h_it]);
+    }
+    if (cfg.EventMode == Config::kNDK) {
+      // The pre-FSI kaon.
+      len = std::snprintf(buf, sizeof(buf),
+                          " # %4d%18.10E%18.10E%18.10E%18.10E\n</event>\n", 5,
+                          ev.Lead.P4[3], ev.Lead.P4[0], ev.Lead.P4[1],
+                          ev.Lead.P4[2]);
+    } else {
+      // The GiBUU event information and final state lepton.
+      len = std::snprintf(
+          buf, sizeof(buf),
+          " # %4d%5d%15.6E%15.6E%15.6E%15.6E%15.6E%18.10E%18.10E%18.10E%18."
+          "10E\n</event>\n",
+          (cfg.EventMode == Config::kElectron) ? 11 : cfg.ProbePDG, ev.Prodid,
+          ev.Weight, ev.EProbe, 0.0, 0.0, 0.0, ev.Lead.P4[3], ev.Lead.P4[0],
+          ev.Lead.P4[1], ev.Lead.P4[2]);
+    }
+    out.append(buf, size_t(len));
+    NBytes += size_t(len);
+    NEvents++;
+
+    if (out.size() > kFlushBytes) {
+      os.write(out.data(), std::streamsize(out.size()));
+      out.clear();
+    }
+  }
+  out += "</LesHouchesEvents>\n";
+  os.write(out.data(), std::streamsize(out.size()));
+  return NEvents;
+}
+
+} // namespace GiBUUSynthetic
@@ -0,0 +1,66 @@
+#ifndef SEEN_GIBUUToStdHep_SYNTHETIC_HXX
+#define SEEN_GIBUUToStdHep_SYNTHETIC_HXX
+
+#include <cstddef>
+#include <ostream>
+
+///\brief Deterministic synthetic GiBUU output, for measuring the converter
+/// without running GiBUU.
+///
+/// Events have the column layout, particle mix, reaction codes and history
+/// codes of real GiBUU output, but the kinematics are not physical. The same
+/// Config always produces byte-identical output.
+namespace GiBUUSynthetic {
+
+struct Config {
+  enum Mode { kNeutrino = 0, kElectron, kNDK };
+
+  Config()
+      : EventMode(kNeutrino), IsCC(true), ProbePDG(14), EProbe(1.0),
+        StruckNucleonInfo(true), ProdChargeInfo(true), NEvents(10000),
+        MaxBytes(0), MeanMultiplicity(4), NRuns(10), Seed(12345) {}
+
+  Mode EventMode;
+  ///\brief Only used for neutrino events.
+  bool IsCC;
+  ///\brief The neutrino PDG code, only used for neutrino events.
+  int ProbePDG;
+  ///\brief The mean probe energy in GeV. Electron events all use exactly
+  /// this energy.
+  double EProbe;
+  ///\brief Whether FinalEvents.dat output includes a struck nucleon line in
+  /// each event (see GiBUUToStdHep.exe -NI).
+  bool StruckNucleonInfo;
+  ///\brief Whether FinalEvents.dat output includes the production charge
+  /// column (see GiBUUToStdHep.exe -NP).
+  bool ProdChargeInfo;
+  ///\brief The number of events to write.
+  size_t NEvents;
+  ///\brief If non-zero, events are written until the output reaches this many
+  /// bytes instead, and NEvents is ignored.
+  size_t MaxBytes;
+  ///\brief The mean number of final state hadrons per event.
+  double MeanMultiplicity;
+  ///\brief The number of GiBUU runs that the events are spread over.
+  ///
+  /// When MaxBytes is set, each run instead holds 1000 events.
+  size_t NRuns;
+  unsigned long Seed;
+};
+
+///\brief Writes a FinalEvents.dat-style file to os.
+///
+/// Returns the number of events written.
+///
+///\note Throws std::invalid_argument for NDK events, which GiBUUToStdHep can
+/// only read from Les Houches files.
+size_t WriteFinalEvents(std::ostream &os, Config const &cfg);
+
+///\brief Writes a GiBUU Les Houches-style file to os.
+///
+/// Returns the number of events written.
+size_t WriteLesHouches(std::ostream &os, Config const &cfg);
+
+} // namespace GiBUUSynthetic
+
+#endif
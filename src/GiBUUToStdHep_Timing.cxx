@@ -0,0 +1,268 @@
+#include <sys/resource.h>
+#include <time.h>
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "LUtils/Debugging.hxx"
+
+#include "GiBUUToStdHep_Input.hxx"
+#include "GiBUUToStdHep_Timing.hxx"
+
+namespace GiBUUTiming {
+
+namespace {
+char const *const kStageNames[kNStages] = {
+    "line_read",     "particle_parse", "event_assembly", "conversion",
+    "reaction_code", "tree_fill",      "write"};
+
+char const *const kStageDescriptions[kNStages] = {
+    "Line reading",       "GetParticleLine",  "Event assembly",
+    "Event conversion",   "GiBUU2NeutReacCode", "TTree::Fill",
+    "Final Write"};
+
+// Everything timed by the threads that share a name.
+struct ThreadGroup {
+  std::string Name;
+  size_t NThreads;
+  double CPUSeconds;
+  long long Nanos[kNStages];
+  size_t Calls[kNStages];
+};
+
+std::mutex GroupsMutex;
+std::vector<ThreadGroup> Groups;
+
+Clock::time_point WallStart;
+
+std::atomic<unsigned long long> InputBytes(0);
+std::atomic<unsigned long long> NLines(0);
+std::atomic<unsigned long long> NEventsParsed(0);
+std::atomic<unsigned long long> NEventsWritten(0);
+
+double ThreadCPUSeconds() {
+  timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts)) {
+    return 0;
+  }
+  return double(ts.tv_sec) + (1E-9 * double(ts.tv_nsec));
+}
+
+double ToSeconds(timeval const &tv) {
+  return double(tv.tv_sec) + (1E-6 * double(tv.tv_usec));
+}
+
+double Rate(double N, double Seconds) { return (Seconds > 0) ? (N / Seconds) : 0; }
+
+std::string JSONString(std::string const &str) {
+  std::string out = "\"";
+  for (size_t c_it = 0; c_it < str.size(); ++c_it) {
+    unsigned char const c = static_cast<unsigned char>(str[c_it]);
+    if ((c == '"') || (c == '\\')) {
+      out += '\\';
+      out += char(c);
+    } else if (c == '\n') {
+      out += "\\n";
+    } else if (c == '\t') {
+      out += "\\t";
+    } else if (c == '\r') {
+      out += "\\r";
+    } else if (c < 0x20) { // Other control characters must be escaped.
+      char buf[8];
+      std::snprintf(buf, sizeof(buf), "\\u%04x", unsigned(c));
+      out += buf;
+    } else {
+      out += char(c);
+    }
+  }
+  return out + "\"";
+}
+} // namespace
+
+namespace detail {
+ThreadTotals::ThreadTotals() : LapStart(Clock::now()) {
+  for (int s = 0; s < kNStages; ++s) {
+    Nanos[s] = 0;
+    Calls[s] = 0;
+  }
+}
+
+ThreadTotals &Local() {
+  static thread_local ThreadTotals tt;
+  return tt;
+}
+} // namespace detail
+
+void Start() {
+  if (!Enabled()) {
+    return;
+  }
+  WallStart = Clock::now();
+}
+
+void AddInputFile(std::string const &FileName) {
+  if (!Enabled()) {
+    return;
+  }
+  InputBytes += GetInputFileSize(FileName);
+}
+
+void AddLines(size_t N) {
+  if (Enabled()) {
+    NLines += N;
+  }
+}
+void AddEventsParsed(size_t N) {
+  if (Enabled()) {
+    NEventsParsed += N;
+  }
+}
+void AddEventsWritten(size_t N) {
+  if (Enabled()) {
+    NEventsWritten += N;
+  }
+}
+
+void FinishThread(char const *Name) {
+  if (!Enabled()) {
+    return;
+  }
+  double const CPU = ThreadCPUSeconds();
+  detail::ThreadTotals &tt = detail::Local();
+
+  std::lock_guard<std::mutex> lock(GroupsMutex);
+  size_t g_it = 0;
+  for (; (g_it < Groups.size()) && (Groups[g_it].Name != Name); ++g_it) {
+  }
+  if (g_it == Groups.size()) {
+    ThreadGroup group;
+    group.Name = Name;
+    group.NThreads = 0;
+    group.CPUSeconds = 0;
+    for (int s = 0; s < kNStages; ++s) {
+      group.Nanos[s] = 0;
+      group.Calls[s] = 0;
+    }
+    Groups.push_back(group);
+  }
+  ThreadGroup &group = Groups[g_it];
+  group.NThreads++;
+  group.CPUSeconds += CPU;
+  for (int s = 0; s < kNStages; ++s) {
+    group.Nanos[s] += tt.Nanos[s];
+    group.Calls[s] += tt.Calls[s];
+  }
+  // The thread may go on to time more work before it finishes again.
+  tt = detail::ThreadTotals();
+}
+
+void Report() {
+  if (!Enabled()) {
+    return;
+  }
+  double const Wall =
+      std::chrono::duration<double>(Clock::now() - WallStart).count();
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  double const CPU = ToSeconds(usage.ru_utime) + ToSeconds(usage.ru_stime);
+  // Kilobytes on Linux.
+  long const PeakRSS = usage.ru_maxrss;
+
+  double const MB = double(InputBytes) / 1E6;
+
+  std::lock_guard<std::mutex> lock(GroupsMutex);
+
+  std::stringstream ss("");
+  ss << "Timing summary:" << std::endl
+     << std::fixed << std::setprecision(3) << "\tWall: " << Wall
+     << " s, CPU: " << CPU << " s, peak RSS: " << (PeakRSS / 1024) << " MB"
+     << std::endl
+     << "\tInput: " << MB << " MB (" << Rate(MB, Wall) << " MB/s), " << NLines
+     << " lines (" << std::setprecision(0) << Rate(NLines, Wall)
+     << " lines/s), " << NEventsParsed << " events ("
+     << Rate(NEventsParsed, Wall) << " events/s)" << std::endl
+     << "\tOutput: " << NEventsWritten << " events" << std::endl
+     << "\t" << std::left << std::setw(20) << "Stage" << std::setw(16)
+     << "Thread" << std::right << std::setw(12) << "Wall [s]" << std::setw(14)
+     << "Calls" << std::setw(14) << "Mean [us]" << std::endl;
+  for (int s = 0; s < kNStages; ++s) {
+    for (size_t g_it = 0; g_it < Groups.size(); ++g_it) {
+      ThreadGroup const &group = Groups[g_it];
+      if (!group.Calls[s]) {
+        continue;
+      }
+      double const StageWall = 1E-9 * double(group.Nanos[s]);
+      ss << "\t" << std::left << std::setw(20) << kStageDescriptions[s]
+         << std::setw(16) << group.Name << std::right << std::setprecision(3)
+         << std::setw(12) << StageWall << std::setw(14) << group.Calls[s]
+         << std::setw(14) << (1E6 * StageWall / double(group.Calls[s]))
+         << std::endl;
+    }
+  }
+  ss << "\t" << std::left << std::setw(20) << "Thread" << std::right
+     << std::setw(12) << "Threads" << std::setw(12) << "CPU [s]" << std::endl;
+  for (size_t g_it = 0; g_it < Groups.size(); ++g_it) {
+    ss << "\t" << std::left << std::setw(20) << Groups[g_it].Name << std::right
+       << std::setw(12) << Groups[g_it].NThreads << std::setw(12)
+       << Groups[g_it].CPUSeconds << std::endl;
+  }
+  UDBLog(ss.str());
+
+  if (!GiBUUToStdHepOpts::TimingJSONFile.size()) {
+    return;
+  }
+  std::ofstream ofs(GiBUUToStdHepOpts::TimingJSONFile.c_str());
+  if (!ofs.good()) {
+    UDBWarn("Failed to open " << GiBUUToStdHepOpts::TimingJSONFile
+                              << " to write the timing report.");
+    return;
+  }
+  ofs << std::setprecision(6) << "{\n  \"input_files\": [";
+  for (size_t f_it = 0; f_it < GiBUUToStdHepOpts::InpFNames.size(); ++f_it) {
+    ofs << (f_it ? ", " : "")
+        << JSONString(GiBUUToStdHepOpts::InpFNames[f_it]);
+  }
+  ofs << "],\n  \"output_file\": " << JSONString(GiBUUToStdHepOpts::OutFName)
+      << ",\n  \"input_bytes\": " << InputBytes
+      << ",\n  \"input_lines\": " << NLines
+      << ",\n  \"events_parsed\": " << NEventsParsed
+      << ",\n  \"events_written\": " << NEventsWritten
+      << ",\n  \"wall_s\": " << Wall << ",\n  \"cpu_s\": " << CPU
+      << ",\n  \"peak_rss_kb\": " << PeakRSS
+      << ",\n  \"mb_per_s\": " << Rate(MB, Wall)
+      << ",\n  \"lines_per_s\": " << Rate(NLines, Wall)
+      << ",\n  \"events_per_s\": " << Rate(NEventsParsed, Wall)
+      << ",\n  \"stages\": [";
+  bool First = true;
+  for (int s = 0; s < kNStages; ++s) {
+    for (size_t g_it = 0; g_it < Groups.size(); ++g_it) {
+      if (!Groups[g_it].Calls[s]) {
+        continue;
+      }
+      ofs << (First ? "\n" : ",\n") << "    {\"name\": \""
+          << kStageNames[s] << "\", \"thread\": "
+          << JSONString(Groups[g_it].Name)
+          << ", \"wall_s\": " << (1E-9 * double(Groups[g_it].Nanos[s]))
+          << ", \"calls\": " << Groups[g_it].Calls[s] << "}";
+      First = false;
+    }
+  }
+  ofs << "\n  ],\n  \"threads\": [";
+  for (size_t g_it = 0; g_it < Groups.size(); ++g_it) {
+    ofs << (g_it ? ",\n" : "\n") << "    {\"name\": "
+        << JSONString(Groups[g_it].Name)
+        << ", \"count\": " << Groups[g_it].NThreads
+        << ", \"cpu_s\": " << Groups[g_it].CPUSeconds << "}";
+  }
+  ofs << "\n  ]\n}" << std::endl;
+  UDBLog("Wrote timing report to " << GiBUUToStdHepOpts::TimingJSONFile
+                                   << ".");
+}
+
+} // namespace GiBUUTiming
@@ -0,0 +1,119 @@
+#ifndef SEEN_GIBUUToStdHep_TIMING_HXX
+#define SEEN_GIBUUToStdHep_TIMING_HXX
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+#include "GiBUUToStdHep_CLIOpts.hxx"
+
+///\brief Optional per-stage timing and throughput reporting.
+///
+/// Each thread accumulates the wall time spent in each stage that it runs
+/// locally, and adds it to the process totals when it calls FinishThread. All
+/// timing calls return immediately unless GiBUUToStdHepOpts::ReportTiming is
+/// set.
+namespace GiBUUTiming {
+
+enum Stage {
+  kLineRead = 0,
+  kParticleParse,
+  kEventAssembly,
+  kConversion,
+  kReactionCode,
+  kTreeFill,
+  kWrite,
+  kNStages
+};
+
+typedef std::chrono::steady_clock Clock;
+
+namespace detail {
+struct ThreadTotals {
+  long long Nanos[kNStages];
+  size_t Calls[kNStages];
+  Clock::time_point LapStart;
+
+  ThreadTotals();
+  void Add(Stage S, Clock::time_point const &begin,
+           Clock::time_point const &end) {
+    Nanos[S] += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    end - begin).count();
+    Calls[S]++;
+  }
+};
+ThreadTotals &Local();
+} // namespace detail
+
+inline bool Enabled() { return GiBUUToStdHepOpts::ReportTiming; }
+
+///\brief Starts the wall clock for the whole conversion.
+void Start();
+
+///\brief Marks the start of a sequence of laps on this thread.
+///
+/// Should also be called after the thread has waited on anything that should
+/// not be attributed to the next lap, e.g. a full pipeline queue.
+inline void StartLap() {
+  if (!Enabled()) {
+    return;
+  }
+  detail::Local().LapStart = Clock::now();
+}
+
+///\brief Attributes the time since the last lap on this thread to S.
+inline void Lap(Stage S) {
+  if (!Enabled()) {
+    return;
+  }
+  detail::ThreadTotals &tt = detail::Local();
+  Clock::time_point const now = Clock::now();
+  tt.Add(S, tt.LapStart, now);
+  tt.LapStart = now;
+}
+
+///\brief Attributes the lifetime of the timer to S.
+class ScopedTimer {
+  Stage S;
+  bool Running;
+  Clock::time_point Begin;
+
+  ScopedTimer(ScopedTimer const &);
+  ScopedTimer &operator=(ScopedTimer const &);
+
+ public:
+  ScopedTimer(Stage stage) : S(stage), Running(Enabled()) {
+    if (Running) {
+      Begin = Clock::now();
+    }
+  }
+  ~ScopedTimer() {
+    if (Running) {
+      detail::Local().Add(S, Begin, Clock::now());
+    }
+  }
+};
+
+///\brief Adds the size of FileName to the number of input bytes.
+void AddInputFile(std::string const &FileName);
+///\brief Adds N to the number of input lines read.
+void AddLines(size_t N);
+///\brief Adds N to the number of input events parsed.
+void AddEventsParsed(size_t N);
+///\brief Adds N to the number of events written to the output tree.
+void AddEventsWritten(size_t N);
+
+///\brief Adds the stage times and the CPU time used by the calling thread to
+/// the totals reported for Name.
+///
+/// Must be called at the end of each thread that times anything. Threads that
+/// share a Name, e.g. -P parse workers, are summed.
+void FinishThread(char const *Name);
+
+///\brief Prints the timing and throughput table and, if
+/// GiBUUToStdHepOpts::TimingJSONFile is set, writes it as JSON.
+void Report();
+
+} // namespace GiBUUTiming
+
+#endif
@@ -1,693 +1,439 @@
 #include <algorithm>
+#include <climits>
+#include <cstring>
 #include <exception>
 #include <iomanip>
 #include <stdexcept>
+#include <utility>
 
 #include "LUtils/Debugging.hxx"
 #include "LUtils/Utils.hxx"
 
+#include "GiBUUToStdHep_Diagnostics.hxx"
+#include "GiBUUToStdHep_Input.hxx"
+#include "GiBUUToStdHep_Parsing.hxx"
+#include "GiBUUToStdHep_Timing.hxx"
 #include "GiBUUToStdHep_Utils.hxx"
 
 namespace GiBUUUtils {
 
-int GiBUUToPDG(int GiBUUCode, int GiBUUCharge) {
-  // https://gibuu.hepforge.org/trac/wiki/ParticleIDs
-
-  // Baryons
-  switch (GiBUUCode) {
-  case 1: {
-    return (GiBUUCharge > 0) ? 2212 : 2112;
-  }
-  case 2: {
-    switch (GiBUUCharge) {
-    case 2: {
-      return 2224;
-    }
-    case 1: {
-      return 2214;
-    }
-    case 0: {
-      return 2114;
-    }
-    case -1: {
-      return 1114;
-    }
-    default: {
-      UDBWarn("Delta resonance had an odd charge: " << GiBUUCharge);
-      return 2114;
-    }
-    }
-  }
-  case 3: {
-    return (GiBUUCharge > 0) ? 202212 : 202112;
-  }
-  case 4: {
-    return (GiBUUCharge > 0) ? 102212 : 102112;
-  }
-  case 5: {
-    return (GiBUUCharge > 0) ? 122212 : 122112;
-  }
-  case 7: {
-    return (GiBUUCharge > 0) ? 102214 : 102114;
-  }
-  case 8: {
-    return (GiBUUCharge > 0) ? 112214 : 112114;
-  }
-  case 10: {
-    return (GiBUUCharge > 0) ? 102216 : 102116;
-  }
-  case 12: {
-    return (GiBUUCharge > 0) ? 212212 : 212112;
-  }
-  case 14: {
-    return (GiBUUCharge > 0) ? 212214 : 212114;
-  }
-  case 16: {
-    return (GiBUUCharge > 0) ? 202216 : 202116;
-  }
-  case 19: {
-    switch (GiBUUCharge) {
-    case 2: {
-      return 112222;
-    }
-    case 1: {
-      return 112212;
-    }
-    case 0: {
-      return 112112;
-    }
-    case -1: {
-      return 111112;
-    }
-    default: {
-      UDBWarn("S31(1620) resonance had an odd charge: " << GiBUUCharge);
-      return 112112;
-    }
-    }
-  }
-  case 21: {
-    switch (GiBUUCharge) {
-    case 2: {
-      return 122224;
-    }
-    case 1: {
-      return 122214;
-    }
-    case 0: {
-      return 122114;
-    }
-    case -1: {
-      return 121114;
-    }
-    default: {
-      UDBWarn("D33(1700) resonance had an odd charge: " << GiBUUCharge);
-      return 122114;
-    }
-    }
-  }
-  case 26: {
-    switch (GiBUUCharge) {
-    case 2: {
-      return 222222;
-    }
-    case 1: {
-      return 222212;
-    }
-    case 0: {
-      return 222112;
-    }
-    case -1: {
-      return 221112;
-    }
-    default: {
-      UDBWarn("P31(1910) resonance had an odd charge: " << GiBUUCharge);
-      return 222112;
-    }
-    }
-  }
-  case 27: {
-    switch (GiBUUCharge) {
-    case 2: {
-      return 202224;
-    }
-    case 1: {
-      return 202214;
-    }
-    case 0: {
-      return 202114;
-    }
-    case -1: {
-      return 201114;
-    }
-    default: {
-      UDBWarn("P33(1600) resonance had an odd charge: " << GiBUUCharge);
-      return 202114;
-    }
-    }
-  }
-  case 28: {
-    switch (GiBUUCharge) {
-    case 2: {
-      return 222224;
-    }
-    case 1: {
-      return 222214;
-    }
-    case 0: {
-      return 222114;
-    }
-    case -1: {
-      return 221114;
-    }
-    default: {
-      UDBWarn("P33(1920) resonance had an odd charge: " << GiBUUCharge);
-      return 222114;
-    }
-    }
-  }
-  case 30: {
-    switch (GiBUUCharge) {
-    case 2: {
-      return 212226;
-    }
-    case 1: {
-      return 212216;
-    }
-    case 0: {
-      return 212116;
-    }
-    case -1: {
-      return 211116;
-    }
-    default: {
-      UDBWarn("F35(1905) resonance had an odd charge: " << GiBUUCharge);
-      return 212116;
-    }
-    }
-  }
-  case 31: {
-    switch (GiBUUCharge) {
-    case 2: {
-      return 202228;
-    }
-    case 1: {
-      return 202218;
-    }
-    case 0: {
-      return 202118;
-    }
-    case -1: {
-      return 201118;
-    }
-    default: {
-      UDBWarn("F37(1950) resonance had an odd charge: " << GiBUUCharge);
-      return 202118;
-    }
-    }
-  }
-  case 32: {
-    return 3122;
-  }
-  case 33: {
-    if (GiBUUCharge) {
-      return (GiBUUCharge > 0) ? 3222 : 3112;
-    }
-    return 3212;
-  }
-  case 34: {
-    if (GiBUUCharge) {
-      return (GiBUUCharge > 0) ? 3224 : 3114;
-    }
-    return 3214;
+namespace {
+// Table entries that are not PDG codes, but mark a lookup that must be
+// reported, see GiBUUToPDG.
+int const kOdd = INT_MIN;      // Odd charge for this particle
+int const kMiss = INT_MIN + 1; // Unknown GiBUU code
+
+// Columns of kGiBUUToPDG: GiBUU charges <= -3, -2, -1, 0, 1, 2, >= 3.
+struct GiBUUToPDGRow {
+  int PDG[7];
+};
+
+// https://gibuu.hepforge.org/trac/wiki/ParticleIDs
+// Rows are looked up through kGiBUUCodeRows.
+GiBUUToPDGRow const kGiBUUToPDG[] = {
+  {{0, 0, 0, 0, 0, 0, 0}}, // 0 No particle
+  {{2112, 2112, 2112, 2112, 2212, 2212, 2212}}, // 1 N
+  {{kOdd, kOdd, 1114, 2114, 2214, 2224, kOdd}}, // 2 Delta
+  {{202112, 202112, 202112, 202112, 202212, 202212, 202212}}, // 3 P11(1440)
+  {{102112, 102112, 102112, 102112, 102212, 102212, 102212}}, // 4 S11(1535)
+  {{122112, 122112, 122112, 122112, 122212, 122212, 122212}}, // 5 S11(1650)
+  {{-1, -1, -1, -1, -1, -1, -1}}, // 6 S11(2090)
+  {{102114, 102114, 102114, 102114, 102214, 102214, 102214}}, // 7 D13(1520)
+  {{112114, 112114, 112114, 112114, 112214, 112214, 112214}}, // 8 D13(1700)
+  {{-1, -1, -1, -1, -1, -1, -1}}, // 9 D13(2080)
+  {{102116, 102116, 102116, 102116, 102216, 102216, 102216}}, // 10 D15(1675)
+  {{-1, -1, -1, -1, -1, -1, -1}}, // 11 G17(2190)
+  {{212112, 212112, 212112, 212112, 212212, 212212, 212212}}, // 12 P11(1710)
+  {{-1, -1, -1, -1, -1, -1, -1}}, // 13 P11(2100)
+  {{212114, 212114, 212114, 212114, 212214, 212214, 212214}}, // 14 P13(1720)
+  {{-1, -1, -1, -1, -1, -1, -1}}, // 15 P13(1900)
+  {{202116, 202116, 202116, 202116, 202216, 202216, 202216}}, // 16 F15(1680)
+  {{-1, -1, -1, -1, -1, -1, -1}}, // 17 F15(2000)
+  {{-1, -1, -1, -1, -1, -1, -1}}, // 18 F17(1990)
+  {{kOdd, kOdd, 111112, 112112, 112212, 112222, kOdd}}, // 19 S31(1620)
+  {{-1, -1, -1, -1, -1, -1, -1}}, // 20 S31(1900)
+  {{kOdd, kOdd, 121114, 122114, 122214, 122224, kOdd}}, // 21 D33(1700)
+  {{-1, -1, -1, -1, -1, -1, -1}}, // 22 D33(1940)
+  {{-1, -1, -1, -1, -1, -1, -1}}, // 23 D35(1930
+  {{-1, -1, -1, -1, -1, -1, -1}}, // 24 D35(2350)
+  {{-1, -1, -1, -1, -1, -1, -1}}, // 25 P31(1750)
+  {{kOdd, kOdd, 221112, 222112, 222212, 222222, kOdd}}, // 26 P31(1910)
+  {{kOdd, kOdd, 201114, 202114, 202214, 202224, kOdd}}, // 27 P33(1600)
+  {{kOdd, kOdd, 221114, 222114, 222214, 222224, kOdd}}, // 28 P33(1920)
+  {{-1, -1, -1, -1, -1, -1, -1}}, // 29 F35(1750)
+  {{kOdd, kOdd, 211116, 212116, 212216, 212226, kOdd}}, // 30 F35(1905)
+  {{kOdd, kOdd, 201118, 202118, 202218, 202228, kOdd}}, // 31 F35(1950)
+  {{3122, 3122, 3122, 3122, 3122, 3122, 3122}}, // 32 Lambda
+  {{3112, 3112, 3112, 3212, 3222, 3222, 3222}}, // 33 Sigma
+  {{3114, 3114, 3114, 3214, 3224, 3224, 3224}}, // 34 Sigma(1385)
+  {{102134, 102134, 102134, 102134, 102134, 102134, 102134}}, // 35 Lambda(1405)
+  {{102134, 102134, 102134, 102134, 102134, 102134, 102134}}, // 36 Lambda(1520)
+  {{203122, 203122, 203122, 203122, 203122, 203122, 203122}}, // 37 Lambda(1600)
+  {{103122, 103122, 103122, 103122, 103122, 103122, 103122}}, // 38 Lambda(1670)
+  {{103124, 103124, 103124, 103124, 103124, 103124, 103124}}, // 39 Lambda(1690)
+  {{213122, 213122, 213122, 213122, 213122, 213122, 213122}}, // 40 Lambda(1810)
+  {{203126, 203126, 203126, 203126, 203126, 203126, 203126}}, // 41 Lambda(1820)
+  {{103126, 103126, 103126, 103126, 103126, 103126, 103126}}, // 42 Lambda(1830)
+  {{103114, 103114, 103114, 103214, 103224, 103224, 103224}}, // 43 Sigma(1670)
+  {{103116, 103116, 103116, 103216, 103226, 103226, 103226}}, // 44 Sigma(1775)
+  {{203118, 203118, 203118, 203218, 203228, 203228, 203228}}, // 45 Sigma(2030)
+  {{123122, 123122, 123122, 123122, 123122, 123122, 123122}}, // 46 Lambda(1800)
+  {{213124, 213124, 213124, 213124, 213124, 213124, 213124}}, // 47 Lambda(1890)
+  {{-1, -1, -1, -1, -1, -1, -1}}, // 48 Lambda(2100)
+  {{-1, -1, -1, -1, -1, -1, -1}}, // 49 Lambda(2110)
+  {{203112, 203112, 203112, 203212, 203222, 203222, 203222}}, // 50 Sigma(1660)
+  {{113112, 113112, 113112, 113212, 113222, 113222, 113222}}, // 51 Sigma(1750)
+  {{203116, 203116, 203116, 203216, 203226, 203226, 203226}}, // 52 Sigma(1915)
+  {{3312, 3312, 3312, 3312, 3322, 3322, 3322}}, // 53 Xi
+  {{3314, 3314, 3314, 3314, 3324, 3324, 3324}}, // 54 Xi^Star
+  {{3334, 3334, 3334, 3334, 3334, 3334, 3334}}, // 55 Omega
+  {{4122, 4122, 4122, 4122, 4122, 4122, 4122}}, // 56 Lambda_c
+  {{4112, 4112, 4112, 4212, 4222, 4222, 4222}}, // 57 Sigma_c
+  {{4114, 4114, 4114, 4214, 4224, 4224, 4224}}, // 58 Sigma_c^star
+  {{4132, 4132, 4132, 4132, 4232, 4232, 4232}}, // 59 Xi_c
+  {{4314, 4314, 4314, 4314, 4324, 4324, 4324}}, // 60 Xi_c^star
+  {{3334, 3334, 3334, 3334, 3334, 3334, 3334}}, // 61 Omega_c
+  {{-211, -211, -211, 111, 211, 211, 211}}, // 101 pi
+  {{221, 221, 221, 221, 221, 221, 221}}, // 102 eta
+  {{-213, -213, -213, 113, 213, 213, 213}}, // 103 rho
+  {{9000221, 9000221, 9000221, 9000221, 9000221, 9000221, 9000221}}, // 104 sigma
+  {{223, 223, 223, 223, 223, 223, 223}}, // 105 omega
+  {{331, 331, 331, 331, 331, 331, 331}}, // 106 eta prime
+  {{333, 333, 333, 333, 333, 333, 333}}, // 107 phi
+  {{441, 441, 441, 441, 441, 441, 441}}, // 108 eta_c
+  {{443, 443, 443, 443, 443, 443, 443}}, // 109 j_psi
+  {{321, 321, 321, 311, 321, 321, 321}}, // 110 K
+  {{-321, -321, -321, -311, -321, -321, -321}}, // 111 K bar
+  {{323, 323, 323, 313, 323, 323, 323}}, // 112 K*
+  {{-323, -323, -323, -313, -323, -323, -323}}, // 113 K* bar
+  {{411, 411, 411, 421, 411, 411, 411}}, // 114 D
+  {{-411, -411, -411, -421, -411, -411, -411}}, // 115 D bar
+  {{413, 413, 413, 423, 413, 413, 413}}, // 116 D star
+  {{-413, -413, -413, -423, -413, -413, -413}}, // 117 D bar star
+  {{431, 431, 431, 431, 431, 431, 431}}, // 118 D_s^plus
+  {{-431, -431, -431, -431, -431, -431, -431}}, // 119 D_s_minus
+  {{433, 433, 433, 433, 433, 433, 433}}, // 120 D^star_s^plus
+  {{-433, -433, -433, -433, -433, -433, -433}}, // 121 D^star_s^minus
+  {{225, 225, 225, 225, 225, 225, 225}}, // 122 f2(1270)
+  {{11, 11, 11, -11, -11, -11, -11}}, // 901 e
+  {{13, 13, 13, -13, -13, -13, -13}}, // 902 mu
+  {{12, 12, 12, 12, 12, 12, 12}}, // 911 nu_e
+  {{14, 14, 14, 14, 14, 14, 14}}, // 912 nu_mu
+  {{16, 16, 16, 16, 16, 16, 16}}, // 913 nu_tau
+  {{-12, -12, -12, -12, -12, -12, -12}}, // -911 nu_e bar
+  {{-14, -14, -14, -14, -14, -14, -14}}, // -912 nu_mu bar
+  {{-16, -16, -16, -16, -16, -16, -16}}, // -913 nu_tau bar
+  {{22, 22, 22, 22, 22, 22, 22}}, // 999 photon
+  {{-1, -1, -1, -1, -1, -1, -1}}, // 201 Undocumented: 201, 202, 232, 233, 234
+};
+
+// Returns the kGiBUUToPDG row for a GiBUU code, or -1 if it is unknown. Only
+// used to build kGiBUUCodeRows.
+int GiBUUCodeRow(int GiBUUCode) {
+  if ((GiBUUCode >= 0) && (GiBUUCode <= 61)) { // Baryons
+    return GiBUUCode;
+  }
+  if ((GiBUUCode >= 101) && (GiBUUCode <= 122)) { // Mesons
+    return GiBUUCode - 39;
   }
-  case 35: {
-    return 102134;
-  }
-  case 36: {
-    return 102134;
-  }
-  case 37: {
-    return 203122;
-  }
-  case 38: {
-    return 103122;
-  }
-  case 39: {
-    return 103124;
-  }
-  case 40: {
-    return 213122;
-  }
-  case 41: {
-    return 203126;
-  }
-  case 42: {
-    return 103126;
-  }
-  case 43: {
-    if (GiBUUCharge) {
-      return (GiBUUCharge > 0) ? 103224 : 103114;
-    }
-    return 103214;
-  }
-  case 44: {
-    if (GiBUUCharge) {
-      return (GiBUUCharge > 0) ? 103226 : 103116;
-    }
-    return 103216;
-  }
-  case 45: {
-    if (GiBUUCharge) {
-      return (GiBUUCharge > 0) ? 203228 : 203118;
-    }
-    return 203218;
-  }
-  case 46: {
-    return 123122;
-  }
-  case 47: {
-    return 213124;
-  }
-  case 50: {
-    if (GiBUUCharge) {
-      return (GiBUUCharge > 0) ? 203222 : 203112;
-    }
-    return 203212;
-  }
-  case 51: {
-    if (GiBUUCharge) {
-      return (GiBUUCharge > 0) ? 113222 : 113112;
-    }
-    return 113212;
-  }
-  case 52: {
-    if (GiBUUCharge) {
-      return (GiBUUCharge > 0) ? 203226 : 203116;
-    }
-    return 203216;
-  }
-  case 53: {
-    return (GiBUUCharge > 0) ? 3322 : 3312;
-  }
-  case 54: {
-    return (GiBUUCharge > 0) ? 3324 : 3314;
-  }
-  case 55: {
-    return 3334;
-  }
-  case 56: {
-    return 4122;
-  }
-  case 57: {
-    if (GiBUUCharge) {
-      return (GiBUUCharge > 0) ? 4222 : 4112;
-    }
-    return 4212;
-  }
-  case 58: {
-    if (GiBUUCharge) {
-      return (GiBUUCharge > 0) ? 4224 : 4114;
-    }
-    return 4214;
-  }
-  case 59: {
-    return (GiBUUCharge > 0) ? 4232 : 4132;
-  }
-  case 60: {
-    return (GiBUUCharge > 0) ? 4324 : 4314;
-  }
-  case 61: {
-    return 3334;
-  }
-
-  /// Mesons
-  case 101: {
-    if (GiBUUCharge) {
-      return (GiBUUCharge > 0) ? 211 : -211;
-    }
-    return 111;
-  }
-  case 102: {
-    return 221;
-  }
-  case 103: {
-    if (GiBUUCharge) {
-      return (GiBUUCharge > 0) ? 213 : -213;
-    }
-    return 113;
-  }
-  case 104: {
-    return 9000221;
-  }
-  case 105: {
-    return 223;
-  }
-  case 106: {
-    return 331;
-  }
-  case 107: {
-    return 333;
-  }
-  case 108: {
-    return 441;
-  }
-  case 109: {
-    return 443;
-  }
-  case 110: {
-    return (GiBUUCharge) ? 321 : 311;
-  }
-  case 111: {
-    return (GiBUUCharge) ? -321 : -311;
-  }
-  case 112: {
-    return (GiBUUCharge) ? 323 : 313;
-  }
-  case 113: {
-    return (GiBUUCharge) ? -323 : -313;
-  }
-  case 114: {
-    return (GiBUUCharge) ? 411 : 421;
-  }
-  case 115: {
-    return (GiBUUCharge) ? -411 : -421;
-  }
-  case 116: {
-    return (GiBUUCharge) ? 413 : 423;
-  }
-  case 117: {
-    return (GiBUUCharge) ? -413 : -423;
-  }
-  case 118: {
-    return 431;
-  }
-  case 119: {
-    return -431;
-  }
-  case 120: {
-    return 433;
-  }
-  case 121: {
-    return -433;
-  }
-  case 122: {
-    return 225;
-  }
-  case 901: {
-    return (GiBUUCharge < 0) ? 11 : -11;
-  }
-  case 902: {
-    return (GiBUUCharge < 0) ? 13 : -13;
-  }
-  case 911: {
-    return 12;
-  }
-  case 912: {
-    return 14;
-  }
-  case 913: {
-    return 16;
-  }
-  case -911: {
-    return -12;
-  }
-  case -912: {
-    return -14;
-  }
-  case -913: {
-    return -16;
-  }
-  case 999: {
-    return 22;
-  }
-  case 6:  // S11(2090)
-  case 9:  // D13(2080)
-  case 11: // G17(2190)
-  case 13: // P11(2100)
-  case 15: // P13(1720)
-  case 17: // F15(2000)
-  case 18: // F17(1990)
-  case 20: // S31(1900)
-  case 22: // D33(1940)
-  case 23: // D35(1930)
-  case 24: // D35(2350)
-  case 25: // P31(1750
-  case 29: // F35(1750)
-  case 48: // Lambda(2100)
-  case 49: // Lambda(2110)
-  {        // No PDG for these particles
-    return -1;
-  }
-
+  switch (GiBUUCode) {
+  case 901:
+    return 84;
+  case 902:
+    return 85;
+  case 911:
+  case 912:
+  case 913:
+    return 86 + (GiBUUCode - 911);
+  case -911:
+  case -912:
+  case -913:
+    return 89 - (GiBUUCode + 911);
+  case 999:
+    return 92;
   case 201:
   case 202:
   case 232:
   case 233:
-  case 234: { // Undocumented particle codes observed in GiBUU 2016
-    return -1;
-  }
-
-  default: {
-    if (GiBUUCode) {
-      UDBWarn("Missed a GiBUU PDG Code: " << GiBUUCode);
-    }
-    return 0;
-  }
+  case 234: // Undocumented particle codes observed in GiBUU 2016
+    return 93;
+  default: { return -1; }
   }
 }
 
-int PDGToGiBUU(int PDG) {
-  // https://gibuu.hepforge.org/trac/wiki/ParticleIDs
-  switch (PDG) {
-  case 2212:
-  case 2112: {
-    return 1;
-  }
+// Dense map from GiBUU code to kGiBUUToPDG row, so that a lookup does not
+// branch on the code.
+struct GiBUUCodeRowIndex {
+  static int const kMinCode = -913;
+  static int const kMaxCode = 999;
+  signed char Row[kMaxCode - kMinCode + 1];
 
-  case 2224:
-  case 2214:
-  case 2114:
-  case 1114: {
-    return 2;
-  }
-
-  case 202212:
-  case 202112: {
-    return 3;
-  }
-
-  case 102212:
-  case 102112: {
-    return 4;
-  }
-
-  case 122212:
-  case 122112: {
-    return 5;
-  }
-
-  case 102214:
-  case 102114: {
-    return 7;
-  }
-
-  case 112214:
-  case 112114: {
-    return 8;
-  }
-
-  case 102216:
-  case 102116: {
-    return 10;
-  }
-
-  case 212212:
-  case 212112: {
-    return 12;
-  }
-
-  case 202216:
-  case 202116: {
-    return 16;
-  }
-
-  case 112222:
-  case 112212:
-  case 112112:
-  case 111112: {
-    return 19;
-  }
-
-  case 122224:
-  case 122214:
-  case 122114:
-  case 121114: {
-    return 21;
-  }
-
-  case 222222:
-  case 222212:
-  case 222112:
-  case 221112: {
-    return 26;
-  }
-
-  case 202224:
-  case 202214:
-  case 202114:
-  case 201114: {
-    return 27;
-  }
-
-  case 222224:
-  case 222214:
-  case 222114:
-  case 221114: {
-    return 28;
-  }
-
-  case 212226:
-  case 212216:
-  case 212116:
-  case 211116: {
-    return 30;
-  }
-  case 202228:
-  case 202218:
-  case 202118:
-  case 201118: {
-    return 31;
-  }
-
-  case 3122: {
-    return 32;
-  }
-
-  case 3222:
-  case 3112:
-  case 3212: {
-    return 33;
+  GiBUUCodeRowIndex() {
+    for (int code = kMinCode; code <= kMaxCode; ++code) {
+      Row[code - kMinCode] = static_cast<signed char>(GiBUUCodeRow(code));
+    }
   }
-
-  case 3224:
-  case 3114:
-  case 3214: {
-    return 34;
+  int operator()(int GiBUUCode) const {
+    unsigned const Offset = unsigned(GiBUUCode - kMinCode);
+    return (Offset < sizeof(Row)) ? Row[Offset] : -1;
   }
+};
+GiBUUCodeRowIndex const kGiBUUCodeRows;
 
-  case 102134: {
-    return 36;
-  }
+inline int GiBUUChargeColumn(int GiBUUCharge) {
+  return std::min(std::max(GiBUUCharge, -3), 3) + 3;
+}
 
-  case 211:
-  case -211:
-  case 111: {
-    return 101;
+// Reporting is kept out of GiBUUToPDG so that the common lookup stays small.
+int ReportOddGiBUUCharge(int GiBUUCode, int GiBUUCharge, int DefaultPDG) {
+  char const *Name = "";
+  switch (GiBUUCode) {
+  case 2: {
+    Name = "Delta";
+    break;
   }
-
-  case 221: {
-    return 102;
+  case 19: {
+    Name = "S31(1620)";
+    break;
   }
-
-  case 213:
-  case -213:
-  case 113: {
-    return 103;
+  case 21: {
+    Name = "D33(1700)";
+    break;
   }
-
-  case 9000221: {
-    return 104;
+  case 26: {
+    Name = "P31(1910)";
+    break;
   }
-
-  case 223: {
-    return 105;
+  case 27: {
+    Name = "P33(1600)";
+    break;
   }
-
-  case 331: {
-    return 106;
+  case 28: {
+    Name = "P33(1920)";
+    break;
   }
-
-  case 321:
-  case 311: {
-    return 110;
+  case 30: {
+    Name = "F35(1905)";
+    break;
   }
-
-  case -321:
-  case -311: {
-    return 111;
+  case 31: {
+    Name = "F37(1950)";
+    break;
   }
-
-  case 323:
-  case 313: {
-    return 112;
+  default: {}
   }
+  GiBUUDiagWarn(GiBUUDiagnostics::kOddGiBUUCharge,
+                Name << " resonance had an odd charge: " << GiBUUCharge);
+  return DefaultPDG;
+}
 
-  case 11:
-  case -11: {
-    return 901;
-  }
+int ReportMissedGiBUUCode(int GiBUUCode) {
+  GiBUUDiagWarn(GiBUUDiagnostics::kUnknownGiBUUCode,
+                "Missed a GiBUU PDG Code: " << GiBUUCode);
+  return 0;
+}
 
-  case 13:
-  case -13: {
-    return 902;
+// Sorted by PDG code. Looked up through kPDGToGiBUUHash.
+std::pair<int, int> const kPDGToGiBUU[] = {
+  {-321, 111},
+  {-311, 111},
+  {-213, 103},
+  {-211, 101},
+  {-16, -913},
+  {-14, -912},
+  {-13, 902},
+  {-12, -911},
+  {-11, 901},
+  {11, 901},
+  {12, 911},
+  {13, 902},
+  {14, 912},
+  {16, 913},
+  {22, 999},
+  {111, 101},
+  {113, 103},
+  {211, 101},
+  {213, 103},
+  {221, 102},
+  {223, 105},
+  {311, 110},
+  {313, 112},
+  {321, 110},
+  {323, 112},
+  {331, 106},
+  {1114, 2},
+  {2112, 1},
+  {2114, 2},
+  {2212, 1},
+  {2214, 2},
+  {2224, 2},
+  {3112, 33},
+  {3114, 34},
+  {3122, 32},
+  {3212, 33},
+  {3214, 34},
+  {3222, 33},
+  {3224, 34},
+  {102112, 4},
+  {102114, 7},
+  {102116, 10},
+  {102134, 36},
+  {102212, 4},
+  {102214, 7},
+  {102216, 10},
+  {111112, 19},
+  {112112, 19},
+  {112114, 8},
+  {112212, 19},
+  {112214, 8},
+  {112222, 19},
+  {121114, 21},
+  {122112, 5},
+  {122114, 21},
+  {122212, 5},
+  {122214, 21},
+  {122224, 21},
+  {201114, 27},
+  {201118, 31},
+  {202112, 3},
+  {202114, 27},
+  {202116, 16},
+  {202118, 31},
+  {202212, 3},
+  {202214, 27},
+  {202216, 16},
+  {202218, 31},
+  {202224, 27},
+  {202228, 31},
+  {211116, 30},
+  {212112, 12},
+  {212116, 30},
+  {212212, 12},
+  {212216, 30},
+  {212226, 30},
+  {221112, 26},
+  {221114, 28},
+  {222112, 26},
+  {222114, 28},
+  {222212, 26},
+  {222214, 28},
+  {222222, 26},
+  {222224, 28},
+  {9000221, 104},
+};
+
+// Open-addressed hash table built from kPDGToGiBUU.
+struct PDGToGiBUUHash {
+  // A power of two, with room for a low load factor.
+  static UInt_t const kNSlots = 256;
+  // PDG code 0 marks an empty slot, it is never in kPDGToGiBUU.
+  int PDG[kNSlots];
+  int GiBUU[kNSlots];
+
+  static UInt_t Slot(int PDGCode) {
+    // Fibonacci hashing, keeping the top 8 bits.
+    return (UInt_t(PDGCode) * 2654435761u) >> 24;
+  }
+
+  PDGToGiBUUHash() {
+    std::fill(PDG, PDG + kNSlots, 0);
+    std::fill(GiBUU, GiBUU + kNSlots, 0);
+    for (size_t i = 0; i < (sizeof(kPDGToGiBUU) / sizeof(kPDGToGiBUU[0]));
+         ++i) {
+      UInt_t slot = Slot(kPDGToGiBUU[i].first);
+      while (PDG[slot]) {
+        slot = (slot + 1) & (kNSlots - 1);
+      }
+      PDG[slot] = kPDGToGiBUU[i].first;
+      GiBUU[slot] = kPDGToGiBUU[i].second;
+    }
   }
+};
+PDGToGiBUUHash const kPDGToGiBUUHash;
 
-  case 12: {
-    return 911;
+int ReportMissedPDGCode(int PDG) {
+  if (PDG) {
+    GiBUUDiagWarn(GiBUUDiagnostics::kUnknownPDGCode,
+                  "Missed a PDG Code: " << PDG);
   }
+  return 0;
+}
+} // namespace
 
-  case 14: {
-    return 912;
+int GiBUUToPDG(int GiBUUCode, int GiBUUCharge) {
+  int const Row = kGiBUUCodeRows(GiBUUCode);
+  if (Row < 0) {
+    return ReportMissedGiBUUCode(GiBUUCode);
   }
-
-  case 16: {
-    return 913;
+  int const PDG = kGiBUUToPDG[Row].PDG[GiBUUChargeColumn(GiBUUCharge)];
+  if (PDG > kMiss) {
+    return PDG;
   }
-
-  case -12: {
-    return -911;
+  if (PDG == kOdd) {
+    return ReportOddGiBUUCharge(GiBUUCode, GiBUUCharge,
+                                kGiBUUToPDG[Row].PDG[GiBUUChargeColumn(0)]);
   }
+  return ReportMissedGiBUUCode(GiBUUCode);
+}
 
-  case -14: {
-    return -912;
+int PDGToGiBUU(int PDG) {
+  UInt_t slot = PDGToGiBUUHash::Slot(PDG);
+  while (kPDGToGiBUUHash.PDG[slot] != PDG) {
+    if (!kPDGToGiBUUHash.PDG[slot]) {
+      return ReportMissedPDGCode(PDG);
+    }
+    slot = (slot + 1) & (PDGToGiBUUHash::kNSlots - 1);
   }
+  return kPDGToGiBUUHash.GiBUU[slot];
+}
 
-  case -16: {
-    return -913;
+void DecomposeGiBUUHistories(Long_t const *History, size_t NParts,
+                             Int_t *Generation, Int_t *Mother, Int_t *Father) {
+  // History codes are Generation * 1E6 + Parent2 * 1E3 + Parent1, or
+  // -(Generation * 1E6 + ThreeBodyCode) for three-body processes.
+  bool Fits32 = true;
+  for (size_t i = 0; i < NParts; ++i) {
+    Fits32 &= ((History[i] > -2147483647L) & (History[i] < 2147483647L));
+  }
+
+  if (Fits32) {
+    // No branches in the loop body, so that it can be vectorised.
+    for (size_t i = 0; i < NParts; ++i) {
+      Int_t const HistCode = Int_t(History[i]);
+      Int_t const Neg = HistCode >> 31; // All bits set for three-body codes.
+      UInt_t const AbsCode = UInt_t((HistCode ^ Neg) - Neg);
+      UInt_t const Gen = AbsCode / 1000000u;
+      UInt_t const Rest = AbsCode - (Gen * 1000000u);
+      UInt_t const P2 = Rest / 1000u;
+      UInt_t const P1 = Rest - (P2 * 1000u);
+
+      Generation[i] = Int_t(Gen);
+      Mother[i] = Int_t((P1 > P2) ? P1 : P2) | Neg;
+      Father[i] = Neg ? Int_t(Rest) : Int_t((P1 < P2) ? P1 : P2);
+    }
+    return;
   }
 
-  case 22: {
-    return 999;
-  }
+  for (size_t i = 0; i < NParts; ++i) {
+    bool const ThreeBody = (History[i] < 0);
+    Long_t const AbsCode = ThreeBody ? -History[i] : History[i];
+    Long_t const Gen = AbsCode / 1000000L;
+    Long_t const Rest = AbsCode - (Gen * 1000000L);
+    Long_t const P2 = Rest / 1000L;
+    Long_t const P1 = Rest - (P2 * 1000L);
 
-  default: {
-    if (PDG) {
-      UDBWarn("Missed a PDG Code: " << PDG);
-    }
-    return 0;
-  }
+    Generation[i] = Int_t(Gen);
+    Mother[i] = ThreeBody ? -1 : Int_t(std::max(P1, P2));
+    Father[i] = ThreeBody ? Int_t(Rest) : Int_t(std::min(P1, P2));
   }
 }
 
 #ifndef CPP03COMPAT
 
 std::tuple<Int_t, Int_t, Int_t> DecomposeGiBUUHistory(Long_t HistCode) {
-  if (HistCode > -1) {
-    Int_t Generation = abs(HistCode) / 1E6;
-    Int_t P2 = (HistCode - (1E6 * Generation)) / 1E3;
-    Int_t P1 = (HistCode - (1E6 * Generation)) - (1E3 * P2);
-
-    Int_t PFather = std::min(P1, P2);
-    Int_t PMother = std::max(P1, P2);
-
-    return std::make_tuple(Generation, PMother, PFather);
-  } else {
-    HistCode = -1 * HistCode;
-    Int_t Generation = abs(HistCode) / 1E6;
-    Int_t ThreeBodyCode = (HistCode - (1E6 * Generation));
-
-    return std::make_tuple(Generation, -1, ThreeBodyCode);
-  }
+  Int_t Generation, PMother, PFather;
+  DecomposeGiBUUHistories(&HistCode, 1, &Generation, &PMother, &PFather);
+  return std::make_tuple(Generation, PMother, PFather);
 }
 
 std::string WriteGiBUUHistory(Long_t HistCode) {
@@ -749,31 +495,78 @@ std::string PrintGiBUUStdHepArray(Int_t GiBUUCode,
 }
 #endif
 
-// Returns vect of: Particle PDG, Parent1, Parent2
-std::vector<std::tuple<Int_t, Int_t, Int_t>>
-GetGenNParticles(Int_t Gen, Int_t const *const StdHepPDGArray,
-                 Long_t const *const HistoryArray, Int_t StdHepN) {
-  std::vector<std::tuple<Int_t, Int_t, Int_t>> ret;
+void GiBUUGenealogy::Build(Int_t const *const PDGArray,
+                           Long_t const *const History, Int_t N) {
+  StdHepPDGArray = PDGArray;
+  HistoryArray = History;
+  StdHepN = N;
+
+  size_t const NParts = size_t(std::max(N, 0));
+  Generation.resize(NParts);
+  Mother.resize(NParts);
+  Father.resize(NParts);
+  DecomposeGiBUUHistories(History, NParts, Generation.data(), Mother.data(),
+                          Father.data());
+
+  ByGeneration.resize(NParts);
+  for (size_t i = 0; i < NParts; ++i) {
+    ByGeneration[i] = Int_t(i);
+  }
+  std::stable_sort(ByGeneration.begin(), ByGeneration.end(),
+                   [this](Int_t a, Int_t b) {
+                     return Generation[a] < Generation[b];
+                   });
+  GenerationRanges.clear();
+  for (size_t i = 0; i < NParts; ++i) {
+    Int_t const Gen = Generation[ByGeneration[i]];
+    if (GenerationRanges.empty() ||
+        (std::get<0>(GenerationRanges.back()) != Gen)) {
+      GenerationRanges.push_back(std::make_tuple(Gen, i, i));
+    }
+    std::get<2>(GenerationRanges.back()) = i + 1;
+  }
+
+  FSDecayPions.clear();
+  DeltaDecayNucleons.clear();
+  for (size_t i = 0; i < NParts; ++i) {
+    if ((Mother[i] != -1) && (Father[i] == 0) &&
+        ((PDGArray[i] == 211) || (PDGArray[i] == -211) ||
+         (PDGArray[i] == 111))) {
+      FSDecayPions.push_back(
+          std::make_tuple(Generation[i], PDGArray[i], Mother[i]));
+    }
+    if ((Mother[i] == 2) && (Father[i] == 0) &&
+        ((PDGArray[i] == 2112) || (PDGArray[i] == 2212))) {
+      DeltaDecayNucleons.push_back(
+          std::make_tuple(Generation[i], PDGArray[i]));
+    }
+  }
+  std::sort(FSDecayPions.begin(), FSDecayPions.end());
+  std::sort(DeltaDecayNucleons.begin(), DeltaDecayNucleons.end());
+}
 
-  for (Int_t i = 0; i < StdHepN; ++i) {
-    auto const &dHist = DecomposeGiBUUHistory(HistoryArray[i]);
-    if (std::get<0>(dHist) == Gen) {
-      ret.push_back(std::make_tuple(StdHepPDGArray[i], std::get<1>(dHist),
-                                    std::get<2>(dHist)));
-    }
+void GiBUUGenealogy::GetGeneration(Int_t Gen, Int_t const *&begin,
+                                   Int_t const *&end) const {
+  begin = end = ByGeneration.data();
+  auto const it = std::lower_bound(
+      GenerationRanges.begin(), GenerationRanges.end(), Gen,
+      [](std::tuple<Int_t, size_t, size_t> const &range, Int_t g) {
+        return std::get<0>(range) < g;
+      });
+  if ((it == GenerationRanges.end()) || (std::get<0>(*it) != Gen)) {
+    return;
   }
-  return ret;
+  begin = ByGeneration.data() + std::get<1>(*it);
+  end = ByGeneration.data() + std::get<2>(*it);
 }
 
-size_t GetNParticleGiBUUCode(Int_t GiBUUCode, Int_t const *const StdHepPDGArray,
-                             Long_t const *const HistoryArray, Int_t StdHepN) {
+size_t GetNParticleGiBUUCode(Int_t GiBUUCode, GiBUUGenealogy const &Genealogy) {
   size_t ctr = 0;
 
-  for (Int_t i = 0; i < StdHepN; ++i) {
-    auto const &dHist = DecomposeGiBUUHistory(HistoryArray[i]);
-    ctr += (GiBUUCode == std::get<1>(dHist));
-    ctr += (GiBUUCode == std::get<2>(dHist));
-    ctr += (GiBUUCode == PDGToGiBUU(StdHepPDGArray[i]));
+  for (Int_t i = 0; i < Genealogy.StdHepN; ++i) {
+    ctr += (GiBUUCode == Genealogy.Mother[i]);
+    ctr += (GiBUUCode == Genealogy.Father[i]);
+    ctr += (GiBUUCode == PDGToGiBUU(Genealogy.StdHepPDGArray[i]));
   }
   return ctr;
 }
@@ -789,69 +582,29 @@ size_t GetNFSParticleGiBUUCode(Int_t GiBUUCode,
   return ctr;
 }
 
-std::vector<Int_t> GetTwoBodyFSParticles(Int_t const *const StdHepPDGArray,
-                                         Long_t const *const HistoryArray,
-                                         Int_t StdHepN) {
+std::vector<Int_t> GetTwoBodyFSParticles(GiBUUGenealogy const &Genealogy) {
   std::vector<Int_t> ret;
 
-  for (Int_t i = 0; i < StdHepN; ++i) {
-    if (std::get<2>(DecomposeGiBUUHistory(HistoryArray[i])) != 0) {
-      ret.push_back(StdHepPDGArray[i]);
+  for (Int_t i = 0; i < Genealogy.StdHepN; ++i) {
+    if (Genealogy.Father[i] != 0) {
+      ret.push_back(Genealogy.StdHepPDGArray[i]);
     }
   }
   return ret;
 }
 
-std::vector<Int_t> GetTwoBodyFSNucleons(Int_t const *const StdHepPDGArray,
-                                        Long_t const *const HistoryArray,
-                                        Int_t StdHepN) {
+std::vector<Int_t> GetTwoBodyFSNucleons(GiBUUGenealogy const &Genealogy) {
   std::vector<Int_t> ret;
 
-  for (Int_t i = 0; i < StdHepN; ++i) {
-    if ((std::get<2>(DecomposeGiBUUHistory(HistoryArray[i])) != 0) &&
-        ((StdHepPDGArray[i] == 2122) || (StdHepPDGArray[i] == 2112))) {
-      ret.push_back(StdHepPDGArray[i]);
+  for (Int_t i = 0; i < Genealogy.StdHepN; ++i) {
+    Int_t const PDG = Genealogy.StdHepPDGArray[i];
+    if ((Genealogy.Father[i] != 0) && ((PDG == 2122) || (PDG == 2112))) {
+      ret.push_back(PDG);
     }
   }
   return ret;
 }
 
-// Returns Generation, Pion PDG, Decay Parent
-std::vector<std::tuple<Int_t, Int_t, Int_t>>
-GetFSDecayPions(Int_t const *const StdHepPDGArray,
-                Long_t const *const HistoryArray, Int_t StdHepN) {
-  std::vector<std::tuple<Int_t, Int_t, Int_t>> ret;
-
-  for (Int_t i = 0; i < StdHepN; ++i) {
-    auto const &dHist = DecomposeGiBUUHistory(HistoryArray[i]);
-    if ((std::get<1>(dHist) != -1) && (std::get<2>(dHist) == 0) &&
-        ((StdHepPDGArray[i] == 211) || (StdHepPDGArray[i] == -211) ||
-         (StdHepPDGArray[i] == 111))) {
-      ret.push_back(std::make_tuple(std::get<0>(dHist), StdHepPDGArray[i],
-                                    std::get<1>(dHist)));
-    }
-  }
-  std::sort(ret.begin(), ret.end());
-  return ret;
-}
-
-// Returns Generation, PDG
-std::vector<std::tuple<Int_t, Int_t>>
-GetDeltaDecayNucleons(Int_t const *const StdHepPDGArray,
-                      Long_t const *const HistoryArray, Int_t StdHepN) {
-  std::vector<std::tuple<Int_t, Int_t>> ret;
-
-  for (Int_t i = 0; i < StdHepN; ++i) {
-    auto const &dHist = DecomposeGiBUUHistory(HistoryArray[i]);
-    if ((std::get<1>(dHist) == 2) && (std::get<2>(dHist) == 0) &&
-        ((StdHepPDGArray[i] == 2112) || (StdHepPDGArray[i] == 2212))) {
-      ret.push_back(std::make_tuple(std::get<0>(dHist), StdHepPDGArray[i]));
-    }
-  }
-  std::sort(ret.begin(), ret.end());
-  return ret;
-}
-
 std::vector<Int_t> GetFSPions(Int_t const *const StdHepPDGArray,
                               Int_t StdHepN) {
   std::vector<Int_t> ret;
@@ -893,73 +646,84 @@ Int_t PionPDGToNeutResMode(Int_t pionPDG, Int_t NucleonPDG, bool &Warn) {
   return 0;
 }
 
-int ResonanceHeuristics(Int_t const *const StdHepPDGArray,
-                        Long_t const *const HistoryArray, Int_t StdHepN) {
-  // RESONANCE HEURISTICS
-  auto const &g1parts =
-      GetGenNParticles(1, StdHepPDGArray, HistoryArray, StdHepN);
-
-  Int_t NucleonPDG = 0;
-  for (auto const &part : g1parts) {
-    if ((std::get<1>(part) == 2) &&      // first gen delta decay child
-        ((std::get<0>(part) == 2212) ||  // a proton
-         (std::get<0>(part) == 2112))) { // a neutron
-      NucleonPDG = std::get<0>(part);
-      break;
+// Returns the PDG code of the first nucleon in generation Gen whose mother
+// was MotherCode, or 0 if there is none.
+Int_t FindGenNucleon(GiBUUGenealogy const &Genealogy, Int_t Gen,
+                     Int_t MotherCode) {
+  Int_t const *begin, *end;
+  Genealogy.GetGeneration(Gen, begin, end);
+  for (; begin != end; ++begin) {
+    Int_t const PDG = Genealogy.StdHepPDGArray[*begin];
+    if ((Genealogy.Mother[*begin] == MotherCode) &&
+        ((PDG == 2212) ||  // a proton
+         (PDG == 2112))) { // a neutron
+      return PDG;
     }
   }
+  return 0;
+}
+
+int ResonanceHeuristics(GiBUUGenealogy const &Genealogy) {
+  Int_t const *const StdHepPDGArray = Genealogy.StdHepPDGArray;
+  Long_t const *const HistoryArray = Genealogy.HistoryArray;
+  Int_t const StdHepN = Genealogy.StdHepN;
+
+  // RESONANCE HEURISTICS
+  // First gen delta decay child nucleon
+  Int_t NucleonPDG = FindGenNucleon(Genealogy, 1, 2);
 
   // If we find a first generation pion
-  for (auto const &part : g1parts) {
+  Int_t const *g1begin, *g1end;
+  Genealogy.GetGeneration(1, g1begin, g1end);
+  for (; g1begin != g1end; ++g1begin) {
     bool Warn = false;
     // Check the pions
-    Int_t rMode = PionPDGToNeutResMode(std::get<0>(part), NucleonPDG, Warn);
+    Int_t rMode =
+        PionPDGToNeutResMode(StdHepPDGArray[*g1begin], NucleonPDG, Warn);
     if (rMode) {
       if (Warn) { // If theres something fishy then shout about it
-        UDBWarn("Returning potentially dodgey (mode:0) "
-                << "NEUT Code: " << rMode << " (Found Nucleon: " << NucleonPDG
-                << ").");
-        UDBWarn("        It came from the event: " << PrintGiBUUStdHepArray(
-                    2, StdHepPDGArray, HistoryArray, StdHepN, "\t|"));
+        GiBUUDiagWarn(GiBUUDiagnostics::kResonanceHeuristics,
+                      "Returning potentially dodgey (mode:0) "
+                          << "NEUT Code: " << rMode
+                          << " (Found Nucleon: " << NucleonPDG << ")."
+                          << "\n        It came from the event: "
+                          << PrintGiBUUStdHepArray(2, StdHepPDGArray,
+                                                   HistoryArray, StdHepN,
+                                                   "\t|"));
       }
       return rMode;
     }
   }
 
   // If we're still here then we should check FS pions from decays
-  auto const &FSDP = GetFSDecayPions(StdHepPDGArray, HistoryArray, StdHepN);
+  auto const &FSDP = Genealogy.FSDecayPions;
   for (auto const &decayPi : FSDP) { // Try first to make sure it is from
     if (std::get<2>(decayPi) != 2) { // a Delta
-      UDBWarn("Had a GiBUU mode 2 which resulted in decay "
-              << "pions. Their decay parent, " << std::get<2>(decayPi)
-              << ", was not a Delta though.");
+      GiBUUDiagWarn(GiBUUDiagnostics::kResonanceHeuristics,
+                    "Had a GiBUU mode 2 which resulted in decay "
+                        << "pions. Their decay parent, "
+                        << std::get<2>(decayPi) << ", was not a Delta though.");
       if (std::get<2>(decayPi) == 102 || std::get<2>(decayPi) == 104) {
         return 21;
       }
       continue;
     }
-    // Try and find a nucleon from the same generation.
-    auto const &gxparts = GetGenNParticles(std::get<0>(decayPi), StdHepPDGArray,
-                                           HistoryArray, StdHepN);
-    Int_t SameGenNucleon = 0;
-    for (auto const &part : gxparts) {
-      if ((std::get<1>(part) == 2) &&      // first gen delta decay child
-          ((std::get<0>(part) == 2212) ||  // a proton
-           (std::get<0>(part) == 2112))) { // a neutron
-        SameGenNucleon = std::get<0>(part);
-        break;
-      }
-    }
+    // Try and find a delta decay nucleon from the same generation.
+    Int_t SameGenNucleon = FindGenNucleon(Genealogy, std::get<0>(decayPi), 2);
     bool Warn = false;
     Int_t rMode =
         PionPDGToNeutResMode(std::get<1>(decayPi), SameGenNucleon, Warn);
     if (rMode) {
       if (Warn) { // If theres something fishy then shout about it
-        UDBWarn("Returning potentially dodgey (mode:1) "
-                << "NEUT Code: " << rMode << " (Found Same generation Nucleon: "
-                << SameGenNucleon << ").");
-        UDBWarn("        It came from the event: " << PrintGiBUUStdHepArray(
-                    2, StdHepPDGArray, HistoryArray, StdHepN, "\t|"));
+        GiBUUDiagWarn(GiBUUDiagnostics::kResonanceHeuristics,
+                      "Returning potentially dodgey (mode:1) "
+                          << "NEUT Code: " << rMode
+                          << " (Found Same generation Nucleon: "
+                          << SameGenNucleon << ")."
+                          << "\n        It came from the event: "
+                          << PrintGiBUUStdHepArray(2, StdHepPDGArray,
+                                                   HistoryArray, StdHepN,
+                                                   "\t|"));
       }
       return rMode;
     }
@@ -968,45 +732,46 @@ int ResonanceHeuristics(Int_t const *const StdHepPDGArray,
   for (auto const &decayPi : FSDP) {
     // Try and find a nucleon from the same generation and same decay
     // parent PDG.
-    auto const &gxparts = GetGenNParticles(std::get<0>(decayPi), StdHepPDGArray,
-                                           HistoryArray, StdHepN);
-    Int_t SameGenNucleon = 0;
-    for (auto const &part : gxparts) {
-      if ((std::get<1>(part) == std::get<2>(decayPi)) && // same decay
-                                                         // parent as pion
-          ((std::get<0>(part) == 2212) ||                // a proton
-           (std::get<0>(part) == 2112))) {               // a neutron
-        SameGenNucleon = std::get<0>(part);
-        break;
-      }
-    }
+    Int_t SameGenNucleon = FindGenNucleon(Genealogy, std::get<0>(decayPi),
+                                          std::get<2>(decayPi));
     bool Warn = false;
     Int_t rMode =
         PionPDGToNeutResMode(std::get<1>(decayPi), SameGenNucleon, Warn);
     if (rMode) {
-      UDBWarn("Returning potentially dodgey (mode:2) "
-              << "NEUT Code: " << rMode << " (Found Nucleon probably from same "
-              << "decay: " << SameGenNucleon << ").");
-      UDBWarn("        It came from the event: " << PrintGiBUUStdHepArray(
-                  2, StdHepPDGArray, HistoryArray, StdHepN, "\t|"));
+      GiBUUDiagWarn(GiBUUDiagnostics::kResonanceHeuristics,
+                    "Returning potentially dodgey (mode:2) "
+                        << "NEUT Code: " << rMode
+                        << " (Found Nucleon probably from same "
+                        << "decay: " << SameGenNucleon << ")."
+                        << "\n        It came from the event: "
+                        << PrintGiBUUStdHepArray(2, StdHepPDGArray,
+                                                 HistoryArray, StdHepN,
+                                                 "\t|"));
       return rMode;
     }
   }
 
   if (!NucleonPDG) { // If we havent found one yet.
     // Get the lowest gen one!
-    auto const &gxparts =
-        GetDeltaDecayNucleons(StdHepPDGArray, HistoryArray, StdHepN);
+    auto const &gxparts = Genealogy.DeltaDecayNucleons;
     NucleonPDG = gxparts.size() ? std::get<1>(gxparts.front()) : 0;
   }
 
-  UDBWarn("Giving up on this Delta resonance, returning: "
-          << ((NucleonPDG == 2212) ? 10 : 9)
-          << " (Found Nucleon: " << NucleonPDG << ")."
-          << PrintGiBUUStdHepArray(2, StdHepPDGArray, HistoryArray, StdHepN,
-                                   "\t+"));
+  GiBUUDiagWarn(GiBUUDiagnostics::kResonanceHeuristics,
+                "Giving up on this Delta resonance, returning: "
+                    << ((NucleonPDG == 2212) ? 10 : 9)
+                    << " (Found Nucleon: " << NucleonPDG << ")."
+                    << PrintGiBUUStdHepArray(2, StdHepPDGArray, HistoryArray,
+                                             StdHepN, "\t+"));
   return (NucleonPDG == 2212) ? 11 : 12;
 }
+
+int ResonanceHeuristics(Int_t const *const StdHepPDGArray,
+                        Long_t const *const HistoryArray, Int_t StdHepN) {
+  GiBUUGenealogy Genealogy;
+  Genealogy.Build(StdHepPDGArray, HistoryArray, StdHepN);
+  return ResonanceHeuristics(Genealogy);
+}
 #endif
 
 int GiBUU2NeutReacCode(Int_t GiBUUCode, Int_t const *const StdHepPDGArray,
@@ -1151,10 +916,11 @@ int GiBUU2NeutReacCode(Int_t GiBUUCode, Int_t const *const StdHepPDGArray,
   }
 
 #ifndef CPP03COMPAT
-  UDBWarn("Couldn't determine NEUT equivalent reaction code "
-          "for the interaction:"
-          << PrintGiBUUStdHepArray(GiBUUCode, StdHepPDGArray, HistoryArray,
-                                   StdHepN));
+  GiBUUDiagWarn(GiBUUDiagnostics::kUnknownReactionCode,
+                "Couldn't determine NEUT equivalent reaction code "
+                "for the interaction:"
+                    << PrintGiBUUStdHepArray(GiBUUCode, StdHepPDGArray,
+                                             HistoryArray, StdHepN));
 #endif
   return 0;
 }
@@ -1225,155 +991,244 @@ int GiBUU2NeutReacCode_escat(Int_t GiBUUCode,
 }
 } // namespace GiBUUUtils
 
-LHVectorReader::LHVectorReader(std::string const &FileName)
-    : xmlengine(), xmldoc(NULL), evptr(NULL), ReadFile(false), NEvents(0),
-      NEventsRead(0) {
-  xmlengine.SetSkipComments();
-  OpenLHDoc(FileName);
+void GiBUUEventBatch::AddParticle(GiBUUPartBlob const &part, bool NewEvent) {
+  if (NewEvent || Empty()) {
+    Run.push_back(part.Run);
+    EvNum.push_back(part.EvNum);
+    PerWeight.push_back(part.PerWeight);
+    Prodid.push_back(part.Prodid);
+    EProbe.push_back(part.EProbe);
+    ProdCharge.push_back(part.ProdCharge);
+    EventOffsets.push_back(EventOffsets.back());
+  } else if (!part.EvNum) {
+    EvNum.back() = 0;
+  }
+
+  ID.push_back(part.ID);
+  Charge.push_back(part.Charge);
+  Position.insert(Position.end(), part.Position, part.Position + 3);
+  FourMom.insert(FourMom.end(), part.FourMom, part.FourMom + 4);
+  History.push_back(part.History);
+  ln.push_back(part.ln);
+  IDIsPDG.push_back(part.IDIsPDG);
+  EventOffsets.back()++;
 }
 
-void LHVectorReader::OpenLHDoc(std::string const &FileName) {
-  xmldoc = xmlengine.ParseFile(FileName.c_str());
+void GiBUUEventBatch::Append(GiBUUEventBatch const &other) {
+  size_t const POffset = GetNParticles();
+
+  Run.insert(Run.end(), other.Run.begin(), other.Run.end());
+  EvNum.insert(EvNum.end(), other.EvNum.begin(), other.EvNum.end());
+  PerWeight.insert(PerWeight.end(), other.PerWeight.begin(),
+                   other.PerWeight.end());
+  Prodid.insert(Prodid.end(), other.Prodid.begin(), other.Prodid.end());
+  EProbe.insert(EProbe.end(), other.EProbe.begin(), other.EProbe.end());
+  ProdCharge.insert(ProdCharge.end(), other.ProdCharge.begin(),
+                    other.ProdCharge.end());
+  for (size_t ev_it = 1; ev_it < other.EventOffsets.size(); ++ev_it) {
+    EventOffsets.push_back(POffset + other.EventOffsets[ev_it]);
+  }
+
+  ID.insert(ID.end(), other.ID.begin(), other.ID.end());
+  Charge.insert(Charge.end(), other.Charge.begin(), other.Charge.end());
+  Position.insert(Position.end(), other.Position.begin(),
+                  other.Position.end());
+  FourMom.insert(FourMom.end(), other.FourMom.begin(), other.FourMom.end());
+  History.insert(History.end(), other.History.begin(), other.History.end());
+  ln.insert(ln.end(), other.ln.begin(), other.ln.end());
+  IDIsPDG.insert(IDIsPDG.end(), other.IDIsPDG.begin(), other.IDIsPDG.end());
+}
 
-  if (!xmldoc) {
-    UDBError("TXMLEngine could not parse file: \"" << FileName << "\"");
-    throw;
-  }
+void GiBUUEventBatch::GetParticle(size_t ev, size_t p,
+                                  GiBUUPartBlob &part) const {
+  part.Run = Run[ev];
+  part.EvNum = EvNum[ev];
+  part.PerWeight = PerWeight[ev];
+  part.Prodid = Prodid[ev];
+  part.EProbe = EProbe[ev];
+  part.ProdCharge = ProdCharge[ev];
+
+  part.ID = ID[p];
+  part.Charge = Charge[p];
+  std::copy(Position.begin() + 3 * p, Position.begin() + 3 * (p + 1),
+            part.Position);
+  std::copy(FourMom.begin() + 4 * p, FourMom.begin() + 4 * (p + 1),
+            part.FourMom);
+  part.History = History[p];
+  part.ln = ln[p];
+  part.IDIsPDG = IDIsPDG[p];
+}
 
-  UDBLog("Successfully loaded XML document from file: " << FileName << ".");
-  CountEvents();
-  SetFirstEventNode();
+void GiBUUEventBatch::Clear() {
+  Run.clear();
+  EvNum.clear();
+  PerWeight.clear();
+  Prodid.clear();
+  EProbe.clear();
+  ProdCharge.clear();
+  EventOffsets.resize(1);
+
+  ID.clear();
+  Charge.clear();
+  Position.clear();
+  FourMom.clear();
+  History.clear();
+  ln.clear();
+  IDIsPDG.clear();
 }
 
-void LHVectorReader::CloseDoc() {
-  xmlengine.FreeDoc(xmldoc);
-  UDBLog("Destroyed XML document.");
+void GiBUUEventBatch::Swap(GiBUUEventBatch &other) {
+  Run.swap(other.Run);
+  EvNum.swap(other.EvNum);
+  PerWeight.swap(other.PerWeight);
+  Prodid.swap(other.Prodid);
+  EProbe.swap(other.EProbe);
+  ProdCharge.swap(other.ProdCharge);
+  EventOffsets.swap(other.EventOffsets);
+
+  ID.swap(other.ID);
+  Charge.swap(other.Charge);
+  Position.swap(other.Position);
+  FourMom.swap(other.FourMom);
+  History.swap(other.History);
+  ln.swap(other.ln);
+  IDIsPDG.swap(other.IDIsPDG);
 }
 
-void LHVectorReader::SetFirstEventNode() {
-  XMLNodePointer_t rootNode = xmlengine.DocGetRootElement(xmldoc);
-  for (XMLNodePointer_t childNode_ptr = xmlengine.GetChild(rootNode);
-       (childNode_ptr != NULL);
-       childNode_ptr = xmlengine.GetNext(childNode_ptr)) {
-    if (std::string(xmlengine.GetNodeName(childNode_ptr)) != "event") {
-      continue;
+namespace {
+char const *FindStr(char const *begin, char const *end, char const *str) {
+  size_t const len = strlen(str);
+  for (; (begin + len) <= end; ++begin) {
+    if (!memcmp(begin, str, len)) {
+      return begin;
     }
-    evptr = childNode_ptr;
-    return;
   }
-
-  UDBError("Failed to find any event tags in input Les Houches file.");
-  throw;
+  return end;
 }
 
-void LHVectorReader::NextEventNode() {
-  for (XMLNodePointer_t childNode_ptr = xmlengine.GetNext(evptr);
-       (childNode_ptr != NULL);
-       childNode_ptr = xmlengine.GetNext(childNode_ptr)) {
-    if (std::string(xmlengine.GetNodeName(childNode_ptr)) != "event") {
-      std::cout << "Skipping node: " << xmlengine.GetNodeName(childNode_ptr)
-                << std::endl;
-      continue;
+// Finds an <event> opening tag, but not e.g. <eventgroup>. The tag may end
+// the line, with its attributes on the lines after it.
+char const *FindEventTag(char const *begin, char const *end) {
+  for (char const *tag = FindStr(begin, end, "<event"); tag != end;
+       tag = FindStr(tag + 6, end, "<event")) {
+    char const *next = tag + 6;
+    if ((next == end) || (*next == '>') || (*next == ' ') ||
+        (*next == '\t') || (*next == '\r') || (*next == '\n') ||
+        (*next == '\v') || (*next == '\f')) {
+      return tag;
     }
-    evptr = childNode_ptr;
-    return;
   }
-  evptr = NULL;
+  return end;
 }
+} // namespace
 
-size_t LHVectorReader::CountEvents() {
-  if (NEvents != 0) {
-    return NEvents;
-  }
-
-  XMLNodePointer_t rootNode = xmlengine.DocGetRootElement(xmldoc);
-  for (XMLNodePointer_t childNode_ptr = xmlengine.GetChild(rootNode);
-       (childNode_ptr != NULL);
-       childNode_ptr = xmlengine.GetNext(childNode_ptr)) {
-    if (std::string(xmlengine.GetNodeName(childNode_ptr)) == "event") {
-      NEvents++;
-    }
-  }
+LHVectorReader::LHVectorReader(std::string const &FileName)
+    : Reader(OpenInputLineReader(FileName, GiBUUToStdHepOpts::UseMMapInput)),
+      LineCursor(NULL), LineEnd(NULL), HaveLine(false), InComment(false),
+      EventBlock(), NEventsRead(0), NLinesRead(0) {
+  if (!Reader->IsOpen()) {
+    UDBError("Could not open Les Houches file: \"" << FileName << "\"");
+    throw std::runtime_error("Failed to open Les Houches file.");
+  }
+  UDBLog("Opened Les Houches file: " << FileName << ".");
+}
 
-  return NEvents;
+unsigned long long LHVectorReader::GetInputBytesRead() const {
+  return Reader->GetInputBytesRead();
 }
 
-bool LHVectorReader::EOV() { return (evptr == NULL); }
+bool LHVectorReader::NextLine() {
+  HaveLine = Reader->NextLine(LineCursor, LineEnd);
+  NLinesRead += HaveLine;
+  return HaveLine;
+}
 
-std::vector<GiBUUPartBlob> LHVectorReader::ReadEvent() {
-  if (EOV()) {
-    return std::vector<GiBUUPartBlob>();
-  }
+bool LHVectorReader::NextEventBlock() {
+  EventBlock.clear();
+  bool InEvent = false;
+  // Whether the <event> tag has been found, but not the '>' that closes it.
+  bool InEventTag = false;
+
+  while (HaveLine || NextLine()) {
+    if (InComment) {
+      char const *close = FindStr(LineCursor, LineEnd, "-->");
+      if (close == LineEnd) {
+        HaveLine = false;
+        continue;
+      }
+      LineCursor = close + 3;
+      InComment = false;
+      continue;
+    }
 
-  std::vector<GiBUUPartBlob> event;
+    if (InEventTag) {
+      char const *tagend = static_cast<char const *>(
+          memchr(LineCursor, '>', size_t(LineEnd - LineCursor)));
+      if (!tagend) {
+        HaveLine = false;
+        continue;
+      }
+      LineCursor = tagend + 1;
+      InEventTag = false;
+      InEvent = true;
+      continue;
+    }
 
-  std::vector<std::string> event_lines =
-      Utils::SplitStringByDelim(xmlengine.GetNodeContent(evptr), "\n");
+    if (!InEvent) {
+      char const *tag = FindEventTag(LineCursor, LineEnd);
+      char const *comment = FindStr(LineCursor, tag, "<!--");
+      if (comment != tag) {
+        LineCursor = comment + 4;
+        InComment = true;
+        continue;
+      }
+      if (tag == LineEnd) {
+        HaveLine = false;
+        continue;
+      }
+      LineCursor = tag + 6;
+      InEventTag = true;
+      continue;
+    }
 
-  std::vector<std::string> FSLep_str =
-      Utils::SplitStringByDelim(event_lines.back(), " \t");
+    char const *close = FindStr(LineCursor, LineEnd, "</event>");
+    EventBlock.append(LineCursor, close);
+    if (close == LineEnd) {
+      EventBlock += '\n';
+      HaveLine = false;
+      continue;
+    }
+    LineCursor = close + 8;
+    return true;
+  }
 
-  UDBVerbose(
-      "LH Event: " << Utils::SplitStringByDelim(event_lines.front(), " \t"));
+  if (InEvent || InEventTag) {
+    UDBWarn("Les Houches file ended inside an <event> block, ignoring the "
+            "incomplete event.");
+  }
+  return false;
+}
 
-  if (FSLep_str.size() >=
-      12) { // We have found the FS lepton kinematics in the event line,
-            // otherwise it might be an NDK event.
-    GiBUUPartBlob FSLep;
-    FSLep.Run = 1;
-    FSLep.EvNum = NEventsRead + 1;
-    FSLep.ID = 0;
-    FSLep.PerWeight = Utils::str2d(FSLep_str[3]);
-    FSLep.FourMom =
-        TLorentzVector(Utils::str2d(FSLep_str[9]), Utils::str2d(FSLep_str[10]),
-                       Utils::str2d(FSLep_str[11]), Utils::str2d(FSLep_str[8]));
-    FSLep.Prodid = Utils::str2i(FSLep_str[2]);
-    FSLep.EProbe = Utils::str2d(FSLep_str[4]);
-    FSLep.IDIsPDG = true;
-    event.push_back(FSLep);
-    UDBVerbose("\t" << FSLep);
-  } else {
-    GiBUUPartBlob NDK_Kplus;
-    NDK_Kplus.Run = 1;
-    NDK_Kplus.EvNum = NEventsRead + 1;
-    NDK_Kplus.ID = 0;
-    NDK_Kplus.FourMom =
-          TLorentzVector(Utils::str2d(FSLep_str[3]), Utils::str2d(FSLep_str[4]),
-                         Utils::str2d(FSLep_str[5]), Utils::str2d(FSLep_str[2]));
-    NDK_Kplus.Prodid = 0;
-    NDK_Kplus.EProbe = 0;
-    NDK_Kplus.IDIsPDG = true;
-    event.push_back(NDK_Kplus);
-    UDBVerbose("\t" << NDK_Kplus);
-  }
-
-  int NFSHadr = (int(event_lines.size()) - 2);
-  if (NFSHadr) {
-    for (size_t ln = 1; event_lines.size() && (ln < (event_lines.size() - 1));
-         ++ln) {
-      std::vector<std::string> FSHadr_str =
-          Utils::SplitStringByDelim(event_lines[ln], " \t");
-
-      GiBUUPartBlob FSHadr;
-      FSHadr.Run = 1;
-      FSHadr.EvNum = NEventsRead + 1;
-      FSHadr.ID = Utils::str2i(FSHadr_str[0]);
-      FSHadr.FourMom = TLorentzVector(
-          Utils::str2d(FSHadr_str[6]), Utils::str2d(FSHadr_str[7]),
-          Utils::str2d(FSHadr_str[8]), Utils::str2d(FSHadr_str[9]));
-      FSHadr.IDIsPDG = true;
-
-      UDBVerbose("\t" << FSHadr);
-      event.push_back(FSHadr);
+size_t LHVectorReader::ReadEvent(GiBUUEventBatch &Events) {
+  while (NextEventBlock()) {
+    GiBUUTiming::Lap(GiBUUTiming::kLineRead);
+    size_t NParts = GiBUUParsing::GetLesHouchesEvent(
+        EventBlock.data(), EventBlock.data() + EventBlock.size(),
+        Int_t(NEventsRead + 1), Events);
+    GiBUUTiming::Lap(GiBUUTiming::kParticleParse);
+    if (!NParts) {
+      UDBWarn("Skipping empty <event> block.");
+      continue;
     }
+    NEventsRead++;
+    return NParts;
   }
-  NextEventNode();
-  NEventsRead++;
-  return event;
-}
 
-LHVectorReader::~LHVectorReader() {
-  if (xmldoc) {
-    CloseDoc();
+  if (!NEventsRead) {
+    UDBError("Failed to find any event tags in input Les Houches file.");
+    throw std::runtime_error("No events in Les Houches file.");
   }
+  return 0;
 }
+
+LHVectorReader::~LHVectorReader() {}
@@ -8,14 +8,15 @@
 #include <functional>
 #include <sstream>
 #include <string>
+#include <tuple>
 
 #include <iostream>
+#include <memory>
 #include <vector>
 
 #include "Rtypes.h"
 #include "TLorentzVector.h"
 #include "TVector3.h"
-#include "TXMLEngine.h"
 
 #include "GiBUUToStdHep_CLIOpts.hxx"
 
@@ -128,9 +129,69 @@ namespace GiBUUUtils {
 /// - 999 : 22
 int GiBUUToPDG(int GiBUUCode, int GiBUUCharge = 0);
 
+///\brief Converts a PDG code to the GiBUU particle code, the inverse of
+/// GiBUUToPDG where it is unique.
+///
+///\note Returns 0 when encountering an unknown particle.
+int PDGToGiBUU(int PDG);
+
+///\brief Decomposes NParts GiBUU history codes in one pass.
+///
+/// Element i of Generation, Mother and Father is set to the corresponding
+/// element of DecomposeGiBUUHistory(History[i]), i.e. for three-body (negative)
+/// history codes, Mother is -1 and Father is the three-body process code.
+/// Mother and Father are GiBUU particle codes.
+///
+/// Written so that the common case, where all codes fit in 32 bits as GiBUU
+/// writes them, can be auto-vectorised.
+void DecomposeGiBUUHistories(Long_t const *History, size_t NParts,
+                             Int_t *Generation, Int_t *Mother, Int_t *Father);
+
 #ifndef CPP03COMPAT
 std::tuple<Int_t, Int_t, Int_t> DecomposeGiBUUHistory(Long_t HistCode);
 std::string WriteGiBUUHistory(Long_t HistCode);
+
+///\brief The decoded GiBUU history of every particle in one event.
+///
+/// Each GiBHepHistory code is decomposed once by Build, after which particles
+/// can be looked up by generation, and the decay products used by the
+/// resonance heuristics are available without re-scanning the event.
+///
+/// Build keeps the allocated storage, so an instance can be reused for many
+/// events.
+struct GiBUUGenealogy {
+  GiBUUGenealogy()
+      : StdHepPDGArray(nullptr), HistoryArray(nullptr), StdHepN(0) {}
+
+  ///\brief The arrays this genealogy was built from, not owned.
+  Int_t const *StdHepPDGArray;
+  Long_t const *HistoryArray;
+  Int_t StdHepN;
+
+  // Per particle, as returned by DecomposeGiBUUHistory.
+  std::vector<Int_t> Generation;
+  std::vector<Int_t> Mother;
+  std::vector<Int_t> Father;
+
+  ///\brief Particle indices, stably sorted by generation.
+  std::vector<Int_t> ByGeneration;
+  ///\brief Generation, and the [begin, end) range of ByGeneration holding its
+  /// particles, sorted by generation.
+  std::vector<std::tuple<Int_t, size_t, size_t>> GenerationRanges;
+
+  ///\brief Generation, pion PDG and decay parent of all non-three-body
+  /// pions that do not come from a two-body collision, sorted.
+  std::vector<std::tuple<Int_t, Int_t, Int_t>> FSDecayPions;
+  ///\brief Generation and PDG of all nucleons from Delta decays, sorted.
+  std::vector<std::tuple<Int_t, Int_t>> DeltaDecayNucleons;
+
+  void Build(Int_t const *const PDGArray, Long_t const *const History,
+             Int_t N);
+
+  ///\brief Sets begin and end to the range of particle indices in generation
+  /// Gen. The range is empty if there are none.
+  void GetGeneration(Int_t Gen, Int_t const *&begin, Int_t const *&end) const;
+};
 #endif
 
 ///\brief Converts a GiBUU interaction code to the corresponding NEUT code
@@ -221,6 +282,9 @@ inline std::ostream &operator<<(std::ostream &os, TLorentzVector const &tlv) {
   return os;
 }
 
+///\brief A single particle read from a GiBUU output file.
+///
+/// Holds no ROOT objects, so that it can be copied around with memcpy.
 struct GiBUUPartBlob {
   GiBUUPartBlob()
       : Run(0),
@@ -228,35 +292,99 @@ struct GiBUUPartBlob {
         ID(0),
         Charge(0),
         PerWeight(0),
-        Position(0, 0, 0),
-        FourMom(0, 0, 0, 0),
         History(0),
         Prodid(0),
         EProbe(0),
         ProdCharge(0),
         ln(0),
-        IDIsPDG(false) {}
+        IDIsPDG(false) {
+    Position[0] = Position[1] = Position[2] = 0;
+    SetFourMom(0, 0, 0, 0);
+  }
   Int_t Run;
   Int_t EvNum;
   Int_t ID;
   Int_t Charge;
   Double_t PerWeight;
-  TVector3 Position;
-  TLorentzVector FourMom;
+  ///\brief x, y, z.
+  Double_t Position[3];
+  ///\brief Px, Py, Pz, E, in the same order as GiRooTracker::StdHepP4.
+  Double_t FourMom[4];
   Long_t History;
   Int_t Prodid;
   Double_t EProbe;
   Int_t ProdCharge;
   Int_t ln;
   bool IDIsPDG;
+
+  void SetFourMom(Double_t Px, Double_t Py, Double_t Pz, Double_t E) {
+    FourMom[0] = Px;
+    FourMom[1] = Py;
+    FourMom[2] = Pz;
+    FourMom[3] = E;
+  }
+};
+
+///\brief A batch of GiBUU events held in flat, per-column arrays.
+///
+/// Quantities that GiBUU writes on every particle line, but which are the same
+/// for every particle in an event, are stored once per event, taken from the
+/// event's first particle. The particles of event ev are those in
+/// [EventOffsets[ev], EventOffsets[ev+1]).
+///
+/// Clear keeps the allocated storage, so a batch that is reused for many
+/// events stops allocating once it has grown to the size of the largest batch.
+struct GiBUUEventBatch {
+  GiBUUEventBatch() : EventOffsets(1, 0) {}
+
+  // Per event
+  std::vector<Int_t> Run;
+  std::vector<Int_t> EvNum;
+  std::vector<Double_t> PerWeight;
+  std::vector<Int_t> Prodid;
+  std::vector<Double_t> EProbe;
+  std::vector<Int_t> ProdCharge;
+  std::vector<size_t> EventOffsets; // NEvents + 1 entries
+
+  // Per particle
+  std::vector<Int_t> ID;
+  std::vector<Int_t> Charge;
+  std::vector<Double_t> Position; // 3 per particle
+  std::vector<Double_t> FourMom;  // 4 per particle, as GiBUUPartBlob::FourMom
+  std::vector<Long_t> History;
+  std::vector<Int_t> ln;
+  std::vector<char> IDIsPDG;
+
+  size_t GetNEvents() const { return EvNum.size(); }
+  size_t GetNParticles() const { return ID.size(); }
+  bool Empty() const { return EvNum.empty(); }
+
+  ///\brief Appends a particle, either to the last event or as the first
+  /// particle of a new event.
+  ///
+  /// A malformed particle (EvNum == 0) marks the whole event as malformed.
+  void AddParticle(GiBUUPartBlob const &part, bool NewEvent);
+
+  ///\brief Appends all events in other.
+  void Append(GiBUUEventBatch const &other);
+
+  ///\brief Reconstructs particle p of event ev.
+  void GetParticle(size_t ev, size_t p, GiBUUPartBlob &part) const;
+
+  void Clear();
+  void Swap(GiBUUEventBatch &other);
 };
 
 namespace {
 std::ostream &operator<<(std::ostream &os, GiBUUPartBlob const &part) {
   os << "{ Run: " << part.Run << ", EvNum: " << part.EvNum
      << ", ID: " << part.ID << ", Charge: " << part.Charge
-     << ", PerWeight: " << part.PerWeight << ", Pos: " << part.Position
-     << ", 4Mom: " << part.FourMom << ", History: " << part.History
+     << ", PerWeight: " << part.PerWeight << ", Pos: "
+     << TVector3(part.Position[0], part.Position[1], part.Position[2])
+     << ", 4Mom: "
+     << TLorentzVector(part.FourMom[0], part.FourMom[1], part.FourMom[2],
+                       part.FourMom[3])
+     << ", History: " << part.History
      << ", Prodid: " << part.Prodid << ", EProbe: " << part.EProbe;
   if (GiBUUToStdHepOpts::HaveProdChargeInfo) {
     os << ", ProdCharge: " << part.ProdCharge;
@@ -279,32 +407,43 @@ std::ostream &operator<<(std::ostream &os, std::vector<std::string> strs) {
 }
 }
 
+class InputLineReader;
+
+///\brief Reads events from a Les Houches file one <event> block at a time.
+///
+/// The file is streamed through an InputLineReader, only the current event
+/// block is held in memory.
 class LHVectorReader {
-  TXMLEngine xmlengine;
+  std::unique_ptr<InputLineReader> Reader;
 
-  XMLDocPointer_t xmldoc;
-  XMLNodePointer_t evptr;
+  // The unconsumed part of the current line.
+  char const *LineCursor;
+  char const *LineEnd;
+  bool HaveLine;
+  bool InComment;
 
-  bool ReadFile;
-  size_t NEvents;
+  std::string EventBlock;
   size_t NEventsRead;
+  size_t NLinesRead;
 
- public:
-  LHVectorReader(std::string const &FileName);
+  LHVectorReader(LHVectorReader const &);
+  LHVectorReader &operator=(LHVectorReader const &);
 
- private:
-  void OpenLHDoc(std::string const &FileName);
-  void CloseDoc();
-
-  void SetFirstEventNode();
-  void NextEventNode();
-
-  bool EOV();
+  bool NextLine();
+  bool NextEventBlock();
 
  public:
-  size_t CountEvents();
+  LHVectorReader(std::string const &FileName);
+
+  ///\brief Appends the next event to Events, returns the number of particles
+  /// read, or 0 at the end of the file.
+  size_t ReadEvent(GiBUUEventBatch &Events);
 
-  std::vector<GiBUUPartBlob> ReadEvent();
+  size_t GetNEventsRead() const { return NEventsRead; }
+  ///\brief The number of lines read from the file so far.
+  size_t GetNLinesRead() const { return NLinesRead; }
+  ///\brief The number of bytes of the file on disk consumed so far.
+  unsigned long long GetInputBytesRead() const;
 
   ~LHVectorReader();
 };
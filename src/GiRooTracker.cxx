@@ -1,11 +1,23 @@
+#include <algorithm>
+#include <cmath>
+
 #include "LUtils/Utils.hxx"
 
 #include "GiRooTracker.hxx"
 
+namespace {
+// The nucleon mass used by GiBUU, in GeV.
+double const kNucleonMass = 0.938;
+} // namespace
+
 GiRooTracker::GiRooTracker() {
   StdHepPdg = new Int_t[kGiStdHepNPmax];
   StdHepStatus = new Int_t[kGiStdHepNPmax];
   GiBHepHistory = new Long_t[kGiStdHepNPmax];
+  StdHepPx = new Double_t[kGiStdHepNPmax];
+  StdHepPy = new Double_t[kGiStdHepNPmax];
+  StdHepPz = new Double_t[kGiStdHepNPmax];
+  StdHepE = new Double_t[kGiStdHepNPmax];
 #ifndef CPP03COMPAT
   GiBHepFather = new Int_t[kGiStdHepNPmax];
   GiBHepMother = new Int_t[kGiStdHepNPmax];
@@ -15,13 +27,17 @@ GiRooTracker::GiRooTracker() {
 }
 
 GiRooTracker::~GiRooTracker() {
-  delete StdHepPdg;
-  delete StdHepStatus;
-  delete GiBHepHistory;
+  delete[] StdHepPdg;
+  delete[] StdHepStatus;
+  delete[] GiBHepHistory;
+  delete[] StdHepPx;
+  delete[] StdHepPy;
+  delete[] StdHepPz;
+  delete[] StdHepE;
 #ifndef CPP03COMPAT
-  delete GiBHepFather;
-  delete GiBHepMother;
-  delete GiBHepGeneration;
+  delete[] GiBHepFather;
+  delete[] GiBHepMother;
+  delete[] GiBHepGeneration;
 #endif
 }
 
@@ -32,6 +48,7 @@ void GiRooTracker::Reset() {
   EvtNum = 0;
   StdHepN = 0;
   GiBUUPerWeight = 1.0;
+  Enu = Q2 = q0 = q3 = W = CosThetaLep = PhiLep = 0;
 
   Utils::ClearPointer(StdHepPdg, kGiStdHepNPmax);
   Utils::ClearPointer(StdHepStatus, kGiStdHepNPmax);
@@ -44,8 +61,64 @@ void GiRooTracker::Reset() {
   Utils::ClearArray2D(StdHepP4);
 }
 
+void GiRooTracker::FillCompactP4() {
+  for (Int_t p_it = 0; p_it < StdHepN; ++p_it) {
+    StdHepPx[p_it] = StdHepP4[p_it][kStdHepIdxPx];
+    StdHepPy[p_it] = StdHepP4[p_it][kStdHepIdxPy];
+    StdHepPz[p_it] = StdHepP4[p_it][kStdHepIdxPz];
+    StdHepE[p_it] = StdHepP4[p_it][kStdHepIdxE];
+  }
+}
+
+void GiRooTracker::FillDerivedKinematics() {
+  Enu = Q2 = q0 = q3 = W = CosThetaLep = PhiLep = 0;
+  // The probe, the target and the final state lepton.
+  if (StdHepN < 3) {
+    return;
+  }
+  Double_t const *Probe = StdHepP4[0];
+  Double_t const *Lep = StdHepP4[2];
+
+  Enu = Probe[kStdHepIdxE];
+  Double_t const qx = Probe[kStdHepIdxPx] - Lep[kStdHepIdxPx];
+  Double_t const qy = Probe[kStdHepIdxPy] - Lep[kStdHepIdxPy];
+  Double_t const qz = Probe[kStdHepIdxPz] - Lep[kStdHepIdxPz];
+  q0 = Probe[kStdHepIdxE] - Lep[kStdHepIdxE];
+  q3 = sqrt(qx * qx + qy * qy + qz * qz);
+  Q2 = q3 * q3 - q0 * q0;
+
+  // The struck nucleon, if there is one, follows the final state lepton.
+  Double_t HadE = kNucleonMass + q0;
+  Double_t HadPx = qx, HadPy = qy, HadPz = qz;
+  if ((StdHepN > 3) && (StdHepStatus[3] == 11)) {
+    HadE = StdHepP4[3][kStdHepIdxE] + q0;
+    HadPx += StdHepP4[3][kStdHepIdxPx];
+    HadPy += StdHepP4[3][kStdHepIdxPy];
+    HadPz += StdHepP4[3][kStdHepIdxPz];
+  }
+  Double_t const W2 =
+      HadE * HadE - (HadPx * HadPx + HadPy * HadPy + HadPz * HadPz);
+  W = (W2 > 0) ? sqrt(W2) : 0;
+
+  Double_t const PProbe =
+      sqrt(Probe[kStdHepIdxPx] * Probe[kStdHepIdxPx] +
+           Probe[kStdHepIdxPy] * Probe[kStdHepIdxPy] +
+           Probe[kStdHepIdxPz] * Probe[kStdHepIdxPz]);
+  Double_t const PLep = sqrt(Lep[kStdHepIdxPx] * Lep[kStdHepIdxPx] +
+                             Lep[kStdHepIdxPy] * Lep[kStdHepIdxPy] +
+                             Lep[kStdHepIdxPz] * Lep[kStdHepIdxPz]);
+  if ((PProbe > 0) && (PLep > 0)) {
+    CosThetaLep = (Probe[kStdHepIdxPx] * Lep[kStdHepIdxPx] +
+                   Probe[kStdHepIdxPy] * Lep[kStdHepIdxPy] +
+                   Probe[kStdHepIdxPz] * Lep[kStdHepIdxPz]) /
+                  (PProbe * PLep);
+  }
+  PhiLep = atan2(Lep[kStdHepIdxPy], Lep[kStdHepIdxPx]);
+}
+
 void GiRooTracker::AddBranches(TTree *&tree, bool AddHistory,
-                               bool AddProdCharge, int EventMode) {
+                               bool AddProdCharge, int EventMode,
+                               bool CompactP4, bool DerivedKinematics) {
 
   tree->Branch("EvtNum", &EvtNum, "EvtNum/I");
   tree->Branch("StdHepN", &StdHepN, "StdHepN/I");
@@ -53,8 +126,15 @@ void GiRooTracker::AddBranches(TTree *&tree, bool AddHistory,
   tree->Branch("StdHepStatus", StdHepStatus, "StdHepStatus[StdHepN]/I");
   static std::string GiStdHepNPmaxstr = Utils::int2str(kGiStdHepNPmax);
 
-  tree->Branch("StdHepP4", StdHepP4,
-               ("StdHepP4[" + GiStdHepNPmaxstr + "][4]/D").c_str());
+  if (CompactP4) {
+    tree->Branch("StdHepPx", StdHepPx, "StdHepPx[StdHepN]/D");
+    tree->Branch("StdHepPy", StdHepPy, "StdHepPy[StdHepN]/D");
+    tree->Branch("StdHepPz", StdHepPz, "StdHepPz[StdHepN]/D");
+    tree->Branch("StdHepE", StdHepE, "StdHepE[StdHepN]/D");
+  } else {
+    tree->Branch("StdHepP4", StdHepP4,
+                 ("StdHepP4[" + GiStdHepNPmaxstr + "][4]/D").c_str());
+  }
                
   if (EventMode == 2) {
     return;
@@ -80,4 +160,142 @@ void GiRooTracker::AddBranches(TTree *&tree, bool AddHistory,
     tree->Branch("GiBUUPrimaryParticleCharge", &GiBUUPrimaryParticleCharge,
                  "GiBUUPrimaryParticleCharge/I");
   }
+  if (DerivedKinematics) {
+    tree->Branch("Enu", &Enu, "Enu/D");
+    tree->Branch("Q2", &Q2, "Q2/D");
+    tree->Branch("q0", &q0, "q0/D");
+    tree->Branch("q3", &q3, "q3/D");
+    tree->Branch("W", &W, "W/D");
+    tree->Branch("CosThetaLep", &CosThetaLep, "CosThetaLep/D");
+    tree->Branch("PhiLep", &PhiLep, "PhiLep/D");
+  }
+}
+
+void GiRooTracker::SetBranchAddresses(TTree *tree) {
+  struct BranchAddress {
+    char const *Name;
+    void *Address;
+  } const Branches[] = {{"EvtNum", &EvtNum},
+                        {"StdHepN", &StdHepN},
+                        {"StdHepPdg", StdHepPdg},
+                        {"StdHepStatus", StdHepStatus},
+                        {"StdHepPx", StdHepPx},
+                        {"StdHepPy", StdHepPy},
+                        {"StdHepPz", StdHepPz},
+                        {"StdHepE", StdHepE},
+                        {"StdHepP4", StdHepP4},
+                        {"GiBUU2NeutCode", &GiBUU2NeutCode},
+                        {"GiBUUReactionCode", &GiBUUReactionCode},
+                        {"GiBUUPerWeight", &GiBUUPerWeight},
+                        {"NumRunsWeight", &NumRunsWeight},
+                        {"FileExtraWeight", &FileExtraWeight},
+                        {"EvtWght", &EvtWght},
+                        {"GiBHepHistory", GiBHepHistory},
+#ifndef CPP03COMPAT
+                        {"GiBHepFather", GiBHepFather},
+                        {"GiBHepMother", GiBHepMother},
+                        {"GiBHepGeneration", GiBHepGeneration},
+#endif
+                        {"GiBUUPrimaryParticleCharge",
+                         &GiBUUPrimaryParticleCharge},
+                        {"Enu", &Enu},
+                        {"Q2", &Q2},
+                        {"q0", &q0},
+                        {"q3", &q3},
+                        {"W", &W},
+                        {"CosThetaLep", &CosThetaLep},
+                        {"PhiLep", &PhiLep}};
+
+  for (size_t b_it = 0; b_it < (sizeof(Branches) / sizeof(Branches[0]));
+       ++b_it) {
+    if (tree->GetBranch(Branches[b_it].Name)) {
+      tree->SetBranchAddress(Branches[b_it].Name, Branches[b_it].Address);
+    }
+  }
+}
+
+void GiRooTrackerBatch::Append(GiRooTracker const &tracker) {
+  GiBUU2NeutCode.push_back(tracker.GiBUU2NeutCode);
+  GiBUUReactionCode.push_back(tracker.GiBUUReactionCode);
+  GiBUUPrimaryParticleCharge.push_back(tracker.GiBUUPrimaryParticleCharge);
+  EvtNum.push_back(tracker.EvtNum);
+  StdHepN.push_back(tracker.StdHepN);
+  GiBUUPerWeight.push_back(tracker.GiBUUPerWeight);
+  NumRunsWeight.push_back(tracker.NumRunsWeight);
+  FileExtraWeight.push_back(tracker.FileExtraWeight);
+  EvtWght.push_back(tracker.EvtWght);
+
+  StdHepPdg.insert(StdHepPdg.end(), tracker.StdHepPdg,
+                   tracker.StdHepPdg + tracker.StdHepN);
+  StdHepStatus.insert(StdHepStatus.end(), tracker.StdHepStatus,
+                      tracker.StdHepStatus + tracker.StdHepN);
+  StdHepP4.insert(StdHepP4.end(), &tracker.StdHepP4[0][0],
+                  &tracker.StdHepP4[0][0] + 4 * tracker.StdHepN);
+  GiBHepHistory.insert(GiBHepHistory.end(), tracker.GiBHepHistory,
+                       tracker.GiBHepHistory + tracker.StdHepN);
+#ifndef CPP03COMPAT
+  GiBHepFather.insert(GiBHepFather.end(), tracker.GiBHepFather,
+                      tracker.GiBHepFather + tracker.StdHepN);
+  GiBHepMother.insert(GiBHepMother.end(), tracker.GiBHepMother,
+                      tracker.GiBHepMother + tracker.StdHepN);
+  GiBHepGeneration.insert(GiBHepGeneration.end(), tracker.GiBHepGeneration,
+                          tracker.GiBHepGeneration + tracker.StdHepN);
+#endif
+}
+
+void GiRooTrackerBatch::Load(size_t ev, size_t &ParticleOffset,
+                             GiRooTracker &tracker) const {
+  tracker.Reset();
+
+  tracker.GiBUU2NeutCode = GiBUU2NeutCode[ev];
+  tracker.GiBUUReactionCode = GiBUUReactionCode[ev];
+  tracker.GiBUUPrimaryParticleCharge = GiBUUPrimaryParticleCharge[ev];
+  tracker.EvtNum = EvtNum[ev];
+  tracker.StdHepN = StdHepN[ev];
+  tracker.GiBUUPerWeight = GiBUUPerWeight[ev];
+  tracker.NumRunsWeight = NumRunsWeight[ev];
+  tracker.FileExtraWeight = FileExtraWeight[ev];
+  tracker.EvtWght = EvtWght[ev];
+
+  size_t const p = ParticleOffset;
+  size_t const n = size_t(tracker.StdHepN);
+  std::copy(StdHepPdg.begin() + p, StdHepPdg.begin() + p + n,
+            tracker.StdHepPdg);
+  std::copy(StdHepStatus.begin() + p, StdHepStatus.begin() + p + n,
+            tracker.StdHepStatus);
+  std::copy(StdHepP4.begin() + 4 * p, StdHepP4.begin() + 4 * (p + n),
+            &tracker.StdHepP4[0][0]);
+  std::copy(GiBHepHistory.begin() + p, GiBHepHistory.begin() + p + n,
+            tracker.GiBHepHistory);
+#ifndef CPP03COMPAT
+  std::copy(GiBHepFather.begin() + p, GiBHepFather.begin() + p + n,
+            tracker.GiBHepFather);
+  std::copy(GiBHepMother.begin() + p, GiBHepMother.begin() + p + n,
+            tracker.GiBHepMother);
+  std::copy(GiBHepGeneration.begin() + p, GiBHepGeneration.begin() + p + n,
+            tracker.GiBHepGeneration);
+#endif
+  ParticleOffset += n;
+}
+
+void GiRooTrackerBatch::Clear() {
+  GiBUU2NeutCode.clear();
+  GiBUUReactionCode.clear();
+  GiBUUPrimaryParticleCharge.clear();
+  EvtNum.clear();
+  StdHepN.clear();
+  GiBUUPerWeight.clear();
+  NumRunsWeight.clear();
+  FileExtraWeight.clear();
+  EvtWght.clear();
+
+  StdHepPdg.clear();
+  StdHepStatus.clear();
+  StdHepP4.clear();
+  GiBHepHistory.clear();
+#ifndef CPP03COMPAT
+  GiBHepFather.clear();
+  GiBHepMother.clear();
+  GiBHepGeneration.clear();
+#endif
 }
@@ -1,7 +1,9 @@
 #ifndef SEEN_GIROOTRACKER_HXX
 #define SEEN_GIROOTRACKER_HXX
 
+#include <cstddef>
 #include <string>
+#include <vector>
 
 #include "TTree.h"
 
@@ -90,6 +92,16 @@ struct GiRooTracker {
   ///\brief Four momentum for particles in this event.
   Double_t StdHepP4[kGiStdHepNPmax][4];
 
+  ///\brief Components of StdHepP4, written instead of it when the compact
+  /// momentum branches are in use.
+  ///
+  /// Only filled by GiRooTracker::FillCompactP4, and not cleared by
+  /// GiRooTracker::Reset, as only the first StdHepN entries are written.
+  Double_t* StdHepPx;  //[StdHepN]
+  Double_t* StdHepPy;  //[StdHepN]
+  Double_t* StdHepPz;  //[StdHepN]
+  Double_t* StdHepE;   //[StdHepN]
+
   ///\brief GiBUU history array, indices correspond to the StdHep arrays.
   Long_t* GiBHepHistory;  //[StdHepN]
 #ifndef CPP03COMPAT
@@ -113,18 +125,115 @@ struct GiRooTracker {
   ///\brief The total XSec weighting that should be applied to this event.
   Double_t EvtWght;
 
+  ///\brief The probe energy, StdHepP4[0][kStdHepIdxE].
+  ///
+  /// This and the other derived kinematics are only filled by
+  /// GiRooTracker::FillDerivedKinematics, from the probe, StdHepP4[0], and
+  /// the final state lepton, StdHepP4[2].
+  Double_t Enu;
+  ///\brief The four momentum transfer squared, -q^2, where q is the probe
+  /// four momentum less that of the final state lepton.
+  Double_t Q2;
+  ///\brief The energy transfer, the time component of q.
+  Double_t q0;
+  ///\brief The magnitude of the three momentum transfer.
+  Double_t q3;
+  ///\brief The invariant mass of the hadronic system, from q and the struck
+  /// nucleon, or a nucleon at rest if the event has no struck nucleon.
+  Double_t W;
+  ///\brief The cosine of the angle between the final state lepton and the
+  /// probe.
+  Double_t CosThetaLep;
+  ///\brief The azimuthal angle of the final state lepton about the z axis,
+  /// which is the probe direction.
+  Double_t PhiLep;
+
   ///\brief Function to reset an instance of this class to its default state.
   ///
   /// Used between fillings to result any values to default.
   void Reset();
 
+  ///\brief Copies the first StdHepN entries of StdHepP4 into the compact
+  /// momentum arrays.
+  void FillCompactP4();
+
+  ///\brief Computes the derived kinematics, from Enu to PhiLep, from the
+  /// particle stack.
+  ///
+  /// They are all 0 if the event has no final state lepton.
+  void FillDerivedKinematics();
+
   ///\brief Will add the relevant output branches to a given TTree.
   ///
   /// EventMode:
   /// 0: Neutrino
   /// 1: Electron
   /// 2: NDK
+  ///
+  /// If CompactP4 is true, four momenta are written as the StdHepN-sized
+  /// StdHepPx, StdHepPy, StdHepPz and StdHepE branches, rather than as the
+  /// kGiStdHepNPmax-sized StdHepP4 branch. GiRooTracker::FillCompactP4 must
+  /// then be called before each fill.
+  ///
+  /// If DerivedKinematics is true, and the events are not NDK events, the
+  /// derived kinematics, Enu to PhiLep, are also written.
+  /// GiRooTracker::FillDerivedKinematics must then be called before each fill.
   void AddBranches(TTree*& tree, bool AddHistory = false,
-                   bool AddProdCharge = false, int EventMode=0);
+                   bool AddProdCharge = false, int EventMode=0,
+                   bool CompactP4 = false, bool DerivedKinematics = false);
+
+  ///\brief Sets the addresses of the branches of an existing tree, as written
+  /// by GiRooTracker::AddBranches, to this instance.
+  ///
+  /// Branches that AddBranches can make but which are not in the tree are
+  /// skipped, so that any of its layouts can be filled or read.
+  void SetBranchAddresses(TTree* tree);
+};
+
+///\brief A compact store of converted GiRooTracker entries.
+///
+/// Only the first StdHepN elements of the per-particle arrays are kept, so that
+/// batches of converted events can be passed between conversion pipeline
+/// stages without carrying the full kGiStdHepNPmax-sized arrays for each one.
+struct GiRooTrackerBatch {
+  GiRooTrackerBatch() : FileNumber(0) {}
+
+  ///\brief The input file that these events were read from.
+  size_t FileNumber;
+
+  std::vector<Int_t> GiBUU2NeutCode;
+  std::vector<Int_t> GiBUUReactionCode;
+  std::vector<Int_t> GiBUUPrimaryParticleCharge;
+  std::vector<Int_t> EvtNum;
+  std::vector<Int_t> StdHepN;
+  std::vector<Double_t> GiBUUPerWeight;
+  std::vector<Double_t> NumRunsWeight;
+  std::vector<Double_t> FileExtraWeight;
+  std::vector<Double_t> EvtWght;
+
+  std::vector<Int_t> StdHepPdg;
+  std::vector<Int_t> StdHepStatus;
+  std::vector<Double_t> StdHepP4; // 4 per particle
+  std::vector<Long_t> GiBHepHistory;
+#ifndef CPP03COMPAT
+  std::vector<Int_t> GiBHepFather;
+  std::vector<Int_t> GiBHepMother;
+  std::vector<Int_t> GiBHepGeneration;
+#endif
+
+  size_t GetNEvents() const { return EvtNum.size(); }
+
+  ///\brief Copies the current state of tracker to the end of the batch.
+  void Append(GiRooTracker const &tracker);
+
+  ///\brief Resets tracker and loads entry ev into it.
+  ///
+  /// ParticleOffset must be the index of the first particle of ev, and is
+  /// advanced past its last particle, so that a batch can be read
+  /// sequentially.
+  void Load(size_t ev, size_t &ParticleOffset, GiRooTracker &tracker) const;
+
+  ///\brief Removes all entries, but keeps the allocated storage.
+  void Clear();
 };
 #endif